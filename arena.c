@@ -0,0 +1,737 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-arena plays bots against each other on the same list of seeds, so
+ * every bot gets the same shapes and the games can be compared in pairs.
+ * The games run headless on all processors. Every move can be given a
+ * time budget; beam searches and planners are cut short when they run
+ * out of it. The greedy bot doesn't search, and no move can stop exactly
+ * on time, so the moves that go over are counted as well. The
+ * results are printed with 95% confidence intervals and can be written
+ * as JSON (a summary) and CSV (every game) to follow bots across builds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "game.h"
+#include "sim.h"
+#include "bot.h"
+#include "pool.h"
+#include "beam.h"
+#include "plan.h"
+#include "eval.h"
+
+/*
+ * Macros
+ */
+
+/* Most bots that can take part */
+#define MAXBOTS		16
+
+/* Default number of shapes the searches look at */
+#define DEPTH		3
+
+/* Default number of rollouts per candidate, and of candidates */
+#define ROLLOUTS	32
+#define CANDIDATES	4
+
+/* Half the width of a 95% confidence interval, in standard errors (normal approximation) */
+#define Z95			1.959964
+
+/*
+ * Type definitions
+ */
+
+/* How a bot picks its placements */
+typedef enum
+{
+   STYLE_GREEDY,					/* the best board after the current shape */
+   STYLE_BEAM,						/* beam search */
+   STYLE_PLAN						/* planner */
+} style_t;
+
+/* A bot taking part */
+typedef struct
+{
+   const char *name;				/* as given on the command line */
+   style_t style;
+   int width,depth;					/* beam search, or planner depth */
+   plankind_t kind;					/* planner */
+   int rollouts,candidates;
+   weights_t weights;
+} entrant_t;
+
+/* Command line options */
+typedef struct
+{
+   int games;
+   int threads;
+   unsigned int seed;				/* seed the seeds are derived from */
+   const char *seeds;				/* file with the seeds (NULL = derive them) */
+   randomizer_t randomizer;
+   int level;
+   int shapes;						/* stop a game after this many shapes (0 = never) */
+   int budget;						/* milliseconds per move (0 = no limit) */
+   const char *json,*csv;			/* where the results go (NULL = nowhere) */
+   int bots;
+   entrant_t bot[MAXBOTS];
+} options_t;
+
+/* How one bot did in one game */
+typedef struct
+{
+   int score,lines,shapes;
+   int moves;						/* placements picked */
+   int late;						/* ... that took longer than the budget */
+   double slowest;					/* seconds of the slowest one */
+   double seconds;					/* seconds spent picking them */
+   unsigned long long work;			/* boards (or rollouts) the search looked at */
+} outcome_t;
+
+/*
+ * Input of a game that times the bot. The time is taken when a shape
+ * comes out, since that is when the bot picks where to put it.
+ */
+typedef struct
+{
+   input_t input;					/* the bot (first, so this can be passed as one) */
+   bool (*next) (input_t *input,const game_t *game,action_t *action);
+   long budget;						/* microseconds per move (0 = no limit) */
+   int turn;						/* turn that was timed last */
+   outcome_t *outcome;
+} timed_t;
+
+/* The games being played */
+typedef struct
+{
+   const options_t *options;
+   const unsigned int *seeds;		/* seed of every game */
+   outcome_t *outcomes;				/* games of bot 0, then of bot 1, ... */
+} arena_t;
+
+/* Mean of some numbers and half the width of its 95% confidence interval */
+typedef struct
+{
+   double mean,sd,error;
+} summary_t;
+
+/* How a bot did in all its games */
+typedef struct
+{
+   summary_t score,lines,shapes;
+   double min,median,max;			/* scores */
+   summary_t dscore,dlines;			/* differences with the first bot, game by game */
+   int wins,ties,losses;			/* games it scored more, as much or less than the first bot */
+   long moves,late;
+   double slowest,seconds;
+   unsigned long long work;
+} report_t;
+
+/*
+ * Global variables
+ */
+
+static const char *STYLES_STRING[] = { "greedy", "beam", "plan" };
+
+/*
+ * Functions
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-arena [-h] [--bot spec]... [--games n] [--seed n] [--seeds file]\n"
+			"                  [--threads n] [--randomizer name] [--level n] [--shapes n]\n"
+			"                  [--budget ms] [--json file] [--csv file] [--eval kernel]\n");
+   fprintf (stderr,"  -h             Show this help message\n");
+   fprintf (stderr,"  --bot <spec>   A bot that takes part (up to %d, default greedy), one of\n",MAXBOTS);
+   fprintf (stderr,"                   greedy\n");
+   fprintf (stderr,"                   beam:<width>[:<depth>]\n");
+   fprintf (stderr,"                   expectimax[:<depth>]\n");
+   fprintf (stderr,"                   rollouts[:<depth>[:<rollouts>[:<candidates>]]]\n");
+   fprintf (stderr,"                 optionally followed by @<file> to play with the weights in file.\n");
+   fprintf (stderr,"                 The searches look at %d shapes, with %d rollouts of %d candidates,\n",DEPTH,ROLLOUTS,CANDIDATES);
+   fprintf (stderr,"                 unless told otherwise. The first bot is the one the others are compared to\n");
+   fprintf (stderr,"  --games <n>    Games every bot plays (default 100)\n");
+   fprintf (stderr,"  --seed <n>     Seed from which the seed of every game is derived (default 1)\n");
+   fprintf (stderr,"  --seeds <file> Play the seeds in file instead, one per line\n");
+   fprintf (stderr,"  --threads <n>  Number of threads (default: one per processor)\n");
+   fprintf (stderr,"  --randomizer <bag|shuffle|uniform>\n");
+   fprintf (stderr,"                 Where the shapes come from (default bag)\n");
+   fprintf (stderr,"  --level <n>    Level to play at (%d-%d, default %d)\n",MINLEVEL,MAXLEVEL,MINLEVEL);
+   fprintf (stderr,"  --shapes <n>   Stop each game after n shapes, 0 = never (default 1000)\n");
+   fprintf (stderr,"  --budget <ms>  Time a bot has for each move, 0 = no limit (default 0). Results\n");
+   fprintf (stderr,"                 then depend on the speed of the machine\n");
+   fprintf (stderr,"  --json <file>  Write a summary of the results to file\n");
+   fprintf (stderr,"  --csv <file>   Write the outcome of every game to file\n");
+   fprintf (stderr,"  --eval <auto|scalar|sse4.2|avx2>\n");
+   fprintf (stderr,"                 How the boards are measured (default auto: the fastest one the processor supports)\n");
+   exit (EXIT_FAILURE);
+}
+
+/*
+ * Read a bot from its spec (see showhelp ()). Returns FALSE if it isn't
+ * one, or if its weights can't be read (which bot_load () tells).
+ */
+static bool str2entrant (entrant_t *bot,const char *str)
+{
+   char spec[256],*weights,*field[4];
+   int i,n,value[3];
+   if (strlen (str) >= sizeof (spec)) return (FALSE);
+   strcpy (spec,str);
+   bot->name = str;
+   bot->width = 0;
+   bot->depth = DEPTH;
+   bot->rollouts = ROLLOUTS;
+   bot->candidates = CANDIDATES;
+   bot_defaults (&bot->weights);
+   if ((weights = strchr (spec,'@')) != NULL) *weights++ = '\0';
+   field[0] = spec;
+   for (n = 1; n < 4 && (field[n] = strchr (field[n - 1],':')) != NULL; n++)
+	 *field[n]++ = '\0';
+   for (i = 1; i < n; i++)
+	 if (!str2int (&value[i - 1],field[i]) || value[i - 1] <= 0) return (FALSE);
+   if (strcmp (spec,"greedy") == 0 && n == 1)
+	 bot->style = STYLE_GREEDY;
+   else if (strcmp (spec,"beam") == 0 && n >= 2 && n <= 3)
+	 {
+		bot->style = STYLE_BEAM;
+		bot->width = value[0];
+		if (n > 2) bot->depth = value[1];
+	 }
+   else if (str2plan (&bot->kind,spec) && n <= (bot->kind == PLAN_ROLLOUTS ? 4 : 2))
+	 {
+		bot->style = STYLE_PLAN;
+		if (n > 1) bot->depth = value[0];
+		if (n > 2) bot->rollouts = value[1];
+		if (n > 3) bot->candidates = value[2];
+	 }
+   else return (FALSE);
+   return (weights == NULL || bot_load (&bot->weights,weights));
+}
+
+static void parse_options (options_t *options,int argc,char *argv[])
+{
+   int i = 1,n;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-h") == 0)
+		  showhelp ();
+		else if (strcmp (argv[i],"--bot") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (options->bots == MAXBOTS)
+			   {
+				  fprintf (stderr,"Too many bots, at most %d can take part\n",MAXBOTS);
+				  exit (EXIT_FAILURE);
+			   }
+			 if (!str2entrant (&options->bot[options->bots],argv[i]))
+			   {
+				  fprintf (stderr,"Invalid bot -- %s\n",argv[i]);
+				  showhelp ();
+			   }
+			 options->bots++;
+		  }
+		else if (strcmp (argv[i],"--randomizer") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2randomizer (&options->randomizer,argv[i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--eval") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!eval_use (argv[i]))
+			   {
+				  fprintf (stderr,"Kernel not supported -- %s\n",argv[i]);
+				  exit (EXIT_FAILURE);
+			   }
+		  }
+		else if (strcmp (argv[i],"--seeds") == 0 || strcmp (argv[i],"--json") == 0 || strcmp (argv[i],"--csv") == 0)
+		  {
+			 if (i + 1 >= argc) showhelp ();
+			 if (strcmp (argv[i],"--seeds") == 0)
+			   options->seeds = argv[i + 1];
+			 else if (strcmp (argv[i],"--json") == 0)
+			   options->json = argv[i + 1];
+			 else
+			   options->csv = argv[i + 1];
+			 i++;
+		  }
+		else if (i + 1 < argc && str2int (&n,argv[i + 1]) && n >= 0)
+		  {
+			 if (strcmp (argv[i],"--games") == 0 && n > 0)
+			   options->games = n;
+			 else if (strcmp (argv[i],"--threads") == 0 && n > 0)
+			   options->threads = n;
+			 else if (strcmp (argv[i],"--seed") == 0)
+			   options->seed = n;
+			 else if (strcmp (argv[i],"--level") == 0 && n >= MINLEVEL && n <= MAXLEVEL)
+			   options->level = n;
+			 else if (strcmp (argv[i],"--shapes") == 0)
+			   options->shapes = n;
+			 else if (strcmp (argv[i],"--budget") == 0)
+			   options->budget = n;
+			 else
+			   {
+				  fprintf (stderr,"Invalid option -- %s %s\n",argv[i],argv[i + 1]);
+				  showhelp ();
+			   }
+			 i++;
+		  }
+		else
+		  {
+			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
+			 showhelp ();
+		  }
+		i++;
+	 }
+}
+
+/*
+ * Read the seeds of the games from a file, one per line. Empty lines and
+ * lines starting with # are skipped. Returns NULL (and tells why) if the
+ * file can't be read or has no seeds.
+ */
+static unsigned int *readseeds (const char *filename,int *count)
+{
+   FILE *fp;
+   char line[64],*end;
+   unsigned int *seeds = NULL,*more;
+   unsigned long seed;
+   int size = 0,n = 0,lineno = 0;
+   if ((fp = fopen (filename,"r")) == NULL)
+	 {
+		perror (filename);
+		return (NULL);
+	 }
+   while (fgets (line,sizeof (line),fp) != NULL)
+	 {
+		lineno++;
+		line[strcspn (line," \t\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') continue;
+		seed = strtoul (line,&end,0);
+		if (*end != '\0' || seed > UINT_MAX)
+		  {
+			 fprintf (stderr,"%s:%d: invalid seed -- %s\n",filename,lineno,line);
+			 n = 0;
+			 break;
+		  }
+		if (n == size)
+		  {
+			 size = size ? size * 2 : 256;
+			 if ((more = realloc (seeds,size * sizeof (unsigned int))) == NULL)
+			   {
+				  fprintf (stderr,"Not enough memory for %d seeds\n",size);
+				  n = 0;
+				  break;
+			   }
+			 seeds = more;
+		  }
+		seeds[n++] = seed;
+	 }
+   fclose (fp);
+   if (!n)
+	 {
+		if (seeds == NULL) fprintf (stderr,"%s: no seeds\n",filename);
+		free (seeds);
+		return (NULL);
+	 }
+   *count = n;
+   return (seeds);
+}
+
+/* Pass the actions of the bot on, timing the ones that start a turn */
+static bool timed_next (input_t *input,const game_t *game,action_t *action)
+{
+   timed_t *timed = (timed_t *) input;
+   outcome_t *outcome = timed->outcome;
+   struct timeval start,end;
+   double seconds;
+   bool result;
+   if (timed->turn == game->turn) return (timed->next (input,game,action));
+   timed->turn = game->turn;
+   gettimeofday (&start,NULL);
+   result = timed->next (input,game,action);
+   gettimeofday (&end,NULL);
+   seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+   outcome->moves++;
+   outcome->seconds += seconds;
+   if (seconds > outcome->slowest) outcome->slowest = seconds;
+   if (timed->budget && seconds * 1000000.0 > timed->budget) outcome->late++;
+   return (result);
+}
+
+/* Play the index'th game of the arena: game (index % games) of bot (index / games) */
+static void play (void *arg,unsigned long index)
+{
+   arena_t *arena = arg;
+   const options_t *options = arena->options;
+   const entrant_t *bot = &options->bot[index / options->games];
+   unsigned int seed = arena->seeds[index % options->games];
+   outcome_t *outcome = &arena->outcomes[index];
+   game_t game;
+   timed_t timed;
+   beam_t beam;
+   planner_t planner;
+   simresult_t result;
+   memset (outcome,0,sizeof (outcome_t));
+   game_init (&game,options->level,options->randomizer,seed);
+   input_bot (&timed.input,&bot->weights);
+   /* the games already keep the threads busy */
+   if (bot->style == STYLE_BEAM)
+	 {
+		if (!beam_init (&beam,bot->width,bot->depth,1,options->budget * 1000L,&bot->weights,NULL))
+		  {
+			 fprintf (stderr,"Out of memory\n");
+			 exit (EXIT_FAILURE);
+		  }
+		input_beam (&timed.input,&beam);
+	 }
+   else if (bot->style == STYLE_PLAN)
+	 {
+		if (!plan_init (&planner,bot->kind,bot->depth,bot->rollouts,bot->candidates,1,options->budget * 1000L,~seed,&bot->weights,NULL))
+		  {
+			 fprintf (stderr,"Out of memory\n");
+			 exit (EXIT_FAILURE);
+		  }
+		input_plan (&timed.input,&planner);
+	 }
+   timed.next = timed.input.next;
+   timed.input.next = timed_next;
+   timed.budget = options->budget * 1000L;
+   timed.turn = -1;
+   timed.outcome = outcome;
+   sim_play (&game,&timed.input,options->shapes,&result);
+   outcome->score = result.score;
+   outcome->lines = result.lines;
+   outcome->shapes = result.shapes;
+   if (bot->style == STYLE_BEAM)
+	 {
+		outcome->work = atomic_load (&beam.work);
+		beam_free (&beam);
+	 }
+   else if (bot->style == STYLE_PLAN)
+	 {
+		outcome->work = atomic_load (&planner.work);
+		plan_free (&planner);
+	 }
+}
+
+/* Get the mean of n numbers, their standard deviation and the 95% confidence interval of the mean */
+static void summarize (summary_t *summary,const double *x,int n)
+{
+   double sum = 0;
+   int i;
+   for (i = 0; i < n; i++) sum += x[i];
+   summary->mean = sum / n;
+   for (sum = 0, i = 0; i < n; i++) sum += (x[i] - summary->mean) * (x[i] - summary->mean);
+   summary->sd = n > 1 ? sqrt (sum / (n - 1)) : 0;
+   summary->error = Z95 * summary->sd / sqrt (n);
+}
+
+static int compare (const void *a,const void *b)
+{
+   double x = *(const double *) a,y = *(const double *) b;
+   return ((x > y) - (x < y));
+}
+
+/* Units of the work of a bot */
+static const char *unit (const entrant_t *bot)
+{
+   if (bot->style == STYLE_GREEDY) return (NULL);
+   return (bot->style == STYLE_PLAN && bot->kind == PLAN_ROLLOUTS ? "rollouts" : "boards");
+}
+
+/* Write a string as a JSON string */
+static void putstring (FILE *fp,const char *str)
+{
+   fputc ('"',fp);
+   for ( ; *str != '\0'; str++)
+	 if (*str == '"' || *str == '\\')
+	   fprintf (fp,"\\%c",*str);
+	 else if ((unsigned char) *str < ' ')
+	   fprintf (fp,"\\u%04x",*str);
+	 else
+	   fputc (*str,fp);
+   fputc ('"',fp);
+}
+
+/* Write a summary as a JSON object */
+static void putsummary (FILE *fp,const char *name,const summary_t *summary)
+{
+   fprintf (fp,"\"%s\": { \"mean\": %.10g, \"sd\": %.10g, \"ci95\": %.10g }",name,summary->mean,summary->sd,summary->error);
+}
+
+/* Write a string as a CSV field */
+static void putfield (FILE *fp,const char *str)
+{
+   fputc ('"',fp);
+   for ( ; *str != '\0'; str++)
+	 {
+		if (*str == '"') fputc ('"',fp);
+		fputc (*str,fp);
+	 }
+   fputc ('"',fp);
+}
+
+/* Write the outcome of every game as CSV */
+static void writecsv (FILE *fp,const arena_t *arena)
+{
+   const options_t *options = arena->options;
+   const outcome_t *outcome = arena->outcomes;
+   int b,g;
+   fprintf (fp,"bot,name,game,seed,score,lines,shapes,moves,late,slowest_ms,search_seconds,work\n");
+   for (b = 0; b < options->bots; b++)
+	 for (g = 0; g < options->games; g++, outcome++)
+	   {
+		  fprintf (fp,"%d,",b + 1);
+		  putfield (fp,options->bot[b].name);
+		  fprintf (fp,",%d,%u,%d,%d,%d,%d,%d,%.3f,%.6f,%llu\n",g + 1,arena->seeds[g],outcome->score,outcome->lines,outcome->shapes,
+				   outcome->moves,outcome->late,outcome->slowest * 1000.0,outcome->seconds,outcome->work);
+	   }
+}
+
+/* Work out how the b'th bot did, using x for the numbers of every game */
+static void report (report_t *report,const arena_t *arena,int b,double *x)
+{
+   const options_t *options = arena->options;
+   const outcome_t *outcome = arena->outcomes + (size_t) b * options->games,*first = arena->outcomes;
+   int g,n = options->games;
+   memset (report,0,sizeof (report_t));
+   for (g = 0; g < n; g++)
+	 {
+		report->moves += outcome[g].moves;
+		report->late += outcome[g].late;
+		report->seconds += outcome[g].seconds;
+		report->work += outcome[g].work;
+		if (outcome[g].slowest > report->slowest) report->slowest = outcome[g].slowest;
+		if (outcome[g].score > first[g].score)
+		  report->wins++;
+		else if (outcome[g].score < first[g].score)
+		  report->losses++;
+		else
+		  report->ties++;
+	 }
+   /* the games have the same seeds, so the differences vary much less than the scores */
+   for (g = 0; g < n; g++) x[g] = outcome[g].score - first[g].score;
+   summarize (&report->dscore,x,n);
+   for (g = 0; g < n; g++) x[g] = outcome[g].lines - first[g].lines;
+   summarize (&report->dlines,x,n);
+   for (g = 0; g < n; g++) x[g] = outcome[g].lines;
+   summarize (&report->lines,x,n);
+   for (g = 0; g < n; g++) x[g] = outcome[g].shapes;
+   summarize (&report->shapes,x,n);
+   for (g = 0; g < n; g++) x[g] = outcome[g].score;
+   summarize (&report->score,x,n);
+   qsort (x,n,sizeof (double),compare);
+   report->min = x[0];
+   report->median = n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+   report->max = x[n - 1];
+}
+
+/* Print how the b'th bot did */
+static void showreport (const options_t *options,int b,const report_t *report)
+{
+   const entrant_t *bot = &options->bot[b];
+   printf ("bot %d: %s\n",b + 1,bot->name);
+   printf ("  score: mean %.2f +/- %.2f, sd %.2f, min %.0f, median %.1f, max %.0f\n",
+		   report->score.mean,report->score.error,report->score.sd,report->min,report->median,report->max);
+   printf ("  lines: mean %.2f +/- %.2f\n",report->lines.mean,report->lines.error);
+   printf ("  shapes: mean %.2f\n",report->shapes.mean);
+   if (b)
+	 printf ("  vs bot 1: score %+.2f +/- %.2f, lines %+.2f +/- %.2f, %d wins, %d ties, %d losses\n",
+			 report->dscore.mean,report->dscore.error,report->dlines.mean,report->dlines.error,report->wins,report->ties,report->losses);
+   printf ("  speed: %.0f moves/s",report->seconds > 0 ? report->moves / report->seconds : 0);
+   if (unit (bot) != NULL) printf (", %.0f %s/s",report->seconds > 0 ? report->work / report->seconds : 0,unit (bot));
+   printf (", slowest move %.2f ms, %ld late moves\n",report->slowest * 1000.0,report->late);
+}
+
+/* Write how the bots did as JSON */
+static void writejson (FILE *fp,const arena_t *arena,const report_t *reports,int threads,double seconds)
+{
+   const options_t *options = arena->options;
+   const entrant_t *bot;
+   const report_t *report;
+   int b;
+   fprintf (fp,"{\n");
+   fprintf (fp,"  \"board\": { \"cols\": %d, \"rows\": %d },\n",PLAYCOLS,PLAYROWS);
+   fprintf (fp,"  \"kernel\": \"%s\",\n",KERNELS_STRING[eval_kernel ()]);
+   fprintf (fp,"  \"threads\": %d,\n",threads);
+   fprintf (fp,"  \"seconds\": %.3f,\n",seconds);
+   fprintf (fp,"  \"games\": %d,\n",options->games);
+   if (options->seeds != NULL)
+	 {
+		fprintf (fp,"  \"seeds\": ");
+		putstring (fp,options->seeds);
+		fprintf (fp,",\n");
+	 }
+   else fprintf (fp,"  \"seed\": %u,\n",options->seed);
+   fprintf (fp,"  \"randomizer\": \"%s\",\n",RANDOMIZERS_STRING[options->randomizer]);
+   fprintf (fp,"  \"level\": %d,\n",options->level);
+   fprintf (fp,"  \"shapes\": %d,\n",options->shapes);
+   fprintf (fp,"  \"budget_ms\": %d,\n",options->budget);
+   fprintf (fp,"  \"bots\": [\n");
+   for (b = 0; b < options->bots; b++)
+	 {
+		bot = &options->bot[b];
+		report = &reports[b];
+		fprintf (fp,"    {\n      \"name\": ");
+		putstring (fp,bot->name);
+		fprintf (fp,",\n      \"style\": \"%s\",\n",bot->style == STYLE_PLAN ? PLANS_STRING[bot->kind] : STYLES_STRING[bot->style]);
+		if (bot->style == STYLE_BEAM) fprintf (fp,"      \"width\": %d,\n",bot->width);
+		if (bot->style != STYLE_GREEDY) fprintf (fp,"      \"depth\": %d,\n",bot->depth);
+		if (bot->style == STYLE_PLAN && bot->kind == PLAN_ROLLOUTS)
+		  fprintf (fp,"      \"rollouts\": %d,\n      \"candidates\": %d,\n",bot->rollouts,bot->candidates);
+		fprintf (fp,"      ");
+		putsummary (fp,"score",&report->score);
+		fprintf (fp,",\n      \"min\": %.0f,\n      \"median\": %.1f,\n      \"max\": %.0f,\n      ",report->min,report->median,report->max);
+		putsummary (fp,"lines",&report->lines);
+		fprintf (fp,",\n      ");
+		putsummary (fp,"shapes",&report->shapes);
+		fprintf (fp,",\n");
+		if (b)
+		  {
+			 fprintf (fp,"      \"vs_first\": { ");
+			 putsummary (fp,"score",&report->dscore);
+			 fprintf (fp,", ");
+			 putsummary (fp,"lines",&report->dlines);
+			 fprintf (fp,", \"wins\": %d, \"ties\": %d, \"losses\": %d },\n",report->wins,report->ties,report->losses);
+		  }
+		fprintf (fp,"      \"moves\": %ld,\n      \"late\": %ld,\n      \"slowest_ms\": %.3f,\n      \"search_seconds\": %.6f,\n",
+				 report->moves,report->late,report->slowest * 1000.0,report->seconds);
+		fprintf (fp,"      \"moves_per_second\": %.1f,\n",report->seconds > 0 ? report->moves / report->seconds : 0);
+		if (unit (bot) != NULL)
+		  fprintf (fp,"      \"work\": %llu,\n      \"work_unit\": \"%s\",\n      \"work_per_second\": %.1f\n",
+				   report->work,unit (bot),report->seconds > 0 ? report->work / report->seconds : 0);
+		else
+		  fprintf (fp,"      \"work\": null,\n      \"work_unit\": null,\n      \"work_per_second\": null\n");
+		fprintf (fp,"    }%s\n",b < options->bots - 1 ? "," : "");
+	 }
+   fprintf (fp,"  ]\n}\n");
+}
+
+/* Open a file the results are written to, or exit */
+static FILE *create (const char *filename)
+{
+   FILE *fp;
+   if ((fp = fopen (filename,"w")) == NULL)
+	 {
+		perror (filename);
+		exit (EXIT_FAILURE);
+	 }
+   return (fp);
+}
+
+int main (int argc,char *argv[])
+{
+   options_t options = { 100, 0, 1, NULL, RANDOMIZER_BAG, MINLEVEL, 1000, 0, NULL, NULL, 0 };
+   arena_t arena;
+   report_t *reports;
+   unsigned int *seeds;
+   double *x,seconds;
+   struct timeval starttv,endtv;
+   FILE *json = NULL,*csv = NULL;
+   int b,g;
+
+   parse_options (&options,argc,argv);
+   if (!options.threads) options.threads = pool_cpus ();
+   if (!options.bots) str2entrant (&options.bot[options.bots++],"greedy");
+   if (options.seeds != NULL)
+	 {
+		if ((seeds = readseeds (options.seeds,&options.games)) == NULL) exit (EXIT_FAILURE);
+	 }
+   else
+	 {
+		if ((seeds = malloc (options.games * sizeof (unsigned int))) == NULL)
+		  {
+			 fprintf (stderr,"Not enough memory for %d games\n",options.games);
+			 exit (EXIT_FAILURE);
+		  }
+		for (g = 0; g < options.games; g++) seeds[g] = rand_seed (options.seed,g);
+	 }
+   arena.options = &options;
+   arena.seeds = seeds;
+   arena.outcomes = malloc ((size_t) options.bots * options.games * sizeof (outcome_t));
+   reports = malloc (options.bots * sizeof (report_t));
+   x = malloc (options.games * sizeof (double));
+   if (arena.outcomes == NULL || reports == NULL || x == NULL)
+	 {
+		fprintf (stderr,"Not enough memory for %d games\n",options.games);
+		exit (EXIT_FAILURE);
+	 }
+   /* before the games, so a wrong name doesn't throw them away */
+   if (options.json != NULL) json = create (options.json);
+   if (options.csv != NULL) csv = create (options.csv);
+
+   gettimeofday (&starttv,NULL);
+   pool_run (options.threads,(unsigned long) options.bots * options.games,play,&arena);
+   gettimeofday (&endtv,NULL);
+   seconds = (endtv.tv_sec - starttv.tv_sec) + (endtv.tv_usec - starttv.tv_usec) / 1000000.0;
+
+   printf ("games: %d\n",options.games);
+   if (options.seeds != NULL)
+	 printf ("seeds: %s\n",options.seeds);
+   else
+	 printf ("seed: %u\n",options.seed);
+   printf ("randomizer: %s\n",RANDOMIZERS_STRING[options.randomizer]);
+   printf ("level: %d\n",options.level);
+   printf ("shape limit: %d\n",options.shapes);
+   printf ("budget: %d ms\n",options.budget);
+   for (b = 0; b < options.bots; b++)
+	 {
+		report (&reports[b],&arena,b,x);
+		showreport (&options,b,&reports[b]);
+	 }
+   fprintf (stderr,"%d threads, %s kernel, %.2f seconds\n",options.threads,KERNELS_STRING[eval_kernel ()],seconds);
+   if (json != NULL)
+	 {
+		writejson (json,&arena,reports,options.threads,seconds);
+		fclose (json);
+	 }
+   if (csv != NULL)
+	 {
+		writecsv (csv,&arena);
+		fclose (csv);
+	 }
+   free (x);
+   free (reports);
+   free (arena.outcomes);
+   free (seeds);
+   exit (EXIT_SUCCESS);
+}
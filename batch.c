@@ -0,0 +1,539 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-batch plays lots of headless games on all processors and prints
+ * statistics about them. The output only depends on the options, not on
+ * the number of threads or on the order the games finish in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "game.h"
+#include "sim.h"
+#include "bot.h"
+#include "pool.h"
+#include "beam.h"
+#include "plan.h"
+#include "trans.h"
+#include "eval.h"
+#include "export.h"
+#include "board.h"
+
+/*
+ * Macros
+ */
+
+/* Scores are counted in power of two sized buckets */
+#define BUCKETS		32
+
+/* Default number of shapes the beam search and the planners look at */
+#define DEPTH		3
+
+/* Default number of rollouts per candidate, and of candidates */
+#define ROLLOUTS	32
+#define CANDIDATES	4
+
+/* Default size of the table the searches share (in megabytes). Measuring a */
+/* board takes less time than a cache miss, so it is off unless asked for */
+#define TABLEMB		0
+
+/*
+ * Type definitions
+ */
+
+/* Command line options */
+typedef struct
+{
+   unsigned long games;
+   int threads;
+   unsigned int seed;
+   randomizer_t randomizer;
+   int level;
+   int shapes;					/* stop a game after this many shapes (0 = never) */
+   bool random;					/* random play instead of the bot */
+   weights_t weights;			/* what the bot plays for */
+   int width,depth;				/* beam search (width 0 = current shape only) */
+   int budget;					/* milliseconds per search (0 = no limit) */
+   bool plan;					/* plan with a planner instead */
+   plankind_t kind;				/* which one */
+   int rollouts,candidates;		/* rollouts per candidate placement, and number of candidates */
+   int table;					/* megabytes of boards the searches share (0 = none) */
+   const char *record;			/* prefix of the shards the games are recorded in (NULL = none) */
+   bool check;					/* check the kernels against the reference on the boards of the games */
+} options_t;
+
+/*
+ * What the games have in common. Every game only adds to the totals, so
+ * they don't depend on the order in which the games are played.
+ */
+typedef struct
+{
+   const options_t *options;
+   trans_t *table;							/* boards the searches have measured (NULL = none) */
+   exporter_t *exporter;					/* where the games are recorded (NULL = nowhere) */
+   atomic_ullong work;						/* boards of the searches (or rollouts) */
+   int *scores;								/* score of every game */
+   atomic_ullong score,lines,shapes;		/* totals */
+   atomic_int minshapes,maxshapes;
+   atomic_ulong toppedout;					/* games that ended because the board was full */
+   atomic_ulong histogram[BUCKETS];			/* number of games by score */
+   atomic_ullong checked,wrong;				/* boards the kernels were checked on, and got wrong */
+} batch_t;
+
+/* Boards of a game waiting to be checked */
+typedef struct
+{
+   batch_t *batch;
+   const engine_t *engine;
+   evalbatch_t boards;
+} checker_t;
+
+/*
+ * Functions
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-batch [-h] [--games n] [--threads n] [--seed n] [--randomizer name]\n"
+			"                  [--level n] [--shapes n] [--random] [--weights file]\n"
+			"                  [--beam n] [--plan name] [--depth n] [--budget ms] [--rollouts n]\n"
+			"                  [--candidates n] [--table mb] [--eval kernel|check] [--record prefix]\n");
+   fprintf (stderr,"  -h             Show this help message\n");
+   fprintf (stderr,"  --games <n>    Number of games to play (default 1000)\n");
+   fprintf (stderr,"  --threads <n>  Number of threads to use (default: one per processor)\n");
+   fprintf (stderr,"  --seed <n>     Seed from which the seed of every game is derived (default 1)\n");
+   fprintf (stderr,"  --randomizer <bag|shuffle|uniform>\n");
+   fprintf (stderr,"                 Where the shapes come from (default bag)\n");
+   fprintf (stderr,"  --level <n>    Level to play at (%d-%d)\n",MINLEVEL,MAXLEVEL);
+   fprintf (stderr,"  --shapes <n>   Stop each game after n shapes, 0 = never (default 10000)\n");
+   fprintf (stderr,"  --random       Play random actions instead of using the bot\n");
+   fprintf (stderr,"  --weights <file>\n");
+   fprintf (stderr,"                 Weights of the board features the bot plays with\n");
+   fprintf (stderr,"  --beam <n>     Let the bot search ahead keeping the n best boards, 0 = off (default 0)\n");
+   fprintf (stderr,"  --plan <expectimax|rollouts>\n");
+   fprintf (stderr,"                 Let the bot average over the shapes that can come instead\n");
+   fprintf (stderr,"  --depth <n>    Number of shapes the search or planner looks at (default %d)\n",DEPTH);
+   fprintf (stderr,"  --budget <ms>  Time limit of a search, 0 = none (default 0). Results then\n");
+   fprintf (stderr,"                 depend on the speed of the machine\n");
+   fprintf (stderr,"  --rollouts <n> Rollouts per candidate placement (default %d)\n",ROLLOUTS);
+   fprintf (stderr,"  --candidates <n>\n");
+   fprintf (stderr,"                 Placements of the current shape that get rollouts (default %d)\n",CANDIDATES);
+   fprintf (stderr,"  --eval <auto|scalar|sse4.2|avx2>\n");
+   fprintf (stderr,"                 How the boards are measured (default auto: the fastest one the processor supports)\n");
+   fprintf (stderr,"  --eval check   Check every kernel the processor supports against the reference\n");
+   fprintf (stderr,"                 on the boards of the games and on random boards, and fail if one differs\n");
+   fprintf (stderr,"  --table <mb>   Size of the table of boards all searches share, 0 = none (default %d)\n",TABLEMB);
+   fprintf (stderr,"  --record <prefix>\n");
+   fprintf (stderr,"                 Record every shape of every game in shards prefix-NNNNNN.shard (see export.h)\n");
+   exit (EXIT_FAILURE);
+}
+
+static void parse_options (options_t *options,int argc,char *argv[])
+{
+   int i = 1,n;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-h") == 0)
+		  showhelp ();
+		else if (strcmp (argv[i],"--random") == 0)
+		  options->random = TRUE;
+		else if (strcmp (argv[i],"--randomizer") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2randomizer (&options->randomizer,argv[i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--plan") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2plan (&options->kind,argv[i])) showhelp ();
+			 options->plan = TRUE;
+		  }
+		else if (strcmp (argv[i],"--eval") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->check = strcmp (argv[i],"check") == 0;
+			 if (!eval_use (options->check ? "auto" : argv[i]))
+			   {
+				  fprintf (stderr,"Kernel not supported -- %s\n",argv[i]);
+				  exit (EXIT_FAILURE);
+			   }
+		  }
+		else if (strcmp (argv[i],"--record") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->record = argv[i];
+		  }
+		else if (strcmp (argv[i],"--weights") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!bot_load (&options->weights,argv[i])) exit (EXIT_FAILURE);
+		  }
+		else if (i + 1 < argc && str2int (&n,argv[i + 1]) && n >= 0)
+		  {
+			 if (strcmp (argv[i],"--games") == 0 && n > 0)
+			   options->games = n;
+			 else if (strcmp (argv[i],"--threads") == 0 && n > 0)
+			   options->threads = n;
+			 else if (strcmp (argv[i],"--seed") == 0)
+			   options->seed = n;
+			 else if (strcmp (argv[i],"--level") == 0 && n >= MINLEVEL && n <= MAXLEVEL)
+			   options->level = n;
+			 else if (strcmp (argv[i],"--shapes") == 0)
+			   options->shapes = n;
+			 else if (strcmp (argv[i],"--beam") == 0)
+			   options->width = n;
+			 else if (strcmp (argv[i],"--depth") == 0 && n > 0)
+			   options->depth = n;
+			 else if (strcmp (argv[i],"--budget") == 0)
+			   options->budget = n;
+			 else if (strcmp (argv[i],"--table") == 0)
+			   options->table = n;
+			 else if (strcmp (argv[i],"--rollouts") == 0 && n > 0)
+			   options->rollouts = n;
+			 else if (strcmp (argv[i],"--candidates") == 0 && n > 0)
+			   options->candidates = n;
+			 else
+			   {
+				  fprintf (stderr,"Invalid option -- %s %s\n",argv[i],argv[i + 1]);
+				  showhelp ();
+			   }
+			 i++;
+		  }
+		else
+		  {
+			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
+			 showhelp ();
+		  }
+		i++;
+	 }
+}
+
+/* Index of the histogram bucket for the specified score */
+static int bucket (int score)
+{
+   int n = 0;
+   while (score > 0 && n < BUCKETS - 1)
+	 {
+		score >>= 1;
+		n++;
+	 }
+   return (n);
+}
+
+static void atomic_min (atomic_int *value,int n)
+{
+   int old = atomic_load (value);
+   while (n < old && !atomic_compare_exchange_weak (value,&old,n)) ;
+}
+
+static void atomic_max (atomic_int *value,int n)
+{
+   int old = atomic_load (value);
+   while (n > old && !atomic_compare_exchange_weak (value,&old,n)) ;
+}
+
+/* Check the boards that are waiting, and start over */
+static void check (checker_t *checker)
+{
+   atomic_fetch_add (&checker->batch->checked,checker->boards.count);
+   atomic_fetch_add (&checker->batch->wrong,eval_check (&checker->boards));
+   checker->boards.count = 0;
+}
+
+/* Hook on the engine: every board a shape comes out on gets checked */
+static void checked (const event_t *event,void *arg)
+{
+   checker_t *checker = arg;
+   eval_add (&checker->boards,checker->engine->board.rows,checker->engine->status.currentdroppedlines);
+   if (checker->boards.count == EVALBATCH) check (checker);
+}
+
+/* Check a batch of random boards, from stacks with a few cells to full ones */
+static void checkrandom (checker_t *checker,unsigned int seed)
+{
+   row_t rows[NUMROWS];
+   int i,y,x,top,density;
+   for (i = 0; i < EVALBATCH; i++)
+	 {
+		board_clear (rows);
+		top = rand_value_r (&seed,NUMROWS - 1);
+		density = 1 + rand_value_r (&seed,8);
+		for (y = top; y < NUMROWS - 2; y++)
+		  for (x = 1; x < NUMCOLS - 2; x++)
+			if (rand_value_r (&seed,8) < density) rows[y] |= BIT (x);
+		eval_add (&checker->boards,rows,rand_value_r (&seed,5));
+	 }
+   check (checker);
+}
+
+/* Play the index'th game of the batch */
+static void play (void *arg,unsigned long index)
+{
+   batch_t *batch = arg;
+   const options_t *options = batch->options;
+   game_t game;
+   input_t input;
+   beam_t beam;
+   planner_t planner;
+   simresult_t result;
+   recorder_t recorder;
+   checker_t *checker = NULL;
+   game_init (&game,options->level,options->randomizer,rand_seed (options->seed,index));
+   if (options->check)
+	 {
+		if ((checker = malloc (sizeof (checker_t))) == NULL)
+		  {
+			 fprintf (stderr,"Out of memory\n");
+			 exit (EXIT_FAILURE);
+		  }
+		checker->batch = batch;
+		checker->engine = &game.engine;
+		checker->boards.count = 0;
+		if (!engine_hook (&game.engine,EVENT_BIT (EVENT_SPAWN) | EVENT_BIT (EVENT_GAMEOVER),checked,checker))
+		  {
+			 fprintf (stderr,"No room for a hook to check the kernels\n");
+			 exit (EXIT_FAILURE);
+		  }
+		/* the board the first shape came out on */
+		eval_add (&checker->boards,game.engine.board.rows,0);
+	 }
+   if (batch->exporter != NULL && !export_start (batch->exporter,&recorder,&game,index))
+	 {
+		fprintf (stderr,"No room for a hook to record the games\n");
+		exit (EXIT_FAILURE);
+	 }
+   if (options->random)
+	 input_random (&input,rand_seed (~options->seed,index));
+   else
+	 {
+		input_bot (&input,&options->weights);
+		if (options->width)
+		  {
+			 /* the games already keep the threads busy */
+			 if (!beam_init (&beam,options->width,options->depth,1,options->budget * 1000L,&options->weights,batch->table))
+			   {
+				  fprintf (stderr,"Out of memory\n");
+				  exit (EXIT_FAILURE);
+			   }
+			 input_beam (&input,&beam);
+		  }
+		else if (options->plan)
+		  {
+			 if (!plan_init (&planner,options->kind,options->depth,options->rollouts,options->candidates,1,options->budget * 1000L,
+							 rand_seed (~options->seed,index),&options->weights,batch->table))
+			   {
+				  fprintf (stderr,"Out of memory\n");
+				  exit (EXIT_FAILURE);
+			   }
+			 input_plan (&input,&planner);
+		  }
+	 }
+   sim_play (&game,&input,options->shapes,&result);
+   if (batch->exporter != NULL) export_stop (&recorder);
+   if (checker != NULL)
+	 {
+		engine_unhook (&game.engine,checked,checker);
+		if (checker->boards.count) check (checker);
+		checkrandom (checker,rand_seed (~options->seed,~index));
+		free (checker);
+	 }
+   if (!options->random && options->width)
+	 {
+		atomic_fetch_add (&batch->work,atomic_load (&beam.work));
+		beam_free (&beam);
+	 }
+   if (!options->random && !options->width && options->plan)
+	 {
+		atomic_fetch_add (&batch->work,atomic_load (&planner.work));
+		plan_free (&planner);
+	 }
+   batch->scores[index] = result.score;
+   atomic_fetch_add (&batch->score,result.score);
+   atomic_fetch_add (&batch->lines,result.lines);
+   atomic_fetch_add (&batch->shapes,result.shapes);
+   atomic_min (&batch->minshapes,result.shapes);
+   atomic_max (&batch->maxshapes,result.shapes);
+   if (!options->shapes || result.shapes < options->shapes) atomic_fetch_add (&batch->toppedout,1);
+   atomic_fetch_add (&batch->histogram[bucket (result.score)],1);
+}
+
+static int compare (const void *a,const void *b)
+{
+   int x = *(const int *) a,y = *(const int *) b;
+   return ((x > y) - (x < y));
+}
+
+/* Print the statistics of a finished batch */
+static void showstats (batch_t *batch)
+{
+   const options_t *options = batch->options;
+   unsigned long n = options->games;
+   int i,first,last;
+   qsort (batch->scores,n,sizeof (int),compare);
+   printf ("games: %lu\n",n);
+   printf ("seed: %u\n",options->seed);
+   printf ("randomizer: %s\n",RANDOMIZERS_STRING[options->randomizer]);
+   printf ("input: %s\n",options->random ? "random" : "bot");
+   if (!options->random)
+	 {
+		printf ("weights:");
+		for (i = 0; i < NUMFEATURES; i++) printf ("%s %s %g",i ? "," : "",FEATURES_STRING[i],options->weights.weight[i]);
+		printf ("\n");
+		if (options->width)
+		  printf ("search: beam %d, depth %d, budget %d ms\n",options->width,options->depth,options->budget);
+		else if (options->plan && options->kind == PLAN_ROLLOUTS)
+		  printf ("search: rollouts, depth %d, %d rollouts, %d candidates\n",options->depth,options->rollouts,options->candidates);
+		else if (options->plan)
+		  printf ("search: expectimax, depth %d\n",options->depth);
+	 }
+   printf ("level: %d\n",options->level);
+   printf ("shape limit: %d\n",options->shapes);
+   printf ("topped out: %lu\n",(unsigned long) atomic_load (&batch->toppedout));
+   printf ("score: mean %.2f, min %d, p10 %d, median %d, p90 %d, max %d\n",
+		   (double) atomic_load (&batch->score) / n,batch->scores[0],
+		   batch->scores[n / 10],batch->scores[n / 2],batch->scores[n * 9 / 10],batch->scores[n - 1]);
+   printf ("lines: mean %.2f, total %llu\n",
+		   (double) atomic_load (&batch->lines) / n,(unsigned long long) atomic_load (&batch->lines));
+   printf ("shapes: mean %.2f, min %d, max %d\n",
+		   (double) atomic_load (&batch->shapes) / n,atomic_load (&batch->minshapes),atomic_load (&batch->maxshapes));
+   printf ("score histogram:\n");
+   for (first = 0; first < BUCKETS - 1 && !atomic_load (&batch->histogram[first]); first++) ;
+   for (last = BUCKETS - 1; last > first && !atomic_load (&batch->histogram[last]); last--) ;
+   for (i = first; i <= last; i++)
+	 printf ("  %10u - %-10u %lu\n",i ? 1U << (i - 1) : 0,i ? (1U << i) - 1 : 0,
+			 (unsigned long) atomic_load (&batch->histogram[i]));
+}
+
+int main (int argc,char *argv[])
+{
+   options_t options = { 1000, 0, 1, RANDOMIZER_BAG, MINLEVEL, 10000, FALSE };
+   batch_t batch;
+   struct timeval starttv,endtv;
+   double seconds;
+   int i;
+
+   bot_defaults (&options.weights);
+   options.depth = DEPTH;
+   options.rollouts = ROLLOUTS;
+   options.candidates = CANDIDATES;
+   options.table = TABLEMB;
+   parse_options (&options,argc,argv);
+   if (!options.threads) options.threads = pool_cpus ();
+   if (options.width && options.plan)
+	 {
+		fprintf (stderr,"Choose either a beam search or a planner\n");
+		exit (EXIT_FAILURE);
+	 }
+
+   batch.options = &options;
+   batch.table = NULL;
+   batch.exporter = NULL;
+   atomic_init (&batch.work,0);
+   if (!options.random && (options.width || options.plan) && options.table)
+	 {
+		static trans_t table;
+		if (!trans_init (&table,(size_t) options.table << 20))
+		  {
+			 fprintf (stderr,"Not enough memory for a table of %d MB\n",options.table);
+			 exit (EXIT_FAILURE);
+		  }
+		batch.table = &table;
+	 }
+   if (options.record != NULL)
+	 {
+		static exporter_t exporter;
+		if (!export_open (&exporter,options.record,SHARDRECORDS))
+		  {
+			 fprintf (stderr,"Could not start writing shards\n");
+			 exit (EXIT_FAILURE);
+		  }
+		batch.exporter = &exporter;
+	 }
+   if ((batch.scores = malloc (options.games * sizeof (int))) == NULL)
+	 {
+		fprintf (stderr,"Not enough memory for %lu games\n",options.games);
+		exit (EXIT_FAILURE);
+	 }
+   atomic_init (&batch.score,0);
+   atomic_init (&batch.lines,0);
+   atomic_init (&batch.shapes,0);
+   atomic_init (&batch.minshapes,INT_MAX);
+   atomic_init (&batch.maxshapes,0);
+   atomic_init (&batch.toppedout,0);
+   for (i = 0; i < BUCKETS; i++) atomic_init (&batch.histogram[i],0);
+   atomic_init (&batch.checked,0);
+   atomic_init (&batch.wrong,0);
+
+   gettimeofday (&starttv,NULL);
+   pool_run (options.threads,options.games,play,&batch);
+   gettimeofday (&endtv,NULL);
+   seconds = (endtv.tv_sec - starttv.tv_sec) + (endtv.tv_usec - starttv.tv_usec) / 1000000.0;
+
+   showstats (&batch);
+   /* timings differ from run to run, so they don't go with the statistics */
+   fprintf (stderr,"%d threads, %s kernel, %.2f seconds, %.0f games/s, %.0f shapes/s\n",options.threads,KERNELS_STRING[eval_kernel ()],
+			seconds,options.games / seconds,atomic_load (&batch.shapes) / seconds);
+   if (!options.random && (options.width || options.plan))
+	 fprintf (stderr,"%.0f %s/s\n",atomic_load (&batch.work) / seconds,!options.width && options.kind == PLAN_ROLLOUTS ? "rollouts" : "boards");
+   /* so do the hits, once the threads race for the table */
+   if (batch.table != NULL)
+	 {
+		unsigned long long hits = atomic_load (&batch.table->hits),misses = atomic_load (&batch.table->misses);
+		fprintf (stderr,"table: %d MB, %llu hits, %llu misses (%.1f%% hits), %llu stored, %llu replaced\n",options.table,hits,misses,
+				 hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+				 (unsigned long long) atomic_load (&batch.table->stores),(unsigned long long) atomic_load (&batch.table->replaced));
+		trans_free (batch.table);
+	 }
+   free (batch.scores);
+   if (batch.exporter != NULL)
+	 {
+		if (!export_close (batch.exporter)) exit (EXIT_FAILURE);
+		fprintf (stderr,"recorded: %llu shapes in %u shards\n",batch.exporter->written,batch.exporter->shards);
+	 }
+   if (options.check)
+	 {
+		fprintf (stderr,"eval check:");
+		for (i = 0; i <= (int) eval_kernel (); i++) fprintf (stderr,"%s %s",i ? "," : "",KERNELS_STRING[i]);
+		fprintf (stderr," against the reference on %llu boards, %llu wrong\n",
+				 (unsigned long long) atomic_load (&batch.checked),(unsigned long long) atomic_load (&batch.wrong));
+		if (atomic_load (&batch.wrong)) exit (EXIT_FAILURE);
+	 }
+   exit (EXIT_SUCCESS);
+}
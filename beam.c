@@ -0,0 +1,339 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "place.h"
+#include "bot.h"
+#include "pool.h"
+#include "trans.h"
+#include "eval.h"
+#include "beam.h"
+
+/*
+ * Type definitions
+ */
+
+/* One shape further down the search, expanded by the workers of the pool */
+typedef struct
+{
+   beam_t *beam;
+   int shape;						/* shape put on every board, or -1 to try every possible one */
+   int next;						/* shape after it, or -1 if it isn't known */
+   bool bag;						/* shapes come in bags (else any shape can come any time) */
+   bool timed;						/* there is a deadline */
+   struct timeval deadline;
+   atomic_bool expired;			/* ran out of time, the layer is incomplete */
+} layer_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a beam search with the given settings (see beam_t). The table
+ * may be shared with other searches (and threads) that use the same
+ * weights. Returns FALSE if there is not enough memory.
+ */
+bool beam_init (beam_t *beam,int width,int depth,int threads,long budget,const weights_t *weights,trans_t *table)
+{
+   size_t jobs = (size_t) width * NUMSHAPES,children = jobs * width;
+   if (children < PLACESTATES) children = PLACESTATES;
+   beam->width = width;
+   beam->depth = depth;
+   beam->threads = threads;
+   beam->pool = NULL;
+   beam->budget = budget;
+   beam->stop = NULL;
+   beam->weights = *weights;
+   beam->table = table;
+   atomic_init (&beam->work,0);
+   beam->beam = malloc (width * sizeof (beamnode_t));
+   beam->children = malloc (children * sizeof (beamnode_t));
+   beam->count = malloc (jobs * sizeof (int));
+   beam->best = malloc (jobs * sizeof (double));
+   beam->order = malloc (children * sizeof (beamnode_t *));
+   /* every layer of every search is a round of the pool, so its threads stay around */
+   if (threads > 1) beam->pool = pool_start (threads);
+   if (beam->beam == NULL || beam->children == NULL || beam->count == NULL || beam->best == NULL || beam->order == NULL ||
+	   (threads > 1 && beam->pool == NULL))
+	 {
+		beam_free (beam);
+		return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/*
+ * Release the memory of a beam search
+ */
+void beam_free (beam_t *beam)
+{
+   if (beam->pool != NULL) pool_stop (beam->pool);
+   beam->pool = NULL;
+   free (beam->beam);
+   free (beam->children);
+   free (beam->count);
+   free (beam->best);
+   free (beam->order);
+   beam->beam = beam->children = NULL;
+   beam->count = NULL;
+   beam->best = NULL;
+   beam->order = NULL;
+}
+
+/* Check if the layer is out of time (or the search was stopped) */
+static bool expired (layer_t *layer)
+{
+   struct timeval now;
+   if (atomic_load (&layer->expired)) return (TRUE);
+   if (layer->beam->stop != NULL && atomic_load (layer->beam->stop))
+	 {
+		atomic_store (&layer->expired,TRUE);
+		return (TRUE);
+	 }
+   if (!layer->timed) return (FALSE);
+   gettimeofday (&now,NULL);
+   if (!timercmp (&now,&layer->deadline,>)) return (FALSE);
+   atomic_store (&layer->expired,TRUE);
+   return (TRUE);
+}
+
+/* Put a shape on a board of the search */
+static void place (const beamnode_t *node,beamnode_t *child,int shape,const placement_t *placement)
+{
+   const rotation_t *rot = &SHAPES[shape].rotation[placement->orient];
+   int x = placement->x,y = placement->y;
+   memcpy (child->rows,node->rows,sizeof (child->rows));
+   memcpy (child->height,node->height,sizeof (child->height));
+   memcpy (child->fill,node->fill,sizeof (child->fill));
+   child->holes = node->holes;
+   child->lines = board_place (child->rows,child->height,child->fill,&child->holes,rot,x,y);
+   /* rows moved (or blocks were lost off the top), just start over */
+   if (child->lines || y + rot->miny == 0)
+	 child->hash = board_hash (child->rows);
+   else
+	 child->hash = node->hash ^ board_hashshape (rot,x,y);
+}
+
+/*
+ * Work out the values of n children of a board, measuring the ones that
+ * aren't in the table together. A child is lost if the next shape (if
+ * known) can't come out on it.
+ */
+static void judge (const beam_t *beam,const beamnode_t *node,beamnode_t *children,int n,int next)
+{
+   evalbatch_t batch;
+   beamnode_t *child,*measured[EVALBATCH];
+   double value[EVALBATCH],lines;
+   int i,depth;
+   batch.count = 0;
+   for (i = 0; i < n; i++)
+	 if (beam->table == NULL || !trans_probe (beam->table,children[i].hash,&children[i].value,&depth))
+	   {
+		  measured[batch.count] = &children[i];
+		  eval_add (&batch,children[i].rows,0);
+	   }
+   eval_scores (&batch,&beam->weights,value);
+   for (i = 0; i < batch.count; i++)
+	 {
+		measured[i]->value = value[i];
+		if (beam->table != NULL) trans_store (beam->table,measured[i]->hash,value[i],0);
+	 }
+   for (child = children; child < children + n; child++)
+	 {
+		/* same sum as bot_place () */
+		lines = beam->weights.weight[FEATURE_LINES] * child->lines;
+		child->value = node->reward + (child->value + lines);
+		child->reward = node->reward + lines;
+		if (next >= 0 && !board_allowed (child->rows,&SHAPES[next].rotation[0],SPAWNX,SPAWNY)) child->value = LOST;
+		child->rank = child->value;
+	 }
+}
+
+/*
+ * Job of the pool: put one shape on one board of the beam in every way
+ * possible, and keep the width best boards that come out of it
+ */
+static void expand (void *arg,unsigned long index)
+{
+   layer_t *layer = arg;
+   beam_t *beam = layer->beam;
+   const beamnode_t *node = &beam->beam[layer->shape < 0 ? index / NUMSHAPES : index];
+   beamnode_t *children = beam->children + index * beam->width,*child,built[EVALBATCH];
+   int shape = layer->shape < 0 ? (int) (index % NUMSHAPES) : layer->shape;
+   unsigned int remaining = node->remaining;
+   places_t places;
+   int i,j,k,n,count = 0,worst = 0;
+   beam->count[index] = -1;
+   beam->best[index] = LOST;
+   if (layer->shape < 0 && layer->bag)
+	 {
+		if (!remaining) remaining = ALLSHAPES;
+		if (!(remaining & (1U << shape))) return;		/* can't come next */
+		remaining &= ~(1U << shape);
+	 }
+   beam->count[index] = 0;
+   if (expired (layer)) return;
+   place_find (&places,node->rows,shape,0,SPAWNX,SPAWNY);
+   atomic_fetch_add (&beam->work,places.count);
+   for (i = 0; i < places.count; i += n)
+	 {
+		n = places.count - i < EVALBATCH ? places.count - i : EVALBATCH;
+		for (j = 0; j < n; j++) place (node,&built[j],shape,&places.placement[i + j]);
+		judge (beam,node,built,n,layer->next);
+		for (child = built; child < built + n; child++)
+		  {
+			 child->first = node->first;
+			 child->remaining = remaining;
+			 if (child->value > beam->best[index]) beam->best[index] = child->value;
+			 if (count < beam->width)
+			   children[count++] = *child;
+			 else if (child->value > children[worst].value)
+			   children[worst] = *child;
+			 else continue;
+			 if (count == beam->width)
+			   for (worst = 0, k = 1; k < count; k++)
+				 if (children[k].value < children[worst].value) worst = k;
+		  }
+	 }
+   beam->count[index] = count;
+}
+
+/* Best rank first, and the order they were found in for equal ranks */
+static int compare (const void *a,const void *b)
+{
+   const beamnode_t *x = *(beamnode_t * const *) a,*y = *(beamnode_t * const *) b;
+   if (x->rank != y->rank) return (x->rank < y->rank ? 1 : -1);
+   return ((x > y) - (x < y));
+}
+
+/* Keep the width best of the given children in the beam, each board only once. Returns the number of boards kept */
+static int keep (beam_t *beam,int n)
+{
+   int i,j,kept = 0;
+   qsort (beam->order,n,sizeof (beamnode_t *),compare);
+   for (i = 0; i < n && kept < beam->width; i++)
+	 {
+		for (j = 0; j < kept; j++)
+		  if (beam->beam[j].hash == beam->order[i]->hash && beam->beam[j].remaining == beam->order[i]->remaining) break;
+		if (j == kept) beam->beam[kept++] = *beam->order[i];
+	 }
+   return (kept);
+}
+
+/*
+ * Find the placements of the current shape of the specified tetris engine
+ * (see place_find ()) and pick one. If the search runs out of time (or is
+ * stopped), the best placement of the last shape it looked at all the way
+ * is picked.
+ * Returns the index of the placement, or -1 if there is none.
+ */
+int beam_search (beam_t *beam,const engine_t *engine,places_t *places)
+{
+   layer_t layer;
+   beamnode_t root;
+   int i,j,k,d,n,nodes,jobs,tries,best;
+   double expect = 0;
+   layer.beam = beam;
+   layer.bag = engine->randomizer != RANDOMIZER_UNIFORM;
+   layer.timed = beam->budget > 0;
+   atomic_init (&layer.expired,FALSE);
+   if (beam->table != NULL) trans_age (beam->table);
+   if (layer.timed)
+	 {
+		struct timeval budget = { beam->budget / 1000000, beam->budget % 1000000 };
+		gettimeofday (&layer.deadline,NULL);
+		timeradd (&layer.deadline,&budget,&layer.deadline);
+	 }
+   /* the current shape, from where it is now */
+   memcpy (root.rows,engine->board.rows,sizeof (root.rows));
+   memcpy (root.height,engine->height,sizeof (root.height));
+   memcpy (root.fill,engine->fill,sizeof (root.fill));
+   root.holes = engine->holes;
+   root.hash = engine->boardhash;
+   root.reward = 0;
+   root.remaining = engine_bag (engine);
+   if (!place_find (places,engine->board.rows,engine->curshape,engine->curorient,engine->curx,engine->cury)) return (-1);
+   atomic_fetch_add (&beam->work,places->count);
+   for (i = 0; i < places->count; i++)
+	 {
+		place (&root,&beam->children[i],engine->curshape,&places->placement[i]);
+		beam->children[i].first = i;
+		beam->children[i].remaining = root.remaining;
+		beam->order[i] = &beam->children[i];
+	 }
+   for (i = 0; i < places->count; i += EVALBATCH)
+	 judge (beam,&root,beam->children + i,places->count - i < EVALBATCH ? places->count - i : EVALBATCH,engine->nextshape);
+   nodes = keep (beam,places->count);
+   best = beam->beam[0].first;
+   /* then the next shape, and then every shape that can come */
+   for (d = 1; d < beam->depth && beam->beam[0].value > LOST; d++)
+	 {
+		layer.shape = d == 1 ? engine->nextshape : -1;
+		layer.next = -1;
+		jobs = layer.shape < 0 ? nodes * NUMSHAPES : nodes;
+		if (beam->pool != NULL)
+		  pool_do (beam->pool,jobs,expand,&layer);
+		else
+		  for (j = 0; j < jobs; j++) expand (&layer,j);
+		if (atomic_load (&layer.expired)) break;
+		for (n = 0, j = 0; j < jobs; j++)
+		  {
+			 /* a guessed shape is worth what the board it came from can */
+			 /* expect over all the shapes, less what was lost by placing it worse */
+			 if (layer.shape < 0 && j % NUMSHAPES == 0)
+			   {
+				  for (expect = 0, tries = 0, k = j; k < j + NUMSHAPES; k++)
+					if (beam->count[k] >= 0)
+					  {
+						 expect += beam->best[k];
+						 tries++;
+					  }
+				  expect /= tries;
+			   }
+			 for (i = 0; i < beam->count[j]; i++)
+			   {
+				  beamnode_t *child = &beam->children[j * beam->width + i];
+				  if (layer.shape < 0) child->rank = expect + child->value - beam->best[j];
+				  beam->order[n++] = child;
+			   }
+		  }
+		if (!n) break;
+		nodes = keep (beam,n);
+		best = beam->beam[0].first;
+	 }
+   return (best);
+}
@@ -0,0 +1,114 @@
+#ifndef BEAM_H
+#define BEAM_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t, row_t */
+#include "place.h"			/* places_t */
+#include "bot.h"			/* weights_t */
+#include "trans.h"			/* trans_t */
+#include "pool.h"			/* pool_t */
+
+/*
+ * Type definitions
+ */
+
+/* A board the search got to */
+typedef struct
+{
+   row_t rows[NUMROWS];
+   unsigned char height[NUMCOLS];
+   unsigned char fill[NUMROWS];
+   int holes;
+   uint64_t hash;					/* Zobrist hash of the occupied cells */
+   int lines;						/* lines the last shape removed */
+   int first;						/* placement of the current shape it started with */
+   unsigned int remaining;			/* shapes left in the bag (bit s for shape s) */
+   double reward;					/* weighted lines removed on the way */
+   double value;					/* reward plus how the bot likes the board */
+   double rank;						/* value, or what to expect from the parent if the shape was guessed */
+} beamnode_t;
+
+/*
+ * A beam search: the width best boards are kept after each shape, for depth
+ * shapes. The current and next shape are known; after that every shape that
+ * is still in the bag (or any, once it is empty) is tried, and the boards are
+ * ranked by what can be expected from their parent over those shapes, so
+ * that lucky shapes don't take over the beam. The same board can be reached
+ * in different ways; it is only kept once, and it is only measured once if
+ * there is a table to look it up in.
+ */
+typedef struct
+{
+   int width;						/* boards kept after each shape */
+   int depth;						/* shapes looked at, the current one included */
+   int threads;						/* threads the boards are expanded with */
+   pool_t *pool;					/* the ones besides the caller (NULL = none) */
+   long budget;						/* microseconds a search may take (0 = no limit) */
+   atomic_bool *stop;				/* set by another thread to cut the search short (NULL = never) */
+   weights_t weights;				/* what the bot looks for in a board */
+   trans_t *table;					/* values of the boards looked at so far (NULL = none) */
+   beamnode_t *beam;				/* width boards */
+   beamnode_t *children;			/* up to width children per board and shape */
+   int *count;						/* number of children per board and shape */
+   double *best;					/* value of the best child per board and shape */
+   beamnode_t **order;				/* children sorted by rank */
+   atomic_ullong work;				/* boards looked at so far */
+} beam_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a beam search with the given settings (see beam_t). The table
+ * may be shared with other searches (and threads) that use the same
+ * weights. Returns FALSE if there is not enough memory.
+ */
+bool beam_init (beam_t *beam,int width,int depth,int threads,long budget,const weights_t *weights,trans_t *table);
+
+/*
+ * Release the memory of a beam search
+ */
+void beam_free (beam_t *beam);
+
+/*
+ * Find the placements of the current shape of the specified tetris engine
+ * (see place_find ()) and pick one. If the search runs out of time (or is
+ * stopped), the best placement of the last shape it looked at all the way
+ * is picked.
+ * Returns the index of the placement, or -1 if there is none.
+ */
+int beam_search (beam_t *beam,const engine_t *engine,places_t *places);
+
+#endif	/* #ifndef BEAM_H */
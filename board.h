@@ -0,0 +1,345 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The kernels that move shapes around a board, lock them and remove full
+ * lines. They only work on plain arrays, so that the engine and the batch
+ * engine (which keeps the boards of many games side by side) share them.
+ *
+ * A board is described by:
+ *   rows     NUMROWS rows of occupied cells (walls included)
+ *   height   height of the surface of each column above the floor
+ *   fill     number of occupied cells in each row (walls excluded)
+ *   holes    number of empty cells below the surface
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* row_t, rotation_t */
+
+/*
+ * Macros
+ */
+
+/* Row of the surface of column x, i.e. the topmost occupied cell or the floor */
+#define SURFACE(height,x) (NUMROWS - 2 - (height)[x])
+
+/* Numbers of the Zobrist keys of a cell, the current and next shape, and the shapes left in the bag */
+#define ZOBRIST_CELL(x,y)	((y) * NUMCOLS + (x))
+#define ZOBRIST_SHAPE(s)	(NUMROWS * NUMCOLS + (s))
+#define ZOBRIST_NEXT(s)	(NUMROWS * NUMCOLS + NUMSHAPES + (s))
+#define ZOBRIST_BAG(left)	(NUMROWS * NUMCOLS + 2 * NUMSHAPES + (left))
+
+/* Rows of a packed board (the hidden row and the playfield), and the 64-bit words it takes */
+#define PACKROWS	(NUMROWS - 2)
+#define PACKWORDS	((PACKROWS * PLAYCOLS + 63) / 64)
+
+/* Every shape (an empty bag is filled with these) */
+#define ALLSHAPES	((1U << NUMSHAPES) - 1)
+
+/*
+ * Type definitions
+ */
+
+/* A board of a search, kept the way the engine keeps it */
+typedef struct
+{
+   row_t rows[NUMROWS];
+   unsigned char height[NUMCOLS];
+   unsigned char fill[NUMROWS];
+   int holes;
+} boardnode_t;
+
+/*
+ * Functions
+ */
+
+/* shuffle int array */
+void shuffle (unsigned int *rng,int *array,size_t n);
+
+/* Fill in the index'th bag of shapes */
+void bag_fill (randomizer_t randomizer,unsigned int *rng,unsigned long index,int *bag);
+
+/* Number of cells set in a row (without relying on a popcount instruction) */
+static inline int board_cells (row_t row)
+{
+   uint64_t n = row;
+   n -= (n >> 1) & 0x5555555555555555ULL;
+   n = (n & 0x3333333333333333ULL) + ((n >> 2) & 0x3333333333333333ULL);
+   n = (n + (n >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+   return ((int) ((n * 0x0101010101010101ULL) >> 56));
+}
+
+/*
+ * Zobrist key number n. The keys are worked out when they are needed (the
+ * splitmix64 finalizer of n) rather than kept in a table, so they are the
+ * same in every run and there is nothing to set up.
+ */
+static inline uint64_t board_key (unsigned int n)
+{
+   uint64_t z = (uint64_t) (n + 1) * 0x9e3779b97f4a7c15ULL;
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+   return (z ^ (z >> 31));
+}
+
+/* Zobrist hash of the occupied cells of rows top to bottom (walls excluded) */
+static inline uint64_t board_hashrows (const row_t *rows,int top,int bottom)
+{
+   uint64_t hash = 0;
+   row_t row;
+   int y;
+   for (y = top; y <= bottom; y++)
+	 for (row = rows[y] & (FULLROW & ~WALLROW); row; row &= row - 1)
+	   hash ^= board_key (ZOBRIST_CELL (__builtin_ctzll (row),y));
+   return (hash);
+}
+
+/* Zobrist hash of the occupied cells of the board */
+static inline uint64_t board_hash (const row_t *rows)
+{
+   return (board_hashrows (rows,0,NUMROWS - 3));
+}
+
+/*
+ * Pack the occupied cells of a board without its walls and floor, row after
+ * row from the hidden one down: cell x (0 = left) of row y is bit
+ * (y * PLAYCOLS + x) % 64 of word (y * PLAYCOLS + x) / 64 of PACKWORDS
+ */
+static inline void board_pack (const row_t *rows,uint64_t *words)
+{
+   uint64_t word = 0,cells;
+   int y,bits = 0;
+   for (y = 0; y < PACKROWS; y++)
+	 {
+		cells = (uint64_t) (rows[y] & (FULLROW & ~WALLROW)) >> 1;
+		word |= cells << bits;
+		bits += PLAYCOLS;
+		if (bits >= 64)
+		  {
+			 *words++ = word;
+			 bits -= 64;
+			 word = bits ? cells >> (PLAYCOLS - bits) : 0;
+		  }
+	 }
+   if (bits) *words = word;
+}
+
+/* What the hash of a board changes by when the shape is put in this position */
+static inline uint64_t board_hashshape (const rotation_t *rot,int x,int y)
+{
+   uint64_t hash = 0;
+   int i;
+   for (i = 0; i < NUMBLOCKS; i++) hash ^= board_key (ZOBRIST_CELL (x + rot->block[i].x,y + rot->block[i].y));
+   return (hash);
+}
+
+/* Empty the board, leaving only the walls and the floor */
+static inline void board_clear (row_t *rows)
+{
+   int y;
+   for (y = 0; y < NUMROWS - 2; y++) rows[y] = WALLROW;
+   for (y = NUMROWS - 2; y < NUMROWS; y++) rows[y] = FULLROW;
+}
+
+/* Check if shape is allowed to be in this position */
+static inline bool board_allowed (const row_t *rows,const rotation_t *rot,int x,int y)
+{
+   int i,shift = x + rot->minx;
+   row_t occupied = 0;
+   rows += y + rot->miny;
+   for (i = 0; i <= rot->maxy - rot->miny; i++) occupied |= rows[i] & (row_t) ((row_t) rot->mask[i] << shift);
+   return (!occupied);
+}
+
+/* Find the row the shape comes to rest in when it is dropped from row y */
+static inline int board_floor (const row_t *rows,const unsigned char *height,const rotation_t *rot,int x,int y)
+{
+   int i,by,distance = NUMROWS;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		by = y + rot->block[i].y;
+		/* the shape is tucked below the surface of this column, so the */
+		/* heights don't tell us where it stops; do it the slow way */
+		if (by >= SURFACE (height,x + rot->block[i].x))
+		  {
+			 while (board_allowed (rows,rot,x,y + 1)) y++;
+			 return y;
+		  }
+		if (SURFACE (height,x + rot->block[i].x) - 1 - by < distance)
+		  distance = SURFACE (height,x + rot->block[i].x) - 1 - by;
+	 }
+   return y + distance;
+}
+
+/* Compute the column heights, row fill counts and holes from scratch */
+static inline void board_surface (const row_t *rows,unsigned char *height,unsigned char *fill,int *holes)
+{
+   int x,y;
+   *holes = 0;
+   for (x = 1; x < NUMCOLS - 2; x++) height[x] = 0;
+   for (y = 0; y < NUMROWS - 2; y++)
+	 {
+		fill[y] = 0;
+		for (x = 1; x < NUMCOLS - 2; x++)
+		  {
+			 if (rows[y] & BIT (x))
+			   {
+				  fill[y]++;
+				  if (!height[x]) height[x] = NUMROWS - 2 - y;
+			   }
+			 else if (height[x]) (*holes)++;
+		  }
+	 }
+}
+
+/* Put the shape on the board where it came to rest */
+static inline void board_lock (row_t *rows,unsigned char *height,unsigned char *fill,int *holes,const rotation_t *rot,int x,int y)
+{
+   int i,bx,by;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		bx = x + rot->block[i].x;
+		by = y + rot->block[i].y;
+		rows[by] |= BIT (bx);
+		fill[by]++;
+		/* the block raised the surface, everything between it and the old surface is a hole now */
+		if (by < SURFACE (height,bx))
+		  {
+			 *holes += SURFACE (height,bx) - by - 1;
+			 height[bx] = NUMROWS - 2 - by;
+		  }
+		/* the block filled a hole */
+		else (*holes)--;
+	 }
+}
+
+/*
+ * This removes all the rows on the board that is completely filled with blocks.
+ * Only the rows from top to bottom (where the last shape came to rest) can be
+ * full. The colors of the cells are moved along if color isn't NULL.
+ */
+static inline int board_droplines (row_t *rows,unsigned char (*color)[NUMCOLS],unsigned char *height,unsigned char *fill,int *holes,int top,int bottom)
+{
+   uint64_t full = 0;
+   int x,y,ny,below,droppedlines = 0;
+   bool toprow = rows[0] != WALLROW;
+   for (y = top > 1 ? top : 1; y <= bottom; y++)
+	 if (rows[y] == FULLROW)
+	   {
+		  full |= (uint64_t) 1 << y;
+		  droppedlines++;
+	   }
+   if (droppedlines)
+	 {
+		/* lower the surface of every column. If the surface itself was */
+		/* removed, follow the column down to the next occupied cell */
+		for (x = 1; x < NUMCOLS - 2; x++)
+		  {
+			 y = SURFACE (height,x);
+			 if (!(full & ((uint64_t) 1 << y)))
+			   {
+				  height[x] -= droppedlines;
+				  continue;
+			   }
+			 for (below = droppedlines; y < NUMROWS - 2; y++)
+			   {
+				  if (full & ((uint64_t) 1 << y)) below--;
+				  else if (rows[y] & BIT (x)) break;
+				  else (*holes)--;
+			   }
+			 height[x] = NUMROWS - 2 - y - below;
+		  }
+		/* compact the rows that are not full towards the floor */
+		for (y = ny = bottom; y > 0; y--)
+		  {
+			 if (full & ((uint64_t) 1 << y)) continue;
+			 if (ny != y)
+			   {
+				  rows[ny] = rows[y];
+				  fill[ny] = fill[y];
+				  if (color != NULL) memcpy (color[ny],color[y],NUMCOLS);
+			   }
+			 ny--;
+		  }
+	 }
+   else ny = 0;
+   /* ... and empty whatever is left above them (the top row is never kept) */
+   for (y = ny; y >= 0; y--)
+	 {
+		rows[y] = WALLROW;
+		fill[y] = 0;
+		if (color != NULL) memset (color[y] + 1,0,NUMCOLS - 3);	/* black */
+	 }
+   /* blocks in the top row are simply lost, which the column heights can't follow */
+   if (toprow) board_surface (rows,height,fill,holes);
+   return droppedlines;
+}
+
+/* Put the shape on the board where it came to rest and remove the rows it filled. Returns the number of lines removed */
+static inline int board_place (row_t *rows,unsigned char *height,unsigned char *fill,int *holes,const rotation_t *rot,int x,int y)
+{
+   board_lock (rows,height,fill,holes,rot,x,y);
+   return (board_droplines (rows,NULL,height,fill,holes,y + rot->miny,y + rot->maxy));
+}
+
+/* Put a shape on a copy of a board (see board_place ()). Returns the number of lines removed */
+static inline int board_child (const boardnode_t *node,boardnode_t *child,const rotation_t *rot,int x,int y)
+{
+   *child = *node;
+   return (board_place (child->rows,child->height,child->fill,&child->holes,rot,x,y));
+}
+
+/* Scramble a seed so that neighbouring seeds don't start out alike */
+static inline unsigned int bag_seed (unsigned int seed)
+{
+   seed ^= seed >> 16;
+   seed *= 0x7feb352dU;
+   seed ^= seed >> 15;
+   seed *= 0x846ca68bU;
+   seed ^= seed >> 16;
+   return (seed ? seed : 1);
+}
+
+/* Take the next shape out of the bag, refilling it before the first item would be reused */
+static inline void bag_next (randomizer_t randomizer,int *bag,int *iterator,unsigned int *rng,int *curshape,int *nextshape)
+{
+   *curshape = bag[*iterator % NUMSHAPES];
+   if ((*iterator + 1) % NUMSHAPES == 0) bag_fill (randomizer,rng,(*iterator + 1) / NUMSHAPES,bag);
+   *nextshape = bag[(*iterator + 1) % NUMSHAPES];
+   (*iterator)++;
+}
+
+#endif	/* #ifndef BOARD_H */
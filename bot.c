@@ -0,0 +1,248 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "place.h"
+#include "bot.h"
+#include "eval.h"
+
+/*
+ * Global variables
+ */
+
+const char *FEATURES_STRING[] = {
+	"height", "holes", "bumpiness", "rowtransitions", "coltransitions", "wells", "lines"
+};
+
+/* The weights the bot always played with */
+static const weights_t DEFAULTS = { { -51, -36, -18, 0, 0, 0, 76 } };
+
+/* Columns inside the walls */
+#define INSIDE	((row_t) (FULLROW & ~WALLROW))
+
+/*
+ * Functions
+ */
+
+/*
+ * Get the weights the bot plays with unless it is told otherwise
+ */
+void bot_defaults (weights_t *weights)
+{
+   *weights = DEFAULTS;
+}
+
+/*
+ * Read weights from a file with one "feature weight" pair per line, e.g.
+ * "holes -36". Empty lines and lines starting with # are skipped, and
+ * features that aren't mentioned keep their weight. Returns FALSE (and
+ * tells why on stderr) if the file can't be read.
+ */
+bool bot_load (weights_t *weights,const char *filename)
+{
+   FILE *fp;
+   char line[128],name[64];
+   double weight;
+   int i,n = 0;
+   bool ok = TRUE;
+   if ((fp = fopen (filename,"r")) == NULL)
+	 {
+		fprintf (stderr,"Could not open weights %s\n",filename);
+		return (FALSE);
+	 }
+   while (ok && fgets (line,sizeof (line),fp) != NULL)
+	 {
+		n++;
+		if (sscanf (line," %63s",name) != 1 || name[0] == '#') continue;
+		ok = sscanf (line," %63s %lf",name,&weight) == 2;
+		for (i = 0; ok && i < NUMFEATURES && strcmp (name,FEATURES_STRING[i]) != 0; i++) ;
+		if (ok && i < NUMFEATURES)
+		  weights->weight[i] = weight;
+		else
+		  {
+			 fprintf (stderr,"Invalid weight in %s, line %d -- %s",filename,n,line);
+			 ok = FALSE;
+		  }
+	 }
+   fclose (fp);
+   return (ok);
+}
+
+/*
+ * Write weights the way bot_load () reads them, with enough digits that
+ * they read back exactly
+ */
+void bot_save (const weights_t *weights,FILE *fp)
+{
+   int i;
+   for (i = 0; i < NUMFEATURES; i++)
+	 fprintf (fp,"%s %.17g\n",FEATURES_STRING[i],weights->weight[i]);
+}
+
+/* Measure the features, leaving out the transitions (which take a look */
+/* at every row of the stack) unless they are wanted */
+static inline void measure (const row_t *rows,const unsigned char *height,int holes,int lines,int *features,bool transitions)
+{
+   int x,y,h,left,right,top = 0;
+   int sum = 0,bumpiness = 0,wells = 0,rowtransitions = 0,coltransitions = 0;
+   for (x = 1; x < NUMCOLS - 2; x++)
+	 {
+		h = height[x];
+		sum += h;
+		if (h > top) top = h;
+		if (x > 1) bumpiness += abs (h - height[x - 1]);
+		/* the walls are higher than any column */
+		left = x > 1 ? height[x - 1] : NUMROWS;
+		right = x < NUMCOLS - 3 ? height[x + 1] : NUMROWS;
+		if (left > h && right > h) wells += (left < right ? left : right) - h;
+	 }
+   if (transitions)
+	 {
+		/* rows of the stack, from the highest one down. A full cell next to */
+		/* an empty one is a change between bit x and bit x + 1 of the row */
+		for (y = NUMROWS - 2 - top; y < NUMROWS - 2; y++)
+		  rowtransitions += board_cells ((rows[y] ^ (rows[y] >> 1)) & (FULLROW >> 2));
+		/* and between a row and the one below it, from the empty row above the stack down to the floor */
+		for (y = top < NUMROWS - 2 ? NUMROWS - 3 - top : 0; y < NUMROWS - 2; y++)
+		  coltransitions += board_cells ((rows[y] ^ rows[y + 1]) & INSIDE);
+	 }
+   features[FEATURE_HEIGHT] = sum;
+   features[FEATURE_HOLES] = holes;
+   features[FEATURE_BUMPINESS] = bumpiness;
+   features[FEATURE_ROWTRANSITIONS] = rowtransitions;
+   features[FEATURE_COLTRANSITIONS] = coltransitions;
+   features[FEATURE_WELLS] = wells;
+   features[FEATURE_LINES] = lines;
+}
+
+/*
+ * Measure the features of a board, given the way the engine keeps it:
+ * its rows, the heights of its columns, its number of holes, and the
+ * number of lines the last shape removed
+ */
+void bot_features (const row_t *rows,const unsigned char *height,int holes,int lines,int *features)
+{
+   measure (rows,height,holes,lines,features,TRUE);
+}
+
+/*
+ * Get the weighted sum of the given features
+ */
+double bot_score (const weights_t *weights,const int *features)
+{
+   double value = 0;
+   int i;
+   for (i = 0; i < NUMFEATURES; i++) value += weights->weight[i] * features[i];
+   return (value);
+}
+
+/*
+ * Get how much the bot likes a board kept the way the engine keeps it,
+ * leaving out the lines removed to get there. This only depends on the
+ * board, so it can be looked up by its hash.
+ */
+double bot_board (const weights_t *weights,const row_t *rows,const unsigned char *height,int holes)
+{
+   int features[NUMFEATURES];
+   measure (rows,height,holes,0,features,weights->weight[FEATURE_ROWTRANSITIONS] != 0 || weights->weight[FEATURE_COLTRANSITIONS] != 0);
+   return (bot_score (weights,features));
+}
+
+/*
+ * Put a shape in the given position on a board kept the way the engine
+ * keeps it (rows, column heights, row fill counts and holes) and get how
+ * much the bot likes the result. The number of lines removed is stored
+ * in lines.
+ */
+double bot_place (const weights_t *weights,row_t *rows,unsigned char *height,unsigned char *fill,int *holes,const rotation_t *rot,int x,int y,int *lines)
+{
+   *lines = board_place (rows,height,fill,holes,rot,x,y);
+   /* the lines are the last feature, so this adds up exactly like bot_score () */
+   return (bot_board (weights,rows,height,*holes) + weights->weight[FEATURE_LINES] * *lines);
+}
+
+/*
+ * Get how much the bot likes the board of the specified tetris engine with
+ * its current shape put in the given placement. The engine is left alone.
+ * Returns FALSE if the game would be over.
+ */
+bool bot_value (const weights_t *weights,const engine_t *engine,const placement_t *placement,double *value)
+{
+   /* the shape is put on a copy of the occupied cells only, the colors aren't needed */
+   row_t rows[NUMROWS];
+   unsigned char height[NUMCOLS],fill[NUMROWS];
+   int holes = engine->holes,lines;
+   memcpy (rows,engine->board.rows,sizeof (rows));
+   memcpy (height,engine->height,sizeof (height));
+   memcpy (fill,engine->fill,sizeof (fill));
+   *value = bot_place (weights,rows,height,fill,&holes,&SHAPES[engine->curshape].rotation[placement->orient],placement->x,placement->y,&lines);
+   return (board_allowed (rows,&SHAPES[engine->nextshape].rotation[0],SPAWNX,SPAWNY));
+}
+
+/*
+ * Get how much the bot likes the board of the specified tetris engine with
+ * its current shape put in each of the given placements, measuring the
+ * boards side by side (see eval.h). Placements that would end the game get
+ * -DBL_MAX. The engine is left alone.
+ */
+void bot_values (const weights_t *weights,const engine_t *engine,const places_t *places,double *values)
+{
+   evalbatch_t batch;
+   row_t rows[NUMROWS];
+   unsigned char height[NUMCOLS],fill[NUMROWS];
+   const placement_t *placement;
+   const rotation_t *rot;
+   bool lost[EVALBATCH];
+   int i,j,holes,lines;
+   for (i = 0; i < places->count; i += batch.count)
+	 {
+		for (batch.count = 0; batch.count < EVALBATCH && i + batch.count < places->count; )
+		  {
+			 placement = &places->placement[i + batch.count];
+			 rot = &SHAPES[engine->curshape].rotation[placement->orient];
+			 memcpy (rows,engine->board.rows,sizeof (rows));
+			 memcpy (height,engine->height,sizeof (height));
+			 memcpy (fill,engine->fill,sizeof (fill));
+			 holes = engine->holes;
+			 lines = board_place (rows,height,fill,&holes,rot,placement->x,placement->y);
+			 lost[batch.count] = !board_allowed (rows,&SHAPES[engine->nextshape].rotation[0],SPAWNX,SPAWNY);
+			 eval_add (&batch,rows,lines);
+		  }
+		eval_scores (&batch,weights,values + i);
+		for (j = 0; j < batch.count; j++)
+		  if (lost[j]) values[i + j] = -DBL_MAX;
+	 }
+}
@@ -0,0 +1,143 @@
+#ifndef BOT_H
+#define BOT_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+#include "place.h"			/* placement_t, places_t */
+
+/*
+ * Macros
+ */
+
+/* Value of a board the game is over on (lower than any the bot can like) */
+#define LOST	(-1e30)
+
+/*
+ * Type definitions
+ */
+
+/* What the bot looks at on a board */
+typedef enum
+{
+   FEATURE_HEIGHT,					/* sum of the heights of the columns */
+   FEATURE_HOLES,					/* empty cells below the surface */
+   FEATURE_BUMPINESS,				/* sum of the height differences of neighbouring columns */
+   FEATURE_ROWTRANSITIONS,			/* empty cells next to full ones (or walls) in the rows of the stack */
+   FEATURE_COLTRANSITIONS,			/* empty cells above or below full ones (or the floor) */
+   FEATURE_WELLS,					/* sum of the depths of the columns lower than both neighbours */
+   FEATURE_LINES					/* lines removed by the last shape */
+} feature_t;
+
+#define NUMFEATURES	7
+
+/* How much the bot cares about each feature. The bot puts every shape */
+/* where the weighted sum of the features is the highest */
+typedef struct
+{
+   double weight[NUMFEATURES];
+} weights_t;
+
+/*
+ * Global variables
+ */
+
+/* Names of the features (as used in weight files) */
+extern const char *FEATURES_STRING[];
+
+/*
+ * Functions
+ */
+
+/*
+ * Get the weights the bot plays with unless it is told otherwise
+ */
+void bot_defaults (weights_t *weights);
+
+/*
+ * Read weights from a file with one "feature weight" pair per line, e.g.
+ * "holes -36". Empty lines and lines starting with # are skipped, and
+ * features that aren't mentioned keep their weight. Returns FALSE (and
+ * tells why on stderr) if the file can't be read.
+ */
+bool bot_load (weights_t *weights,const char *filename);
+
+/*
+ * Write weights the way bot_load () reads them, with enough digits that
+ * they read back exactly
+ */
+void bot_save (const weights_t *weights,FILE *fp);
+
+/*
+ * Measure the features of a board, given the way the engine keeps it:
+ * its rows, the heights of its columns, its number of holes, and the
+ * number of lines the last shape removed
+ */
+void bot_features (const row_t *rows,const unsigned char *height,int holes,int lines,int *features);
+
+/*
+ * Get the weighted sum of the given features
+ */
+double bot_score (const weights_t *weights,const int *features);
+
+/*
+ * Get how much the bot likes a board kept the way the engine keeps it,
+ * leaving out the lines removed to get there. This only depends on the
+ * board, so it can be looked up by its hash.
+ */
+double bot_board (const weights_t *weights,const row_t *rows,const unsigned char *height,int holes);
+
+/*
+ * Put a shape in the given position on a board kept the way the engine
+ * keeps it (rows, column heights, row fill counts and holes) and get how
+ * much the bot likes the result. The number of lines removed is stored
+ * in lines.
+ */
+double bot_place (const weights_t *weights,row_t *rows,unsigned char *height,unsigned char *fill,int *holes,const rotation_t *rot,int x,int y,int *lines);
+
+/*
+ * Get how much the bot likes the board of the specified tetris engine with
+ * its current shape put in the given placement. The engine is left alone.
+ * Returns FALSE if the game would be over.
+ */
+bool bot_value (const weights_t *weights,const engine_t *engine,const placement_t *placement,double *value);
+
+/*
+ * Get how much the bot likes the board of the specified tetris engine with
+ * its current shape put in each of the given placements, measuring the
+ * boards side by side (see eval.h). Placements that would end the game get
+ * -DBL_MAX. The engine is left alone.
+ */
+void bot_values (const weights_t *weights,const engine_t *engine,const places_t *places,double *values);
+
+#endif	/* #ifndef BOT_H */
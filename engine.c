@@ -34,302 +34,433 @@
 #include "utils.h"
 #include "io.h"
 #include "engine.h"
-#include "log.h"
+#include "board.h"
 
 /*
  * Global variables
  */
-static const char *ACTIONS_STRING[] = {
+const char *ACTIONS_STRING[] = {
 	"left", "rotate", "right", "drop", "down"
 };
 
-const shapes_t SHAPES =
-{
-   { COLOR_CYAN,    0, FALSE, { {  1,  0 }, {  0,  0 }, {  0, -1 }, { -1, -1 } } },
-   { COLOR_GREEN,   1, FALSE, { {  1, -1 }, {  0, -1 }, {  0,  0 }, { -1,  0 } } },
-   { COLOR_YELLOW,  2, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  0,  1 } } },
-   { COLOR_BLUE,    3, FALSE, { { -1, -1 }, {  0, -1 }, { -1,  0 }, {  0,  0 } } },
-   { COLOR_MAGENTA, 4, FALSE, { { -1,  1 }, { -1,  0 }, {  0,  0 }, {  1,  0 } } },
-   { COLOR_WHITE,   5, FALSE, { {  1,  1 }, {  1,  0 }, {  0,  0 }, { -1,  0 } } },
-   { COLOR_RED,     6, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  2,  0 } } }
+const char *RANDOMIZERS_STRING[] = {
+	"bag", "shuffle", "uniform"
 };
 
 /*
- * Functions
+ * Every orientation of every shape. Rotating a shape just moves it to the
+ * next orientation in its table. The tables follow the way tetris likes
+ * shapes to rotate (= not mathematically correct):
+ *
+ *   cyan, green, red          flip between two orientations
+ *   yellow, magenta, white    rotate anti-clockwise through four orientations
+ *   blue                      is not rotated at all
+ *
+ * Each orientation is laid out as:
+ *   { next, minx, maxx, miny, maxy, { blocks }, { row masks } }
  */
-
-/* This rotates a shape */
-static void real_rotate (shape_t *shape,bool clockwise)
+const shapes_t SHAPES =
 {
-   int i,tmp;
-   if (clockwise)
+   { COLOR_CYAN, 2,
 	 {
-		for (i = 0; i < NUMBLOCKS; i++)
-		  {
-			 tmp = shape->block[i].x;
-			 shape->block[i].x = -shape->block[i].y;
-			 shape->block[i].y = tmp;
-		  }
+	  { 1, -1,  1, -1,  0, { {  1,  0 }, {  0,  0 }, {  0, -1 }, { -1, -1 } }, { 0x3, 0x6, 0x0, 0x0 } },
+	  { 0, -1,  0, -1,  1, { {  0, -1 }, {  0,  0 }, { -1,  0 }, { -1,  1 } }, { 0x2, 0x3, 0x1, 0x0 } }
 	 }
-   else
+   },
+   { COLOR_GREEN, 2,
 	 {
-		for (i = 0; i < NUMBLOCKS; i++)
-		  {
-			 tmp = shape->block[i].x;
-			 shape->block[i].x = shape->block[i].y;
-			 shape->block[i].y = -tmp;
-		  }
+	  { 1, -1,  1, -1,  0, { {  1, -1 }, {  0, -1 }, {  0,  0 }, { -1,  0 } }, { 0x6, 0x3, 0x0, 0x0 } },
+	  { 0,  0,  1, -1,  1, { {  1,  1 }, {  1,  0 }, {  0,  0 }, {  0, -1 } }, { 0x1, 0x3, 0x2, 0x0 } }
 	 }
-}
-
-/* Rotate shapes the way tetris likes it (= not mathematically correct) */
-static void fake_rotate (shape_t *shape)
-{
-   switch (shape->type)
+   },
+   { COLOR_YELLOW, 4,
 	 {
-	  case 0:	/* Just rotate this one anti-clockwise and clockwise */
-		if (shape->flipped) real_rotate (shape,TRUE); else real_rotate (shape,FALSE);
-		shape->flipped = !shape->flipped;
-		break;
-	  case 1:	/* Just rotate these two clockwise and anti-clockwise */
-	  case 6:
-		if (shape->flipped) real_rotate (shape,FALSE); else real_rotate (shape,TRUE);
-		shape->flipped = !shape->flipped;
-		break;
-	  case 2:	/* Rotate these three anti-clockwise */
-	  case 4:
-	  case 5:
-		real_rotate (shape,FALSE);
-		break;
-	  case 3:	/* This one is not rotated at all */
-		break;
+	  { 1, -1,  1,  0,  1, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  0,  1 } }, { 0x7, 0x2, 0x0, 0x0 } },
+	  { 2,  0,  1, -1,  1, { {  0,  1 }, {  0,  0 }, {  0, -1 }, {  1,  0 } }, { 0x1, 0x3, 0x1, 0x0 } },
+	  { 3, -1,  1, -1,  0, { {  1,  0 }, {  0,  0 }, { -1,  0 }, {  0, -1 } }, { 0x2, 0x7, 0x0, 0x0 } },
+	  { 0, -1,  0, -1,  1, { {  0, -1 }, {  0,  0 }, {  0,  1 }, { -1,  0 } }, { 0x2, 0x3, 0x2, 0x0 } }
 	 }
-}
+   },
+   { COLOR_BLUE, 1,
+	 {
+	  { 0, -1,  0, -1,  0, { { -1, -1 }, {  0, -1 }, { -1,  0 }, {  0,  0 } }, { 0x3, 0x3, 0x0, 0x0 } }
+	 }
+   },
+   { COLOR_MAGENTA, 4,
+	 {
+	  { 1, -1,  1,  0,  1, { { -1,  1 }, { -1,  0 }, {  0,  0 }, {  1,  0 } }, { 0x7, 0x1, 0x0, 0x0 } },
+	  { 2,  0,  1, -1,  1, { {  1,  1 }, {  0,  1 }, {  0,  0 }, {  0, -1 } }, { 0x1, 0x1, 0x3, 0x0 } },
+	  { 3, -1,  1, -1,  0, { {  1, -1 }, {  1,  0 }, {  0,  0 }, { -1,  0 } }, { 0x4, 0x7, 0x0, 0x0 } },
+	  { 0, -1,  0, -1,  1, { { -1, -1 }, {  0, -1 }, {  0,  0 }, {  0,  1 } }, { 0x3, 0x2, 0x2, 0x0 } }
+	 }
+   },
+   { COLOR_WHITE, 4,
+	 {
+	  { 1, -1,  1,  0,  1, { {  1,  1 }, {  1,  0 }, {  0,  0 }, { -1,  0 } }, { 0x7, 0x4, 0x0, 0x0 } },
+	  { 2,  0,  1, -1,  1, { {  1, -1 }, {  0, -1 }, {  0,  0 }, {  0,  1 } }, { 0x3, 0x1, 0x1, 0x0 } },
+	  { 3, -1,  1, -1,  0, { { -1, -1 }, { -1,  0 }, {  0,  0 }, {  1,  0 } }, { 0x1, 0x7, 0x0, 0x0 } },
+	  { 0, -1,  0, -1,  1, { { -1,  1 }, {  0,  1 }, {  0,  0 }, {  0, -1 } }, { 0x2, 0x2, 0x3, 0x0 } }
+	 }
+   },
+   { COLOR_RED, 2,
+	 {
+	  { 1, -1,  2,  0,  0, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  2,  0 } }, { 0xf, 0x0, 0x0, 0x0 } },
+	  { 0,  0,  0, -1,  2, { {  0, -1 }, {  0,  0 }, {  0,  1 }, {  0,  2 } }, { 0x1, 0x1, 0x1, 0x1 } }
+	 }
+   }
+};
 
-/* Draw a shape on the board */
-static void drawshape (board_t board,shape_t *shape,int x,int y)
+/*
+ * Functions
+ */
+
+/* Paint the cells of a shape on the board in its color */
+static void paintshape (board_t *board,const shape_t *shape,int orient,int x,int y)
 {
+   const rotation_t *rot = &shape->rotation[orient];
    int i;
-   for (i = 0; i < NUMBLOCKS; i++) board[x + shape->block[i].x][y + shape->block[i].y] = shape->color;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 board->color[y + rot->block[i].y][x + rot->block[i].x] = shape->color;
 }
 
-/* Erase a shape from the board */
-static void eraseshape (board_t board,shape_t *shape,int x,int y)
+/* Check if shape is allowed to be in this position */
+static bool allowed (const board_t *board,const shape_t *shape,int orient,int x,int y)
 {
-   int i;
-   for (i = 0; i < NUMBLOCKS; i++) board[x + shape->block[i].x][y + shape->block[i].y] = COLOR_BLACK;
+   return board_allowed (board->rows,&shape->rotation[orient],x,y);
 }
 
-/* Check if shape is allowed to be in this position */
-static bool allowed (board_t board,shape_t *shape,int x,int y)
+/* Empty the board, leaving only the walls and the floor */
+static void clearboard (board_t *board)
 {
-   int i,occupied = FALSE;
-   for (i = 0; i < NUMBLOCKS; i++) if (board[x + shape->block[i].x][y + shape->block[i].y]) occupied = TRUE;
-   return (!occupied);
+   int y;
+   board_clear (board->rows);
+   for (y = 0; y < NUMROWS - 2; y++)
+	 {
+		memset (board->color[y],COLOR_BLACK,NUMCOLS);
+		board->color[y][0] = board->color[y][NUMCOLS - 2] = board->color[y][NUMCOLS - 1] = WALL;
+	 }
+   for (y = NUMROWS - 2; y < NUMROWS; y++)
+	 memset (board->color[y],WALL,NUMCOLS);
 }
 
 /* Set y coordinate of shadow */
-static void place_shadow_to_bottom (board_t board,shape_t *shape,int x_shadow,int *y_shadow,int y) {
-   while (allowed(board,shape,x_shadow,y+1)) y++;
-   *y_shadow = y;
+static void place_shadow_to_bottom (const engine_t *engine,const shape_t *shape,int orient,int x_shadow,int *y_shadow,int y) {
+   *y_shadow = board_floor (engine->board.rows,engine->height,&shape->rotation[orient],x_shadow,y);
 }
 
+/*
+ * The falling shape and its shadow are not part of the board, they are
+ * only described by their position and orientation in the engine. The
+ * board is only changed when a shape comes to rest (see shape_lock()).
+ */
+
 /* Move the shape left if possible */
 static bool shape_left (engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   bool result = FALSE;
-   eraseshape (*board,shape,engine->curx,engine->cury);
-   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   if (allowed (*board,shape,engine->curx - 1,engine->cury))
+   const shape_t *shape = &SHAPES[engine->curshape];
+   if (!allowed (&engine->board,shape,engine->curorient,engine->curx - 1,engine->cury)) return FALSE;
+   engine->curx--;
+   if (engine->shadow)
 	 {
-        engine->curx--;
-        result = TRUE;
-        if (engine->shadow)
-        {
-            engine->curx_shadow--;
-            place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
-        }
+		engine->curx_shadow--;
+		place_shadow_to_bottom (engine,shape,engine->curorient,engine->curx_shadow,&engine->cury_shadow,engine->cury);
 	 }
-   if (engine->shadow) drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   drawshape (*board,shape,engine->curx,engine->cury);
-   return result;
+   return TRUE;
 }
 
 /* Move the shape right if possible */
 static bool shape_right (engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   bool result = FALSE;
-   eraseshape (*board,shape,engine->curx,engine->cury);
-   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   if (allowed (*board,shape,engine->curx + 1,engine->cury))
+   const shape_t *shape = &SHAPES[engine->curshape];
+   if (!allowed (&engine->board,shape,engine->curorient,engine->curx + 1,engine->cury)) return FALSE;
+   engine->curx++;
+   if (engine->shadow)
 	 {
-		engine->curx++;
-		result = TRUE;
-		if (engine->shadow)
-		{
-            engine->curx_shadow++;
-            place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
-		}
+		engine->curx_shadow++;
+		place_shadow_to_bottom (engine,shape,engine->curorient,engine->curx_shadow,&engine->cury_shadow,engine->cury);
 	 }
-   if (engine->shadow) drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   drawshape (*board,shape,engine->curx,engine->cury);
-   return result;
+   return TRUE;
 }
 
 /* Rotate the shape if possible */
 static bool shape_rotate (engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   bool result = FALSE;
-   shape_t test;
-   eraseshape (*board,shape,engine->curx,engine->cury);
-   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   memcpy (&test,shape,sizeof (shape_t));
-   fake_rotate (&test);
-   if (allowed (*board,&test,engine->curx,engine->cury))
-	 {
-		memcpy (shape,&test,sizeof (shape_t));
-		result = TRUE;
-		if (engine->shadow) place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
-	 }
-   if (engine->shadow) drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   drawshape (*board,shape,engine->curx,engine->cury);
-   return result;
+   const shape_t *shape = &SHAPES[engine->curshape];
+   int next = shape->rotation[engine->curorient].next;
+   if (!allowed (&engine->board,shape,next,engine->curx,engine->cury)) return FALSE;
+   engine->curorient = next;
+   if (engine->shadow) place_shadow_to_bottom (engine,shape,engine->curorient,engine->curx_shadow,&engine->cury_shadow,engine->cury);
+   return TRUE;
 }
 
 /* Move the shape one row down if possible */
 static bool shape_down (engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   bool result = FALSE;
-   eraseshape (*board,shape,engine->curx,engine->cury);
-   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   if (allowed (*board,shape,engine->curx,engine->cury + 1))
-	 {
-		engine->cury++;
-		result = TRUE;
-		if (engine->shadow) place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
-	 }
-   if (engine->shadow) drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   drawshape (*board,shape,engine->curx,engine->cury);
-   return result;
+   const shape_t *shape = &SHAPES[engine->curshape];
+   if (!allowed (&engine->board,shape,engine->curorient,engine->curx,engine->cury + 1)) return FALSE;
+   engine->cury++;
+   engine->lock = 0;
+   if (engine->shadow) place_shadow_to_bottom (engine,shape,engine->curorient,engine->curx_shadow,&engine->cury_shadow,engine->cury);
+   return TRUE;
 }
 
 /* Check if shape can move down (= in the air) or not (= at the bottom */
 /* of the board or on top of one of the resting shapes) */
-static bool shape_bottom (engine_t *engine)
+static bool shape_bottom (const engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   bool result = FALSE;
-   eraseshape (*board,shape,engine->curx,engine->cury);
-   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   result = !allowed (*board,shape,engine->curx,engine->cury + 1);
-   if (engine->shadow) drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-   drawshape (*board,shape,engine->curx,engine->cury);
-   return result;
+   return !allowed (&engine->board,&SHAPES[engine->curshape],engine->curorient,engine->curx,engine->cury + 1);
 }
 
 /* Drop the shape until it comes to rest on the bottom of the board or */
 /* on top of a resting shape */
 static int shape_drop (engine_t *engine)
 {
-   board_t *board = &engine->board;
-   shape_t *shape = &engine->shapes[engine->curshape];
-   eraseshape (*board,shape,engine->curx,engine->cury);
+   const shape_t *shape = &SHAPES[engine->curshape];
    int droppedlines = 0;
 
    if (engine->shadow) {
-       drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
        droppedlines = engine->cury_shadow - engine->cury;
        engine->cury = engine->cury_shadow;
        return droppedlines;
    }
 
-   while (allowed (*board,shape,engine->curx,engine->cury + 1))
-	 {
-		engine->cury++;
-		droppedlines++;
-	 }
-   drawshape (*board,shape,engine->curx,engine->cury);
+   droppedlines = board_floor (engine->board.rows,engine->height,&shape->rotation[engine->curorient],engine->curx,engine->cury) - engine->cury;
+   engine->cury += droppedlines;
    return droppedlines;
 }
 
-/* This removes all the rows on the board that is completely filled with blocks */
-static int droplines (board_t board)
+/* Put the shape on the board where it came to rest */
+static void shape_lock (engine_t *engine)
 {
-   int i,x,y,ny,status,droppedlines;
-   board_t newboard;
-   /* initialize new board */
-   memset (newboard,0,sizeof (board_t));
-   for (i = 0; i < NUMCOLS; i++) newboard[i][NUMROWS - 1] = newboard[i][NUMROWS - 2] = WALL;
-   for (i = 0; i < NUMROWS; i++) newboard[0][i] = newboard[NUMCOLS - 1][i] = newboard[NUMCOLS - 2][i] = WALL;
-   /* ... */
-   ny = NUMROWS - 3;
-   droppedlines = 0;
-   for (y = NUMROWS - 3; y > 0; y--)
-	 {
-		status = 0;
-		for (x = 1; x < NUMCOLS - 2; x++) if (board[x][y]) status++;
-		if (status < NUMCOLS - 3)
-		  {
-			 for (x = 1; x < NUMCOLS - 2; x++) newboard[x][ny] = board[x][y];
-			 ny--;
-		  }
-		else droppedlines++;
-	 }
-   memcpy (board,newboard,sizeof (board_t));
-   return droppedlines;
+   const shape_t *shape = &SHAPES[engine->curshape];
+   board_lock (engine->board.rows,engine->height,engine->fill,&engine->holes,&shape->rotation[engine->curorient],engine->curx,engine->cury);
+   engine->boardhash ^= board_hashshape (&shape->rotation[engine->curorient],engine->curx,engine->cury);
+   paintshape (&engine->board,shape,engine->curorient,engine->curx,engine->cury);
 }
 
 /* shuffle int array */
-void shuffle (int *array, size_t n)
+void shuffle (unsigned int *rng,int *array,size_t n)
 {
    size_t i;
    for (i = 0; i < n - 1; i++)
    {
       int range = (int)(n - i);
-      size_t j = i + rand_value(range);
+      size_t j = i + rand_value_r(rng, range);
       int t = array[j];
       array[j] = array[i];
       array[i] = t;
    }
 }
 
+/* Number of ways to order a bag (7!) and to fill it with independent shapes (7^7) */
+#define PERMUTATIONS	5040
+#define DRAWS			823543
+
 /*
- * Initialize specified tetris engine
+ * Fill in the index'th bag of shapes. The bag and uniform randomizers
+ * compute it directly from the key in rng; the shuffling one shuffles the
+ * previous bag (the index'th bag is always the next one then).
  */
-void engine_init (engine_t *engine,void (*score_function)(engine_t *))
+void bag_fill (randomizer_t randomizer,unsigned int *rng,unsigned long index,int *bag)
+{
+   unsigned int key[2],counter[4],r[4];
+   unsigned long long n;
+   int i,j,t;
+   if (randomizer == RANDOMIZER_SHUFFLE)
+	 {
+		shuffle (rng,bag,NUMSHAPES);
+		return;
+	 }
+   key[0] = *rng;
+   key[1] = randomizer;
+   counter[0] = index;
+   counter[1] = (unsigned long long) index >> 32;
+   counter[2] = counter[3] = 0;
+   rand_philox (key,counter,r);
+   n = (unsigned long long) r[0] << 32 | r[1];
+   if (randomizer == RANDOMIZER_UNIFORM)
+	 {
+		/* the digits of a random number in base 7 */
+		for (n %= DRAWS, i = 0; i < NUMSHAPES; i++, n /= NUMSHAPES)
+		  bag[i] = n % NUMSHAPES;
+		return;
+	 }
+   /* pick one of the permutations and shuffle with its digits */
+   for (i = 0; i < NUMSHAPES; i++) bag[i] = i;
+   for (n %= PERMUTATIONS, i = 0; i < NUMSHAPES - 1; n /= NUMSHAPES - i, i++)
+	 {
+		j = i + n % (NUMSHAPES - i);
+		t = bag[j];
+		bag[j] = bag[i];
+		bag[i] = t;
+	 }
+}
+
+/* Add the current and next shape and the bag to the hash of the board */
+static void rehash (engine_t *engine)
+{
+   engine->hash = engine->boardhash ^ board_key (ZOBRIST_SHAPE (engine->curshape)) ^
+	 board_key (ZOBRIST_NEXT (engine->nextshape)) ^ board_key (ZOBRIST_BAG (engine_bag (engine)));
+}
+
+/*
+ * Initialize specified tetris engine. Engines initialized with the same
+ * randomizer and seed get the same shapes.
+ */
+void engine_init (engine_t *engine,void (*score_function)(engine_t *),randomizer_t randomizer,unsigned int seed)
 {
-   int i;
    engine->shadow = FALSE;
    engine->score_function = score_function;
+   engine->events = 0;
+   engine->numhooks = 0;
    /* intialize values */
-   engine->curx = 5;
-   engine->cury = 1;
-   engine->curx_shadow = 5;
-   engine->cury_shadow = 1;
+   engine->curx = SPAWNX;
+   engine->cury = SPAWNY;
+   engine->curx_shadow = SPAWNX;
+   engine->cury_shadow = SPAWNY;
    engine->bag_iterator = 0;
+   /* every engine draws its shapes from its own sequence */
+   engine->randomizer = randomizer;
+   engine->rng = bag_seed (seed);
    /* create and randomize bag */
    for (int j = 0; j < NUMSHAPES; j++) engine->bag[j] = j;
-   shuffle (engine->bag,NUMSHAPES);
-   engine->curshape = engine->bag[engine->bag_iterator%NUMSHAPES];
-   engine->nextshape = engine->bag[(engine->bag_iterator+1)%NUMSHAPES];
-   engine->bag_iterator++;
+   bag_fill (randomizer,&engine->rng,0,engine->bag);
+   bag_next (randomizer,engine->bag,&engine->bag_iterator,&engine->rng,&engine->curshape,&engine->nextshape);
    engine->score = 0;
    engine->status.moves = engine->status.rotations = engine->status.dropcount = engine->status.efficiency = engine->status.droppedlines = 0;
-   /* initialize shapes */
-   memcpy (engine->shapes,SHAPES,sizeof (shapes_t));
+   engine->curorient = 0;
+   engine->gravity = GRAVITYUNIT / TICKRATE;
+   engine->lockdelay = LOCKDELAY;
+   engine->fall = engine->lock = engine->resets = 0;
    /* initialize board */
-   memset (engine->board,0,sizeof (board_t));
-   for (i = 0; i < NUMCOLS; i++) engine->board[i][NUMROWS - 1] = engine->board[i][NUMROWS - 2] = WALL;
-   for (i = 0; i < NUMROWS; i++) engine->board[0][i] = engine->board[NUMCOLS - 1][i] = engine->board[NUMCOLS - 2][i] = WALL;
+   clearboard (&engine->board);
+   board_surface (engine->board.rows,engine->height,engine->fill,&engine->holes);
+   engine->boardhash = board_hash (engine->board.rows);
+   rehash (engine);
+}
+
+/*
+ * Look up a randomizer by name. Returns TRUE if successful, FALSE
+ * otherwise.
+ */
+bool str2randomizer (randomizer_t *randomizer,const char *str)
+{
+   int i;
+   for (i = 0; i < NUMRANDOMIZERS; i++)
+	 if (strcmp (str,RANDOMIZERS_STRING[i]) == 0)
+	   {
+		  *randomizer = (randomizer_t) i;
+		  return (TRUE);
+	   }
+   return (FALSE);
+}
+
+/*
+ * Get the n'th shape (counting from 0) the specified tetris engine releases,
+ * or -1 if it was released from an earlier bag and can't be told anymore.
+ * This takes constant time unless the engine shuffles its bags.
+ */
+int engine_peek (const engine_t *engine,unsigned long n)
+{
+   unsigned long current = engine->bag_iterator / NUMSHAPES,index = n / NUMSHAPES;
+   unsigned int rng = engine->rng;
+   int bag[NUMSHAPES];
+   if (index == current) return (engine->bag[n % NUMSHAPES]);
+   if (engine->randomizer != RANDOMIZER_SHUFFLE)
+	 {
+		bag_fill (engine->randomizer,&rng,index,bag);
+		return (bag[n % NUMSHAPES]);
+	 }
+   /* the shuffled bags only come one after the other */
+   if (index < current) return (-1);
+   memcpy (bag,engine->bag,sizeof (bag));
+   while (current++ < index) bag_fill (engine->randomizer,&rng,current,bag);
+   return (bag[n % NUMSHAPES]);
+}
+
+/*
+ * Get the shapes left in the bag of the specified tetris engine after the
+ * next one (bit s for shape s), or 0 if it doesn't deal its shapes in bags
+ */
+unsigned int engine_bag (const engine_t *engine)
+{
+   unsigned int left = 0;
+   int i;
+   if (engine->randomizer != RANDOMIZER_UNIFORM)
+	 for (i = engine->bag_iterator % NUMSHAPES + 1; i < NUMSHAPES; i++)
+	   left |= 1U << engine->bag[i];
+   return (left);
+}
+
+/*
+ * Call hook with arg for the given events (a mask of EVENT_BIT ()s) of the
+ * specified tetris engine. Returns FALSE if the engine has MAXHOOKS hooks
+ * already, or if hooks were compiled out (NOHOOKS).
+ */
+bool engine_hook (engine_t *engine,unsigned int events,hook_t hook,void *arg)
+{
+#ifdef NOHOOKS
+   return (FALSE);
+#else
+   if (engine->numhooks == MAXHOOKS) return (FALSE);
+   engine->hooks[engine->numhooks].hook = hook;
+   engine->hooks[engine->numhooks].arg = arg;
+   engine->hooks[engine->numhooks].events = events;
+   engine->numhooks++;
+   engine->events |= events;
+   return (TRUE);
+#endif
+}
+
+/*
+ * Remove hook with arg from the specified tetris engine. A NULL hook removes
+ * every hook, e.g. from a copy of an engine that should stay quiet.
+ */
+void engine_unhook (engine_t *engine,hook_t hook,void *arg)
+{
+   int i,n = 0;
+   engine->events = 0;
+   for (i = 0; i < engine->numhooks; i++)
+	 if (hook != NULL && (engine->hooks[i].hook != hook || engine->hooks[i].arg != arg))
+	   {
+		  engine->hooks[n] = engine->hooks[i];
+		  engine->events |= engine->hooks[n++].events;
+	   }
+   engine->numhooks = n;
+}
+
+/* Check if anyone wants the event, so it is only filled in when needed. */
+/* Without hooks this is one predictable branch, with NOHOOKS it's gone */
+static inline bool hooked (const engine_t *engine,event_type_t type)
+{
+#ifdef NOHOOKS
+   return (FALSE);
+#else
+   return ((engine->events & EVENT_BIT (type)) != 0);
+#endif
+}
+
+/* Tell the hooks about an event */
+static void emit (const engine_t *engine,event_t *event)
+{
+   int i;
+   event->shape = engine->curshape;
+   event->orient = engine->curorient;
+   event->x = engine->curx;
+   event->y = engine->cury;
+   for (i = 0; i < engine->numhooks; i++)
+	 if (engine->hooks[i].events & EVENT_BIT (event->type))
+	   engine->hooks[i].hook (event,engine->hooks[i].arg);
+}
+
+/* A resting shape that was moved gets its full lock delay again, but only a few times */
+static void lock_reset (engine_t *engine)
+{
+   if (engine->lock && engine->resets < LOCKRESETS)
+	 {
+		engine->lock = 0;
+		engine->resets++;
+	 }
 }
 
 /*
@@ -337,29 +468,126 @@ void engine_init (engine_t *engine,void (*score_function)(engine_t *))
  */
 void engine_move (engine_t *engine,action_t action)
 {
+   static const event_type_t EVENTS[] = { EVENT_MOVE, EVENT_ROTATE, EVENT_MOVE, EVENT_DROP, EVENT_MOVE };
+   int x = engine->curx,y = engine->cury,orient = engine->curorient;
+   bool done = FALSE;
+   int dropped;
    switch (action)
 	 {
 		/* move shape to the left if possible */
 	  case ACTION_LEFT:
-        if (shape_left (engine)) engine->status.moves++;
+        if ((done = shape_left (engine)))
+		  {
+			 engine->status.moves++;
+			 lock_reset (engine);
+		  }
 		break;
 		/* rotate shape if possible */
 	  case ACTION_ROTATE:
-		if (shape_rotate (engine)) engine->status.rotations++;
+		if ((done = shape_rotate (engine)))
+		  {
+			 engine->status.rotations++;
+			 lock_reset (engine);
+		  }
 		break;
 		/* move shape to the right if possible */
 	  case ACTION_RIGHT:
-	    if (shape_right (engine)) engine->status.moves++;
+	    if ((done = shape_right (engine)))
+		  {
+			 engine->status.moves++;
+			 lock_reset (engine);
+		  }
 		break;
 		/* move shape to the down if possible */
 	  case ACTION_DOWN:
-		if (shape_down (engine)) engine->status.moves++;
+		if ((done = shape_down (engine))) engine->status.moves++;
 		break;
 		/* drop shape to the bottom */
 	  case ACTION_DROP:
-		engine->status.dropcount += shape_drop (engine);
+		dropped = shape_drop (engine);
+		engine->status.dropcount += dropped;
+		done = dropped > 0;
+	 }
+   if (hooked (engine,EVENTS[action]))
+	 {
+		event_t event;
+		event.type = EVENTS[action];
+		event.u.move.action = action;
+		event.u.move.fromx = x;
+		event.u.move.fromy = y;
+		event.u.move.fromorient = orient;
+		event.u.move.done = done;
+		emit (engine,&event);
+	 }
+}
+
+/* Lock the shape where it came to rest and release the next one. Returns 0, or -1 if the board is full */
+static int shape_land (engine_t *engine)
+{
+   const rotation_t *rot = &SHAPES[engine->curshape].rotation[engine->curorient];
+   int y,top = engine->cury + rot->miny,bottom = engine->cury + rot->maxy;
+   uint64_t before = 0;
+   bool moved;
+   event_t event;
+   shape_lock (engine);
+   if (hooked (engine,EVENT_LOCK))
+	 {
+		event.type = EVENT_LOCK;
+		emit (engine,&event);
+	 }
+   /* the rows that move (or are lost off the top) leave the hash, and come back in where they end up */
+   for (y = top; y <= bottom && engine->board.rows[y] != FULLROW; y++) ;
+   moved = y <= bottom || engine->board.rows[0] != WALLROW;
+   if (moved) before = board_hashrows (engine->board.rows,0,bottom);
+   /* update status information */
+   int dropped_lines = board_droplines (engine->board.rows,engine->board.color,engine->height,engine->fill,&engine->holes,top,bottom);
+   if (moved) engine->boardhash ^= before ^ board_hashrows (engine->board.rows,0,bottom);
+   engine->status.droppedlines += dropped_lines;
+   engine->status.currentdroppedlines = dropped_lines;
+   if (dropped_lines && hooked (engine,EVENT_LINES))
+	 {
+		event.type = EVENT_LINES;
+		event.u.lines.count = dropped_lines;
+		event.u.lines.total = engine->status.droppedlines;
+		emit (engine,&event);
+	 }
+   /* increase score */
+   engine->score_function (engine);
+   engine->curx -= SPAWNX;
+   engine->curx = abs (engine->curx);
+   engine->curx_shadow -= SPAWNX;
+   engine->curx_shadow = abs (engine->curx_shadow);
+   engine->status.rotations = 4 - engine->status.rotations;
+   engine->status.rotations = engine->status.rotations > 0 ? 0 : engine->status.rotations;
+   engine->status.efficiency += engine->status.dropcount + engine->status.rotations + (engine->curx - engine->status.moves);
+   engine->status.efficiency >>= 1;
+   engine->status.dropcount = engine->status.rotations = engine->status.moves = 0;
+   /* intialize values */
+   engine->curx = SPAWNX;
+   engine->cury = SPAWNY;
+   engine->curx_shadow = SPAWNX;
+   engine->cury_shadow = SPAWNY;
+   engine->fall = engine->lock = engine->resets = 0;
+   bag_next (engine->randomizer,engine->bag,&engine->bag_iterator,&engine->rng,&engine->curshape,&engine->nextshape);
+   engine->curorient = 0;
+   rehash (engine);
+   /* return games status */
+   if (!allowed (&engine->board,&SHAPES[engine->curshape],engine->curorient,engine->curx,engine->cury))
+	 {
+		if (hooked (engine,EVENT_GAMEOVER))
+		  {
+			 event.type = EVENT_GAMEOVER;
+			 emit (engine,&event);
+		  }
+		return -1;
 	 }
-   fprintf(logfile, "Action = %s on shape(%d)\n", ACTIONS_STRING[action], engine->curshape);
+   if (hooked (engine,EVENT_SPAWN))
+	 {
+		event.type = EVENT_SPAWN;
+		event.u.spawn.next = engine->nextshape;
+		emit (engine,&event);
+	 }
+   return 0;
 }
 
 /*
@@ -372,38 +600,165 @@ void engine_move (engine_t *engine,action_t action)
  */
 int engine_evaluate (engine_t *engine)
 {
-   if (shape_bottom (engine))
-	 {
-		/* update status information */
-		int dropped_lines = droplines(engine->board);
-		engine->status.droppedlines += dropped_lines;
-		engine->status.currentdroppedlines = dropped_lines;
-		/* increase score */
-		engine->score_function (engine);
-		engine->curx -= 5;
-		engine->curx = abs (engine->curx);
-		engine->curx_shadow -= 5;
-		engine->curx_shadow = abs (engine->curx_shadow);
-		engine->status.rotations = 4 - engine->status.rotations;
-		engine->status.rotations = engine->status.rotations > 0 ? 0 : engine->status.rotations;
-		engine->status.efficiency += engine->status.dropcount + engine->status.rotations + (engine->curx - engine->status.moves);
-		engine->status.efficiency >>= 1;
-		engine->status.dropcount = engine->status.rotations = engine->status.moves = 0;
-		/* intialize values */
-		engine->curx = 5;
-		engine->cury = 1;
-		engine->curx_shadow = 5;
-		engine->cury_shadow = 1;
-		engine->curshape = engine->bag[engine->bag_iterator%NUMSHAPES];
-		/* shuffle bag before first item in bag would be reused */
-		if ((engine->bag_iterator+1) % NUMSHAPES == 0) shuffle(engine->bag, NUMSHAPES);
-		engine->nextshape = engine->bag[(engine->bag_iterator+1)%NUMSHAPES];
-		engine->bag_iterator++;
-		/* initialize shapes */
-		memcpy (engine->shapes,SHAPES,sizeof (shapes_t));
-		/* return games status */
-		return allowed (engine->board,&engine->shapes[engine->curshape],engine->curx,engine->cury) ? 0 : -1;
-	 }
+   if (shape_bottom (engine)) return shape_land (engine);
    shape_down (engine);
    return 1;
 }
+
+/*
+ * Lock the current shape of the specified tetris engine in the given
+ * position, as if it was moved there and came to rest (see place_find ()),
+ * and release the next one.
+ *
+ * OUTPUT:
+ *   0 = next shape released
+ *  -1 = game over (board full)
+ */
+int engine_place (engine_t *engine,int x,int y,int orient)
+{
+   engine->curx = x;
+   engine->cury = y;
+   engine->curorient = orient;
+   return shape_land (engine);
+}
+
+/*
+ * Advance the clock of the specified tetris engine by one tick. The shape
+ * falls engine->gravity rows per tick (any number of them at once) and is
+ * locked when it rested on the stack for engine->lockdelay ticks.
+ *
+ * OUTPUT:
+ *   1 = shape still falling (or resting)
+ *   0 = shape locked, next one released
+ *  -1 = game over (board full)
+ */
+int engine_tick (engine_t *engine)
+{
+   const shape_t *shape = &SHAPES[engine->curshape];
+   int floor = board_floor (engine->board.rows,engine->height,&shape->rotation[engine->curorient],engine->curx,engine->cury);
+   if (engine->cury < floor)
+	 {
+		/* however fast it falls, the shape can't pass the row it would be dropped to */
+		engine->fall += engine->gravity;
+		if (engine->fall >= GRAVITYUNIT)
+		  {
+			 engine->cury += engine->fall / GRAVITYUNIT;
+			 engine->fall %= GRAVITYUNIT;
+			 if (engine->cury >= floor)
+			   {
+				  engine->cury = floor;
+				  engine->fall = 0;
+			   }
+			 engine->lock = 0;
+			 if (engine->shadow) place_shadow_to_bottom (engine,shape,engine->curorient,engine->curx_shadow,&engine->cury_shadow,engine->cury);
+		  }
+		return 1;
+	 }
+   /* resting on the stack */
+   if (++engine->lock < engine->lockdelay) return 1;
+   return shape_land (engine);
+}
+
+/*
+ * Save the gameplay state of the specified tetris engine
+ */
+void engine_snapshot (const engine_t *engine,snapshot_t *snapshot)
+{
+   int x,y;
+   memcpy (snapshot->rows,engine->board.rows,sizeof (snapshot->rows));
+   for (y = 0; y < NUMROWS - 2; y++)
+	 for (x = 1; x < NUMCOLS - 2; x += 2)
+	   snapshot->color[y][x >> 1] = engine->board.color[y][x] | (x + 1 < NUMCOLS - 2 ? engine->board.color[y][x + 1] << 4 : 0);
+   memcpy (snapshot->height,engine->height,sizeof (snapshot->height));
+   memcpy (snapshot->fill,engine->fill,sizeof (snapshot->fill));
+   snapshot->curx = engine->curx;
+   snapshot->cury = engine->cury;
+   snapshot->curx_shadow = engine->curx_shadow;
+   snapshot->cury_shadow = engine->cury_shadow;
+   snapshot->curshape = engine->curshape;
+   snapshot->nextshape = engine->nextshape;
+   snapshot->curorient = engine->curorient;
+   for (x = 0; x < NUMSHAPES; x++) snapshot->bag[x] = engine->bag[x];
+   snapshot->randomizer = engine->randomizer;
+   snapshot->holes = engine->holes;
+   snapshot->bag_iterator = engine->bag_iterator;
+   snapshot->rng = engine->rng;
+   snapshot->score = engine->score;
+   snapshot->status = engine->status;
+   snapshot->fall = engine->fall;
+   snapshot->lock = engine->lock;
+   snapshot->resets = engine->resets;
+}
+
+/*
+ * Continue the specified tetris engine from a saved gameplay state. The
+ * settings of the engine (shadow, gravity, lock delay, score function,
+ * hooks) are left alone.
+ */
+void engine_restore (engine_t *engine,const snapshot_t *snapshot)
+{
+   int x,y;
+   clearboard (&engine->board);
+   memcpy (engine->board.rows,snapshot->rows,sizeof (snapshot->rows));
+   for (y = 0; y < NUMROWS - 2; y++)
+	 for (x = 1; x < NUMCOLS - 2; x += 2)
+	   {
+		  engine->board.color[y][x] = snapshot->color[y][x >> 1] & 15;
+		  /* an odd number of columns leaves the last nibble empty, don't paint over the wall */
+		  if (x + 1 < NUMCOLS - 2) engine->board.color[y][x + 1] = snapshot->color[y][x >> 1] >> 4;
+	   }
+   memcpy (engine->height,snapshot->height,sizeof (snapshot->height));
+   memcpy (engine->fill,snapshot->fill,sizeof (snapshot->fill));
+   engine->curx = snapshot->curx;
+   engine->cury = snapshot->cury;
+   engine->curx_shadow = snapshot->curx_shadow;
+   engine->cury_shadow = snapshot->cury_shadow;
+   engine->curshape = snapshot->curshape;
+   engine->nextshape = snapshot->nextshape;
+   engine->curorient = snapshot->curorient;
+   for (x = 0; x < NUMSHAPES; x++) engine->bag[x] = snapshot->bag[x];
+   engine->randomizer = snapshot->randomizer;
+   engine->holes = snapshot->holes;
+   engine->bag_iterator = snapshot->bag_iterator;
+   engine->rng = snapshot->rng;
+   engine->score = snapshot->score;
+   engine->status = snapshot->status;
+   engine->fall = snapshot->fall;
+   engine->lock = snapshot->lock;
+   engine->resets = snapshot->resets;
+   engine->boardhash = board_hash (engine->board.rows);
+   rehash (engine);
+}
+
+/*
+ * Empty the undo ring
+ */
+void undo_init (undo_t *undo)
+{
+   undo->head = undo->count = 0;
+}
+
+/*
+ * Save the gameplay state of the specified tetris engine in the undo
+ * ring, forgetting the oldest one if the ring is full
+ */
+void undo_push (undo_t *undo,const engine_t *engine)
+{
+   engine_snapshot (engine,&undo->snapshot[undo->head]);
+   undo->head = (undo->head + 1) % UNDOSIZE;
+   if (undo->count < UNDOSIZE) undo->count++;
+}
+
+/*
+ * Put the most recently saved gameplay state back into the specified
+ * tetris engine and remove it from the undo ring. Returns FALSE if
+ * there is nothing left to undo.
+ */
+bool undo_pop (undo_t *undo,engine_t *engine)
+{
+   if (!undo->count) return FALSE;
+   undo->head = (undo->head + UNDOSIZE - 1) % UNDOSIZE;
+   undo->count--;
+   engine_restore (engine,&undo->snapshot[undo->head]);
+   return TRUE;
+}
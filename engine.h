@@ -29,6 +29,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdint.h>		/* uint16_t */
+
 #include "typedefs.h"		/* bool */
 
 /*
@@ -41,30 +43,99 @@
 /* Number of blocks in each shape */
 #define NUMBLOCKS	4
 
-/* Number of rows and columns in board */
-#define NUMROWS	25
-#define NUMCOLS	15
+/* Maximum number of orientations of a shape */
+#define NUMORIENTS	4
+
+/*
+ * Size of the playfield. The engine is specialized for it at compile time,
+ * build with -DPLAYCOLS=n -DPLAYROWS=n (make COLS=n ROWS=n) for other boards.
+ */
+#ifndef PLAYCOLS
+#define PLAYCOLS	12
+#endif
+#ifndef PLAYROWS
+#define PLAYROWS	22
+#endif
+
+/* Number of rows and columns in board: a hidden row above the playfield, */
+/* two rows of floor below it, one wall on the left and two on the right */
+#define NUMROWS	(PLAYROWS + 3)
+#define NUMCOLS	(PLAYCOLS + 3)
+
+#if PLAYCOLS < 4 || PLAYROWS < 4
+#error "The playfield must be at least 4x4"
+#endif
+#if NUMCOLS > 64 || NUMROWS > 64
+#error "The board can't have more than 64 rows or columns (walls and floor included)"
+#endif
+
+/* Where a new shape is released */
+#define SPAWNX	(PLAYCOLS / 2 - 1)
+#define SPAWNY	1
+
+/* Ticks per second of the engine clock (see engine_tick ()) */
+#define TICKRATE	60
+
+/* Gravity is measured in rows per tick, in units of 1 / GRAVITYUNIT. This */
+/* is a multiple of TICKRATE, so that whole rows per second come out exact */
+#define GRAVITYUNIT	(TICKRATE * 1024)
+
+/* Number of ticks a shape may rest on the stack before it is locked */
+#define LOCKDELAY	30
+
+/* Number of times moving a resting shape restarts its lock delay */
+#define LOCKRESETS	15
 
 /* Wall id - Arbitrary, but shouldn't have the same value as one of the colors */
 #define WALL 16
 
+/* Cell x of a row */
+#define BIT(x) ((row_t) 1 << (x))
+
+/* Row with only the walls set (column 0 and the last two columns) */
+#define WALLROW ((row_t) (BIT (0) | BIT (NUMCOLS - 2) | BIT (NUMCOLS - 1)))
+
+/* Row with every column set, i.e. a full line or the floor */
+#define FULLROW ((row_t) ((row_t) ~(row_t) 0 >> (8 * sizeof (row_t) - NUMCOLS)))
+
 /*
  * Type definitions
  */
 
-typedef int board_t[NUMCOLS][NUMROWS];
+/* One row of the board, bit x is set if column x is occupied. It is as */
+/* narrow as the board allows, so that more of them fit in the cache */
+#if NUMCOLS <= 16
+typedef uint16_t row_t;
+#elif NUMCOLS <= 32
+typedef uint32_t row_t;
+#else
+typedef uint64_t row_t;
+#endif
+
+typedef struct
+{
+   row_t rows[NUMROWS];						/* occupied cells (walls included) */
+   unsigned char color[NUMROWS][NUMCOLS];	/* color of each cell (only used for drawing) */
+} board_t;
 
 typedef struct
 {
    int x,y;
 } block_t;
 
+typedef struct
+{
+   int next;						/* orientation reached by rotating this one */
+   int minx,maxx,miny,maxy;		/* bounding box of the blocks */
+   block_t block[NUMBLOCKS];		/* blocks, relative to the shape's position */
+   row_t mask[NUMBLOCKS];			/* blocks in each row of the bounding box, from miny down, shifted by minx */
+} rotation_t;
+
 typedef struct
 {
    int color;
-   int type;
-   bool flipped;
-   block_t block[NUMBLOCKS];
+   int orients;						/* number of distinct orientations */
+   rotation_t rotation[NUMORIENTS];	/* orientations, the first one is used when the shape is released */
 } shape_t,shapes_t[NUMSHAPES];
 
 typedef struct
@@ -77,21 +148,131 @@ typedef struct
    int currentdroppedlines;
 } status_t;
 
+/* Where the shapes come from */
+typedef enum
+{
+   RANDOMIZER_BAG,					/* every shape once in each bag of seven, bags can be computed out of order */
+   RANDOMIZER_SHUFFLE,				/* the same, but each bag is shuffled from the one before (old games) */
+   RANDOMIZER_UNIFORM				/* every shape drawn on its own, out of order as well */
+} randomizer_t;
+
+#define NUMRANDOMIZERS	3
+
+typedef enum { ACTION_LEFT, ACTION_ROTATE, ACTION_RIGHT, ACTION_DROP, ACTION_DOWN } action_t;
+
+/* Things an engine tells its hooks about (see engine_hook ()) */
+typedef enum
+{
+   EVENT_SPAWN,						/* next shape released */
+   EVENT_MOVE,						/* left, right or down action (done or not) */
+   EVENT_ROTATE,					/* rotate action (done or not) */
+   EVENT_DROP,						/* drop action */
+   EVENT_LOCK,						/* shape put on the board where it came to rest */
+   EVENT_LINES,						/* full lines removed after a lock */
+   EVENT_GAMEOVER					/* no room for the next shape */
+} event_type_t;
+
+#define NUMEVENTS	7
+
+/* Mask of an event type, for engine_hook () */
+#define EVENT_BIT(type)	(1U << (type))
+#define EVENT_ALL		(EVENT_BIT (NUMEVENTS) - 1)
+
+typedef struct
+{
+   event_type_t type;
+   int shape,orient,x,y;			/* shape concerned and where it is after the event */
+   union
+	 {
+		struct
+		  {
+			 action_t action;
+			 int fromx,fromy,fromorient;	/* where the shape was before */
+			 bool done;						/* FALSE if it couldn't move */
+		  } move;					/* EVENT_MOVE, EVENT_ROTATE and EVENT_DROP */
+		struct
+		  {
+			 int next;				/* shape released after this one */
+		  } spawn;					/* EVENT_SPAWN */
+		struct
+		  {
+			 int count;				/* number of lines removed */
+			 int total;				/* number of lines removed in the game */
+		  } lines;					/* EVENT_LINES */
+	 } u;
+} event_t;
+
+/* Function called with the events a hook subscribed to */
+typedef void (*hook_t) (const event_t *event,void *arg);
+
+/* Maximum number of hooks on one engine */
+#define MAXHOOKS	4
+
 typedef struct engine_struct
 {
    bool shadow;                                     /* show shadow */
    int curx,cury,curx_shadow,cury_shadow;			/* coordinates of current piece */
    int curshape,nextshape;							/* current & next shapes */
+   int curorient;									/* orientation of current shape */
    int score;										/* score */
    int bag_iterator;								/* iterator for randomized bag */
    int bag[NUMSHAPES];								/* pointer to bag of shapes */
-   shapes_t shapes;									/* shapes */
+   randomizer_t randomizer;							/* how the bag is filled */
+   unsigned int rng;								/* key (or state) of the random generator used to fill the bag */
    board_t board;									/* board */
+   unsigned char height[NUMCOLS];					/* height of the surface of each column above the floor */
+   unsigned char fill[NUMROWS];						/* number of occupied cells in each row (walls excluded) */
+   int holes;										/* number of empty cells below the surface */
+   uint64_t boardhash;								/* Zobrist hash of the occupied cells (see board.h) */
+   uint64_t hash;									/* ... and of the current and next shape and what is left of the bag */
    status_t status;									/* current status of shapes */
+   int gravity;										/* rows per tick the shape falls (in 1 / GRAVITYUNIT) */
+   int lockdelay;									/* ticks a shape may rest before it is locked */
+   int fall;										/* fraction of a row the shape has fallen */
+   int lock;										/* ticks the shape has been resting */
+   int resets;										/* number of times the lock delay was restarted */
    void (*score_function)(struct engine_struct *);	/* score function */
+   unsigned int events;								/* events any hook subscribed to */
+   int numhooks;									/* number of hooks */
+   struct
+	 {
+		hook_t hook;
+		void *arg;
+		unsigned int events;
+	 } hooks[MAXHOOKS];								/* who is told about what happens */
 } engine_t;
 
-typedef enum { ACTION_LEFT, ACTION_ROTATE, ACTION_RIGHT, ACTION_DROP, ACTION_DOWN } action_t;
+/*
+ * Gameplay state of an engine (everything except the settings), packed into
+ * a fixed-size blob without pointers so it can be copied around freely
+ */
+typedef struct
+{
+   row_t rows[NUMROWS];								/* occupied cells */
+   unsigned char color[NUMROWS - 2][(NUMCOLS - 2) / 2];	/* colors of the cells above the floor and inside the walls, two per byte */
+   unsigned char height[NUMCOLS];
+   unsigned char fill[NUMROWS];
+   signed char curx,cury,curx_shadow,cury_shadow;
+   unsigned char curshape,nextshape,curorient;
+   unsigned char bag[NUMSHAPES];
+   unsigned char randomizer;
+   int holes;
+   int bag_iterator;
+   unsigned int rng;
+   int score;
+   status_t status;
+   int fall,lock,resets;
+} snapshot_t;
+
+/* Number of snapshots kept for undo */
+#define UNDOSIZE	64
+
+/* Ring of the last UNDOSIZE snapshots */
+typedef struct
+{
+   int head,count;
+   snapshot_t snapshot[UNDOSIZE];
+} undo_t;
 
 /*
  * Global variables
@@ -99,14 +280,53 @@ typedef enum { ACTION_LEFT, ACTION_ROTATE, ACTION_RIGHT, ACTION_DROP, ACTION_DOW
 
 extern const shapes_t SHAPES;
 
+/* Names of the actions */
+extern const char *ACTIONS_STRING[];
+
+/* Names of the randomizers */
+extern const char *RANDOMIZERS_STRING[];
+
 /*
  * Functions
  */
 
 /*
- * Initialize specified tetris engine
+ * Initialize specified tetris engine. Engines initialized with the same
+ * randomizer and seed get the same shapes.
+ */
+void engine_init (engine_t *engine,void (*score_function)(engine_t *),randomizer_t randomizer,unsigned int seed);
+
+/*
+ * Look up a randomizer by name. Returns TRUE if successful, FALSE
+ * otherwise.
+ */
+bool str2randomizer (randomizer_t *randomizer,const char *str);
+
+/*
+ * Get the n'th shape (counting from 0) the specified tetris engine releases,
+ * or -1 if it was released from an earlier bag and can't be told anymore.
+ * This takes constant time unless the engine shuffles its bags.
+ */
+int engine_peek (const engine_t *engine,unsigned long n);
+
+/*
+ * Get the shapes left in the bag of the specified tetris engine after the
+ * next one (bit s for shape s), or 0 if it doesn't deal its shapes in bags
+ */
+unsigned int engine_bag (const engine_t *engine);
+
+/*
+ * Call hook with arg for the given events (a mask of EVENT_BIT ()s) of the
+ * specified tetris engine. Returns FALSE if the engine has MAXHOOKS hooks
+ * already, or if hooks were compiled out (NOHOOKS).
+ */
+bool engine_hook (engine_t *engine,unsigned int events,hook_t hook,void *arg);
+
+/*
+ * Remove hook with arg from the specified tetris engine. A NULL hook removes
+ * every hook, e.g. from a copy of an engine that should stay quiet.
  */
-void engine_init (engine_t *engine,void (*score_function)(engine_t *));
+void engine_unhook (engine_t *engine,hook_t hook,void *arg);
 
 /*
  * Perform the given action on the specified tetris engine
@@ -123,4 +343,57 @@ void engine_move (engine_t *engine,action_t action);
  */
 int engine_evaluate (engine_t *engine);
 
+/*
+ * Lock the current shape of the specified tetris engine in the given
+ * position, as if it was moved there and came to rest (see place_find ()),
+ * and release the next one.
+ *
+ * OUTPUT:
+ *   0 = next shape released
+ *  -1 = game over (board full)
+ */
+int engine_place (engine_t *engine,int x,int y,int orient);
+
+/*
+ * Advance the clock of the specified tetris engine by one tick. The shape
+ * falls engine->gravity rows per tick (any number of them at once) and is
+ * locked when it rested on the stack for engine->lockdelay ticks.
+ *
+ * OUTPUT:
+ *   1 = shape still falling (or resting)
+ *   0 = shape locked, next one released
+ *  -1 = game over (board full)
+ */
+int engine_tick (engine_t *engine);
+
+/*
+ * Save the gameplay state of the specified tetris engine
+ */
+void engine_snapshot (const engine_t *engine,snapshot_t *snapshot);
+
+/*
+ * Continue the specified tetris engine from a saved gameplay state. The
+ * settings of the engine (shadow, gravity, lock delay, score function,
+ * hooks) are left alone.
+ */
+void engine_restore (engine_t *engine,const snapshot_t *snapshot);
+
+/*
+ * Empty the undo ring
+ */
+void undo_init (undo_t *undo);
+
+/*
+ * Save the gameplay state of the specified tetris engine in the undo
+ * ring, forgetting the oldest one if the ring is full
+ */
+void undo_push (undo_t *undo,const engine_t *engine);
+
+/*
+ * Put the most recently saved gameplay state back into the specified
+ * tetris engine and remove it from the undo ring. Returns FALSE if
+ * there is nothing left to undo.
+ */
+bool undo_pop (undo_t *undo,engine_t *engine);
+
 #endif	/* #ifndef ENGINE_H */
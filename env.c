@@ -0,0 +1,185 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "board.h"
+#include "game.h"
+#include "lockstep.h"
+#include "pool.h"
+#include "env.h"
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up the specified number of environments, stepped with the given
+ * number of threads, that start their games at the given level and get
+ * their shapes from the given randomizer. They have to be started with
+ * env_reset () before they can be stepped. Returns FALSE if there is not
+ * enough memory.
+ */
+bool env_init (env_t *env,int count,int threads,int level,randomizer_t randomizer)
+{
+   env->count = count;
+   env->level = level;
+   env->randomizer = randomizer;
+   env->seed = 0;
+   env->episode = malloc (count * sizeof (unsigned int));
+   env->results = malloc (count * sizeof (int));
+   env->pool = NULL;
+   if (env->episode == NULL || env->results == NULL || !lockstep_init (&env->games,count))
+	 {
+		free (env->episode);
+		free (env->results);
+		return (FALSE);
+	 }
+   /* not more threads than there are chunks to step */
+   if (threads > (count + ENVCHUNK - 1) / ENVCHUNK) threads = (count + ENVCHUNK - 1) / ENVCHUNK;
+   if ((env->pool = pool_start (threads)) == NULL)
+	 {
+		env_free (env);
+		return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/*
+ * Release everything env_init () set up
+ */
+void env_free (env_t *env)
+{
+   if (env->pool != NULL) pool_stop (env->pool);
+   lockstep_free (&env->games);
+   free (env->episode);
+   free (env->results);
+   env->pool = NULL;
+   env->episode = NULL;
+   env->results = NULL;
+}
+
+/* Start the next game of environment k */
+static void restart (env_t *env,int k)
+{
+   lockstep_reset (&env->games,k,env->level,env->randomizer,rand_seed (rand_seed (env->seed,k),env->episode[k]));
+}
+
+/* Write what environment k looks like */
+static void observe (const env_t *env,int k,const envbuffers_t *out)
+{
+   const lockstep_t *games = &env->games;
+   int8_t *piece = out->piece + (size_t) k * ENVPIECE;
+   board_pack (games->rows + (size_t) k * NUMROWS,out->board + (size_t) k * ENVBOARDWORDS);
+   piece[ENVPIECE_SHAPE] = games->curshape[k];
+   piece[ENVPIECE_ORIENT] = games->curorient[k];
+   piece[ENVPIECE_X] = games->curx[k];
+   piece[ENVPIECE_Y] = games->cury[k];
+   piece[ENVPIECE_NEXT] = games->nextshape[k];
+   out->bag[k] = lockstep_bag (games,k);
+}
+
+/* Job of the pool: step the index'th chunk of environments */
+static void step (void *arg,unsigned long index)
+{
+   env_t *env = arg;
+   lockstep_t *games = &env->games;
+   const envbuffers_t *out = env->out;
+   int first = index * ENVCHUNK,last = first + ENVCHUNK < env->count ? first + ENVCHUNK : env->count;
+   int k,score[ENVCHUNK];
+   for (k = first; k < last; k++) score[k - first] = GETSCORE (games->score[k]);
+   lockstep_steprange (games,first,last,env->actions,env->results);
+   for (k = first; k < last; k++)
+	 {
+		/* the shape fell (1), came to rest (0) or ended the game (-1) */
+		out->reward[k] = GETSCORE (games->score[k]) - score[k - first];
+		out->done[k] = env->results[k] < 0;
+		if (out->info != NULL)
+		  {
+			 envinfo_t *info = &out->info[k];
+			 info->landed = env->results[k] <= 0;
+			 info->lines = info->landed ? games->currentdroppedlines[k] : 0;
+			 info->score = GETSCORE (games->score[k]);
+			 info->totallines = games->droppedlines[k];
+			 info->shapes = games->shapes[k];
+			 info->level = games->level[k];
+			 info->episode = env->episode[k];
+		  }
+		if (out->done[k])
+		  {
+			 env->episode[k]++;
+			 restart (env,k);
+		  }
+		observe (env,k,out);
+	 }
+}
+
+/*
+ * Start every environment over with a new game, drawn from the given seed,
+ * and write what they look like to out. The rewards and done flags are
+ * cleared.
+ */
+void env_reset (env_t *env,unsigned int seed,const envbuffers_t *out)
+{
+   int k;
+   env->seed = seed;
+   for (k = 0; k < env->count; k++)
+	 {
+		env->episode[k] = 0;
+		restart (env,k);
+		observe (env,k,out);
+		out->reward[k] = 0;
+		out->done[k] = FALSE;
+		if (out->info != NULL)
+		  {
+			 out->info[k].lines = out->info[k].totallines = out->info[k].score = 0;
+			 out->info[k].landed = FALSE;
+			 out->info[k].shapes = env->games.shapes[k];
+			 out->info[k].level = env->level;
+			 out->info[k].episode = 0;
+		  }
+	 }
+}
+
+/*
+ * Perform actions[k] in environment k, let its shape fall a row and write
+ * what happened to out. If a game ended, done is set, info (if any) says
+ * how it went, and the observation is already that of the game that took
+ * its place.
+ */
+void env_step (env_t *env,const action_t *actions,const envbuffers_t *out)
+{
+   env->actions = actions;
+   env->out = out;
+   pool_do (env->pool,(env->count + ENVCHUNK - 1) / ENVCHUNK,step,env);
+}
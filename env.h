@@ -0,0 +1,153 @@
+#ifndef ENV_H
+#define ENV_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* action_t, randomizer_t */
+#include "board.h"			/* PACKROWS, PACKWORDS */
+#include "lockstep.h"		/* lockstep_t */
+#include "pool.h"			/* pool_t */
+
+/*
+ * Macros
+ */
+
+/* Rows of the board an observation shows: the hidden row and the playfield */
+#define ENVROWS			PACKROWS
+
+/* Words of the board of an observation, packed by board_pack () */
+#define ENVBOARDWORDS	PACKWORDS
+
+/* Numbers describing the shapes of an observation, in this order */
+#define ENVPIECE_SHAPE	0			/* falling shape */
+#define ENVPIECE_ORIENT	1			/* ... its orientation */
+#define ENVPIECE_X		2			/* ... and where it is (see engine_t) */
+#define ENVPIECE_Y		3
+#define ENVPIECE_NEXT	4			/* next shape */
+#define ENVPIECE		5
+
+/* Environments stepped by a job of the pool (a multiple of a cache line of ints) */
+#define ENVCHUNK		64
+
+/*
+ * Type definitions
+ */
+
+/* What happened to an environment in the last step */
+typedef struct
+{
+   int lines;						/* lines removed by the step */
+   bool landed;						/* the shape came to rest */
+   int score;						/* score of the game so far (the one that ended, if done) */
+   int totallines;					/* lines removed in it */
+   int shapes;						/* shapes released in it */
+   int level;
+   unsigned int episode;			/* games the environment started before this one */
+} envinfo_t;
+
+/*
+ * Where the environments write what they look like and how the step went,
+ * element k (or the k'th ENVBOARDWORDS or ENVPIECE elements) for
+ * environment k. The buffers belong to the caller, are written in place on
+ * every step and can be read between steps. info may be NULL.
+ */
+typedef struct
+{
+   uint64_t *board;				/* occupied cells, bit-packed (see board_pack ()) */
+   int8_t *piece;				/* falling and next shape (see ENVPIECE) */
+   uint8_t *bag;				/* shapes left in the bag after the next one (bit s for shape s) */
+   float *reward;				/* score the step earned */
+   uint8_t *done;				/* the game ended and was started over */
+   envinfo_t *info;
+} envbuffers_t;
+
+/*
+ * Many games played as training environments: every step takes an action
+ * for every game, performs it and lets the shape fall a row, i.e.
+ * game_move () followed by game_step () (see lockstep.h, which plays them
+ * exactly like the engine does). A game that ends is started over at once
+ * with a seed of its own: game e of environment k is played with seed
+ * rand_seed (rand_seed (seed,k),e), so an environment gets the same games
+ * however many threads step it. The games are split into chunks of
+ * ENVCHUNK that are stepped by a pool of threads, and a step allocates
+ * nothing.
+ */
+typedef struct
+{
+   int count;						/* number of environments */
+   int level;						/* level every game starts at */
+   randomizer_t randomizer;
+   unsigned int seed;
+   lockstep_t games;
+   unsigned int *episode;			/* games each environment started before its current one */
+   int *results;					/* what the last step did to each game (see lockstep_step ()) */
+   pool_t *pool;
+   /* step being taken */
+   const action_t *actions;
+   const envbuffers_t *out;
+} env_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up the specified number of environments, stepped with the given
+ * number of threads, that start their games at the given level and get
+ * their shapes from the given randomizer. They have to be started with
+ * env_reset () before they can be stepped. Returns FALSE if there is not
+ * enough memory.
+ */
+bool env_init (env_t *env,int count,int threads,int level,randomizer_t randomizer);
+
+/*
+ * Release everything env_init () set up
+ */
+void env_free (env_t *env);
+
+/*
+ * Start every environment over with a new game, drawn from the given seed,
+ * and write what they look like to out. The rewards and done flags are
+ * cleared.
+ */
+void env_reset (env_t *env,unsigned int seed,const envbuffers_t *out);
+
+/*
+ * Perform actions[k] in environment k, let its shape fall a row and write
+ * what happened to out. If a game ended, done is set, info (if any) says
+ * how it went, and the observation is already that of the game that took
+ * its place.
+ */
+void env_step (env_t *env,const action_t *actions,const envbuffers_t *out);
+
+#endif	/* #ifndef ENV_H */
@@ -0,0 +1,312 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "bot.h"
+#include "eval.h"
+
+/*
+ * Macros
+ */
+
+/* The kernel can be compiled for these instruction sets and picked at run time */
+#if defined (__x86_64__) || defined (__i386__)
+#define TARGETS
+#endif
+
+/* Number of boards measured by one vector */
+#define LANES		(32 / (int) sizeof (row_t))
+
+/* Cells inside the walls, neighbouring pairs of them, and every cell with the one to its right */
+#define INSIDE		((row_t) (FULLROW & ~WALLROW))
+#define PAIRS		((row_t) (INSIDE & (INSIDE >> 1)))
+#define EDGES		((row_t) (FULLROW >> 2))
+
+/* Make sure the kernel ends up in the functions compiled for each instruction set */
+#define INLINE		static inline __attribute__ ((always_inline))
+
+/*
+ * Type definitions
+ */
+
+/* The same row of LANES boards */
+typedef row_t vrow_t __attribute__ ((vector_size (32)));
+
+/*
+ * Global variables
+ */
+
+const char *KERNELS_STRING[] = { "scalar", "sse4.2", "avx2" };
+
+/* Kernel that is used, or -1 if it hasn't been picked yet */
+static atomic_int kernel = -1;
+
+/*
+ * Functions
+ */
+
+/*
+ * Add a board (NUMROWS rows, walls included) to a batch that isn't full.
+ * A batch is emptied by setting its count to 0. Returns the index of the
+ * board in the batch.
+ */
+int eval_add (evalbatch_t *batch,const row_t *rows,int lines)
+{
+   int y,i = batch->count++;
+   for (y = 0; y < NUMROWS; y++) batch->rows[y][i] = rows[y];
+   batch->lines[i] = lines;
+   /* the rows above every stack add nothing to the features */
+   for (y = 0; y < NUMROWS - 2 && !(rows[y] & INSIDE); y++) ;
+   if (!i || y < batch->top) batch->top = y;
+   return (i);
+}
+
+/* Count the cells of every row of a vector (board_cells () lane by lane) */
+INLINE vrow_t cells (vrow_t n)
+{
+   unsigned int shift;
+   n -= (n >> 1) & (row_t) 0x5555555555555555ULL;
+   n = (n & (row_t) 0x3333333333333333ULL) + ((n >> 2) & (row_t) 0x3333333333333333ULL);
+   n = (n + (n >> 4)) & (row_t) 0x0f0f0f0f0f0f0f0fULL;
+   for (shift = 8; shift < 8 * sizeof (row_t); shift <<= 1) n += n >> shift;
+   return (n & 0xff);
+}
+
+/* Measure LANES boards at a time, from the empty row above the highest stack down */
+INLINE void measure (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   const vrow_t zero = { 0 };
+   vrow_t row,below,seen,stack,height,holes,bumpiness,wells,rowtransitions,coltransitions;
+   int i,j,y;
+   for (i = 0; i < batch->count; i += LANES)
+	 {
+		seen = height = holes = bumpiness = wells = rowtransitions = coltransitions = zero;
+		y = batch->top > 0 ? batch->top - 1 : 0;
+		memcpy (&below,&batch->rows[y][i],sizeof (below));
+		for ( ; y < NUMROWS - 2; y++)
+		  {
+			 row = below;
+			 memcpy (&below,&batch->rows[y + 1][i],sizeof (below));
+			 /* a cell is below the surface once anything above it in its column is occupied */
+			 seen |= row;
+			 stack = seen & INSIDE;
+			 height += cells (stack);
+			 holes += cells (stack & ~row);
+			 bumpiness += cells ((stack ^ (stack >> 1)) & PAIRS);
+			 /* the walls are always seen, so they are higher than any column */
+			 wells += cells (~seen & (seen << 1) & (seen >> 1) & INSIDE);
+			 if (transitions)
+			   {
+				  rowtransitions += cells ((row ^ (row >> 1)) & EDGES) & (vrow_t) (stack != 0);
+				  coltransitions += cells ((row ^ below) & INSIDE);
+			   }
+		  }
+		for (j = 0; j < LANES && i + j < batch->count; j++)
+		  {
+			 features[i + j][FEATURE_HEIGHT] = height[j];
+			 features[i + j][FEATURE_HOLES] = holes[j];
+			 features[i + j][FEATURE_BUMPINESS] = bumpiness[j];
+			 features[i + j][FEATURE_ROWTRANSITIONS] = rowtransitions[j];
+			 features[i + j][FEATURE_COLTRANSITIONS] = coltransitions[j];
+			 features[i + j][FEATURE_WELLS] = wells[j];
+			 features[i + j][FEATURE_LINES] = batch->lines[i + j];
+		  }
+	 }
+}
+
+#ifdef TARGETS
+__attribute__ ((target ("avx2"))) static void measure_avx2 (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   measure (batch,features,transitions);
+}
+
+__attribute__ ((target ("sse4.2"))) static void measure_sse42 (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   measure (batch,features,transitions);
+}
+#endif
+
+/* The same sums one board at a time, for processors the kernel isn't compiled for */
+static void measure_scalar (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   row_t row,below,seen,stack;
+   int i,y,*f;
+   for (i = 0; i < batch->count; i++)
+	 {
+		f = features[i];
+		memset (f,0,NUMFEATURES * sizeof (int));
+		seen = 0;
+		for (y = batch->top > 0 ? batch->top - 1 : 0; y < NUMROWS - 2; y++)
+		  {
+			 row = batch->rows[y][i];
+			 below = batch->rows[y + 1][i];
+			 seen |= row;
+			 stack = seen & INSIDE;
+			 f[FEATURE_HEIGHT] += board_cells (stack);
+			 f[FEATURE_HOLES] += board_cells (stack & ~row);
+			 f[FEATURE_BUMPINESS] += board_cells ((stack ^ (stack >> 1)) & PAIRS);
+			 f[FEATURE_WELLS] += board_cells (~seen & (row_t) (seen << 1) & (seen >> 1) & INSIDE);
+			 if (transitions)
+			   {
+				  if (stack) f[FEATURE_ROWTRANSITIONS] += board_cells ((row ^ (row >> 1)) & EDGES);
+				  f[FEATURE_COLTRANSITIONS] += board_cells ((row ^ below) & INSIDE);
+			   }
+		  }
+		f[FEATURE_LINES] = batch->lines[i];
+	 }
+}
+
+/* Best kernel the processor supports */
+static evalkernel_t best ()
+{
+#ifdef TARGETS
+   __builtin_cpu_init ();
+   if (__builtin_cpu_supports ("avx2")) return (EVAL_AVX2);
+   if (__builtin_cpu_supports ("sse4.2")) return (EVAL_SSE42);
+#endif
+   return (EVAL_SCALAR);
+}
+
+/*
+ * Get the kernel that is used
+ */
+evalkernel_t eval_kernel ()
+{
+   int k = atomic_load (&kernel);
+   if (k < 0)
+	 {
+		k = best ();
+		atomic_store (&kernel,k);
+	 }
+   return ((evalkernel_t) k);
+}
+
+/*
+ * Use the named kernel (scalar, sse4.2, avx2, or auto for the best one
+ * the processor supports) from now on. Returns FALSE if the processor
+ * doesn't support it.
+ */
+bool eval_use (const char *name)
+{
+   int k;
+   if (strcmp (name,"auto") == 0)
+	 k = best ();
+   else
+	 {
+		for (k = 0; k < NUMKERNELS && strcmp (name,KERNELS_STRING[k]) != 0; k++) ;
+		if (k == NUMKERNELS || k > (int) best ()) return (FALSE);
+	 }
+   atomic_store (&kernel,k);
+   return (TRUE);
+}
+
+/* Measure a batch with the specified kernel */
+static void measure_with (evalkernel_t k,const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   switch (k)
+	 {
+#ifdef TARGETS
+	  case EVAL_AVX2:
+		measure_avx2 (batch,features,transitions);
+		break;
+	  case EVAL_SSE42:
+		measure_sse42 (batch,features,transitions);
+		break;
+#endif
+	  default:
+		measure_scalar (batch,features,transitions);
+	 }
+}
+
+/*
+ * Measure the features of every board of a batch (see bot_features ()).
+ * The transitions are only counted if asked for, and are 0 otherwise.
+ */
+void eval_features (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions)
+{
+   measure_with (eval_kernel (),batch,features,transitions);
+}
+
+/*
+ * Get how much the bot likes every board of a batch, exactly as
+ * bot_score () would from its features
+ */
+void eval_scores (const evalbatch_t *batch,const weights_t *weights,double *scores)
+{
+   int features[EVALBATCH][NUMFEATURES],i;
+   eval_features (batch,features,weights->weight[FEATURE_ROWTRANSITIONS] != 0 || weights->weight[FEATURE_COLTRANSITIONS] != 0);
+   for (i = 0; i < batch->count; i++) scores[i] = bot_score (weights,features[i]);
+}
+
+/*
+ * Measure the features of a board the slow way, from its column heights,
+ * as a reference for the kernels
+ */
+void eval_reference (const board_t *board,int lines,int *features)
+{
+   unsigned char height[NUMCOLS],fill[NUMROWS];
+   int holes;
+   board_surface (board->rows,height,fill,&holes);
+   bot_features (board->rows,height,holes,lines,features);
+}
+
+/*
+ * Measure every board of a batch with every kernel the processor supports,
+ * with and without the transitions, and compare the features with those
+ * of eval_reference (). Returns the number of boards some kernel got wrong.
+ */
+int eval_check (const evalbatch_t *batch)
+{
+   int features[EVALBATCH][NUMFEATURES],reference[EVALBATCH][NUMFEATURES];
+   bool wrong[EVALBATCH] = { FALSE };
+   board_t board;
+   int i,y,k,f,transitions,count = 0;
+   memset (&board,0,sizeof (board));
+   for (i = 0; i < batch->count; i++)
+	 {
+		for (y = 0; y < NUMROWS; y++) board.rows[y] = batch->rows[y][i];
+		eval_reference (&board,batch->lines[i],reference[i]);
+	 }
+   for (k = 0; k <= (int) best (); k++)
+	 for (transitions = 0; transitions < 2; transitions++)
+	   {
+		  measure_with ((evalkernel_t) k,batch,features,transitions);
+		  for (i = 0; i < batch->count; i++)
+			for (f = 0; f < NUMFEATURES; f++)
+			  if (features[i][f] != (!transitions && (f == FEATURE_ROWTRANSITIONS || f == FEATURE_COLTRANSITIONS) ? 0 : reference[i][f]))
+				wrong[i] = TRUE;
+	   }
+   for (i = 0; i < batch->count; i++) count += wrong[i];
+   return (count);
+}
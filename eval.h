@@ -0,0 +1,137 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Measuring many boards at once. The boards are kept side by side, row by
+ * row, so that one vector holds the same row of many boards and every
+ * feature is a sum of cell counts over the rows:
+ *
+ *   height       cells at or below the surface of their column
+ *   holes        empty cells below the surface
+ *   bumpiness    neighbouring cells of which only one is below the surface
+ *   wells        cells above the surface with both neighbours below theirs
+ *   transitions  neighbouring cells that differ, within a row or a column
+ *
+ * The same kernel is compiled for AVX2 and SSE4.2 and picked when the
+ * processor supports it, with a plain C version for the others.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* row_t, board_t */
+#include "bot.h"			/* weights_t, NUMFEATURES */
+
+/*
+ * Macros
+ */
+
+/* Maximum number of boards in a batch */
+#define EVALBATCH	64
+
+/*
+ * Type definitions
+ */
+
+/* Boards to measure, with the number of lines removed to get to each one */
+typedef struct
+{
+   int count;
+   int top;							/* highest row any of the boards has a cell in */
+   row_t rows[NUMROWS][EVALBATCH];	/* row y of board i is rows[y][i] */
+   int lines[EVALBATCH];
+} evalbatch_t;
+
+/* Ways to run the kernel */
+typedef enum
+{
+   EVAL_SCALAR,
+   EVAL_SSE42,
+   EVAL_AVX2
+} evalkernel_t;
+
+#define NUMKERNELS	3
+
+/*
+ * Global variables
+ */
+
+/* Names of the kernels */
+extern const char *KERNELS_STRING[];
+
+/*
+ * Functions
+ */
+
+/*
+ * Add a board (NUMROWS rows, walls included) to a batch that isn't full.
+ * A batch is emptied by setting its count to 0. Returns the index of the
+ * board in the batch.
+ */
+int eval_add (evalbatch_t *batch,const row_t *rows,int lines);
+
+/*
+ * Measure the features of every board of a batch (see bot_features ()).
+ * The transitions are only counted if asked for, and are 0 otherwise.
+ */
+void eval_features (const evalbatch_t *batch,int (*features)[NUMFEATURES],bool transitions);
+
+/*
+ * Get how much the bot likes every board of a batch, exactly as
+ * bot_score () would from its features
+ */
+void eval_scores (const evalbatch_t *batch,const weights_t *weights,double *scores);
+
+/*
+ * Measure the features of a board the slow way, from its column heights,
+ * as a reference for the kernels
+ */
+void eval_reference (const board_t *board,int lines,int *features);
+
+/*
+ * Measure every board of a batch with every kernel the processor supports,
+ * with and without the transitions, and compare the features with those
+ * of eval_reference (). Returns the number of boards some kernel got wrong.
+ */
+int eval_check (const evalbatch_t *batch);
+
+/*
+ * Get the kernel that is used
+ */
+evalkernel_t eval_kernel ();
+
+/*
+ * Use the named kernel (scalar, sse4.2, avx2, or auto for the best one
+ * the processor supports) from now on. Returns FALSE if the processor
+ * doesn't support it.
+ */
+bool eval_use (const char *name);
+
+#endif	/* #ifndef EVAL_H */
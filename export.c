@@ -0,0 +1,406 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "game.h"
+#include "export.h"
+
+/*
+ * Macros
+ */
+
+/* Describe a field of a record */
+#define FIELD(name,type,count) { #name, offsetof (record_t,name), sizeof (((record_t *) 0)->name) / (count), (count), (type) }
+
+/*
+ * Global variables
+ */
+
+/* The fields of a record, as they are described in the header of a shard */
+static const recordfield_t FIELDS[RECORDFIELDS] =
+{
+   FIELD (board,'u',PACKWORDS),
+   FIELD (game,'u',1),
+   FIELD (turn,'u',1),
+   FIELD (score,'i',1),
+   FIELD (reward,'i',1),
+   FIELD (lines,'u',1),
+   FIELD (flags,'u',1),
+   FIELD (shape,'u',1),
+   FIELD (next,'u',1),
+   FIELD (bag,'u',1),
+   FIELD (orient,'u',1),
+   FIELD (x,'i',1),
+   FIELD (y,'i',1),
+   FIELD (level,'u',1)
+};
+
+/*
+ * Functions
+ */
+
+/* Write the header of the shard being written, at the start of the file */
+static bool putheader (exporter_t *exporter,bool complete)
+{
+   char page[SHARDHEADER];
+   shardheader_t *header = (shardheader_t *) page;
+   memset (page,0,sizeof (page));
+   memcpy (header->magic,SHARDMAGIC,sizeof (header->magic));
+   header->version = SHARDVERSION;
+   header->byteorder = 0x01020304;
+   header->headersize = SHARDHEADER;
+   header->recordsize = sizeof (record_t);
+   header->cols = PLAYCOLS;
+   header->rows = PACKROWS;
+   header->boardwords = PACKWORDS;
+   header->complete = complete;
+   header->count = complete ? exporter->count : 0;
+   header->index = complete ? SHARDHEADER + exporter->count * sizeof (record_t) : 0;
+   header->runs = complete ? exporter->numruns : 0;
+   header->fields = RECORDFIELDS;
+   memcpy (header->field,FIELDS,sizeof (FIELDS));
+   return (fseek (exporter->fp,0,SEEK_SET) == 0 && fwrite (page,sizeof (page),1,exporter->fp) == 1);
+}
+
+/* The writer couldn't write a shard: tell why and drop whatever else comes */
+static void failed (exporter_t *exporter,const char *what)
+{
+   fprintf (stderr,"Could not write shard %s-%06u.shard -- %s\n",exporter->prefix,exporter->shards - 1,what);
+   exporter->failed = TRUE;
+   if (exporter->fp != NULL) fclose (exporter->fp);
+   exporter->fp = NULL;
+}
+
+/* Start the next shard */
+static bool begin (exporter_t *exporter)
+{
+   char name[FILENAME_MAX];
+   snprintf (name,sizeof (name),"%s-%06u.shard",exporter->prefix,exporter->shards++);
+   exporter->count = 0;
+   exporter->numruns = 0;
+   if ((exporter->fp = fopen (name,"wb")) == NULL)
+	 {
+		failed (exporter,"can't create it");
+		return (FALSE);
+	 }
+   if (!putheader (exporter,FALSE))
+	 {
+		failed (exporter,"can't write its header");
+		return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/* Write the index of the shard being written and close it */
+static void finish (exporter_t *exporter)
+{
+   if (fwrite (exporter->runs,sizeof (shardrun_t),exporter->numruns,exporter->fp) != exporter->numruns || !putheader (exporter,TRUE))
+	 {
+		failed (exporter,"can't write its index");
+		return;
+	 }
+   if (fclose (exporter->fp))
+	 {
+		exporter->fp = NULL;
+		failed (exporter,"can't close it");
+		return;
+	 }
+   exporter->fp = NULL;
+}
+
+/* Write the records of a block, starting new shards as they fill up */
+static void store (exporter_t *exporter,const exportblock_t *block)
+{
+   shardrun_t *runs;
+   int i,n;
+   for (i = 0; i < block->count && !exporter->failed; i += n)
+	 {
+		if (exporter->fp == NULL && !begin (exporter)) break;
+		n = block->count - i;
+		if (n > exporter->capacity - exporter->count) n = exporter->capacity - exporter->count;
+		if (exporter->numruns == exporter->maxruns)
+		  {
+			 exporter->maxruns = exporter->maxruns ? exporter->maxruns * 2 : 256;
+			 if ((runs = realloc (exporter->runs,exporter->maxruns * sizeof (shardrun_t))) == NULL)
+			   {
+				  failed (exporter,"not enough memory for its index");
+				  break;
+			   }
+			 exporter->runs = runs;
+		  }
+		if (fwrite (block->record + i,sizeof (record_t),n,exporter->fp) != n)
+		  {
+			 failed (exporter,"can't write its records");
+			 break;
+		  }
+		runs = &exporter->runs[exporter->numruns++];
+		runs->game = block->record[i].game;
+		runs->turn = block->record[i].turn;
+		runs->first = exporter->count;
+		runs->count = n;
+		exporter->count += n;
+		exporter->written += n;
+		if (exporter->count == exporter->capacity) finish (exporter);
+	 }
+}
+
+/* The writer: write the blocks in the order they come, until told to stop */
+static void *writer (void *arg)
+{
+   exporter_t *exporter = arg;
+   exportblock_t *block;
+   for (;;)
+	 {
+		pthread_mutex_lock (&exporter->lock);
+		while (exporter->queue == NULL && !exporter->quit)
+		  pthread_cond_wait (&exporter->wakeup,&exporter->lock);
+		if ((block = exporter->queue) != NULL && (exporter->queue = block->next) == NULL) exporter->last = NULL;
+		pthread_mutex_unlock (&exporter->lock);
+		if (block == NULL) break;
+		store (exporter,block);
+		pthread_mutex_lock (&exporter->lock);
+		block->next = exporter->free;
+		exporter->free = block;
+		pthread_cond_signal (&exporter->room);
+		pthread_mutex_unlock (&exporter->lock);
+	 }
+   if (exporter->fp != NULL) finish (exporter);
+   return (NULL);
+}
+
+/*
+ * Start writing shards with the given prefix (see exporter_t), with up to
+ * capacity records each. Returns FALSE if there is no thread for it.
+ */
+bool export_open (exporter_t *exporter,const char *prefix,unsigned long capacity)
+{
+   exporter->prefix = prefix;
+   exporter->capacity = capacity;
+   exporter->fp = NULL;
+   exporter->shards = 0;
+   exporter->count = 0;
+   exporter->runs = NULL;
+   exporter->numruns = exporter->maxruns = 0;
+   exporter->written = 0;
+   exporter->queue = exporter->last = exporter->free = NULL;
+   exporter->blocks = 0;
+   exporter->quit = exporter->failed = FALSE;
+   pthread_mutex_init (&exporter->lock,NULL);
+   pthread_cond_init (&exporter->wakeup,NULL);
+   pthread_cond_init (&exporter->room,NULL);
+   if (pthread_create (&exporter->thread,NULL,writer,exporter))
+	 {
+		pthread_cond_destroy (&exporter->room);
+		pthread_cond_destroy (&exporter->wakeup);
+		pthread_mutex_destroy (&exporter->lock);
+		return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/*
+ * Write what was recorded and stop. Every game has to be stopped first.
+ * Returns FALSE (and tells why on stderr) if a shard could not be written.
+ */
+bool export_close (exporter_t *exporter)
+{
+   exportblock_t *block;
+   pthread_mutex_lock (&exporter->lock);
+   exporter->quit = TRUE;
+   pthread_cond_signal (&exporter->wakeup);
+   pthread_mutex_unlock (&exporter->lock);
+   pthread_join (exporter->thread,NULL);
+   while ((block = exporter->free) != NULL)
+	 {
+		exporter->free = block->next;
+		free (block);
+	 }
+   free (exporter->runs);
+   exporter->runs = NULL;
+   pthread_cond_destroy (&exporter->room);
+   pthread_cond_destroy (&exporter->wakeup);
+   pthread_mutex_destroy (&exporter->lock);
+   return (!exporter->failed);
+}
+
+/* Get an empty block, waiting for the writer if all of them are taken. Returns NULL if there is no memory for any */
+static exportblock_t *take (exporter_t *exporter)
+{
+   exportblock_t *block = NULL;
+   pthread_mutex_lock (&exporter->lock);
+   for (;;)
+	 {
+		if ((block = exporter->free) != NULL)
+		  {
+			 exporter->free = block->next;
+			 break;
+		  }
+		if (exporter->blocks < EXPORTBLOCKS && (block = malloc (sizeof (exportblock_t))) != NULL)
+		  {
+			 exporter->blocks++;
+			 break;
+		  }
+		if (!exporter->blocks) break;
+		pthread_cond_wait (&exporter->room,&exporter->lock);
+	 }
+   pthread_mutex_unlock (&exporter->lock);
+   if (block != NULL) block->count = 0;
+   return (block);
+}
+
+/* Hand a block to the writer (or back, if it is empty) */
+static void hand (exporter_t *exporter,exportblock_t *block)
+{
+   pthread_mutex_lock (&exporter->lock);
+   block->next = NULL;
+   if (!block->count)
+	 {
+		block->next = exporter->free;
+		exporter->free = block;
+		pthread_cond_signal (&exporter->room);
+	 }
+   else
+	 {
+		if (exporter->last != NULL)
+		  exporter->last->next = block;
+		else
+		  exporter->queue = block;
+		exporter->last = block;
+		pthread_cond_signal (&exporter->wakeup);
+	 }
+   pthread_mutex_unlock (&exporter->lock);
+}
+
+/* Note the state the falling shape came out in */
+static void observe (recorder_t *recorder)
+{
+   const game_t *game = recorder->game;
+   const engine_t *engine = &game->engine;
+   record_t *shape = &recorder->shape;
+   board_pack (engine->board.rows,shape->board);
+   shape->game = recorder->id;
+   shape->turn = recorder->turn;
+   shape->score = GETSCORE (engine->score);
+   shape->reward = 0;
+   shape->lines = 0;
+   shape->flags = 0;
+   shape->shape = engine->curshape;
+   shape->next = engine->nextshape;
+   shape->bag = engine_bag (engine);
+   shape->orient = shape->x = shape->y = 0;
+   shape->level = 0;
+   shape->unused = 0;
+   recorder->falling = TRUE;
+}
+
+/* The falling shape came to rest: add it to the block, and hand the block over once it is full */
+static void record (recorder_t *recorder,bool over)
+{
+   const game_t *game = recorder->game;
+   record_t *shape = &recorder->shape;
+   shape->reward = GETSCORE (game->engine.score) - shape->score;
+   /* the level only goes up once the engine is done with the shape */
+   shape->level = game->level;
+   shape->flags = (over ? RECORD_DONE : 0) | (game->shownext ? RECORD_SHOWNEXT : 0) | (game->dottedlines ? RECORD_DOTTED : 0);
+   recorder->falling = FALSE;
+   recorder->turn++;
+   if (recorder->block == NULL) return;
+   recorder->block->record[recorder->block->count++] = *shape;
+   if (recorder->block->count == EXPORTBLOCK)
+	 {
+		hand (recorder->exporter,recorder->block);
+		recorder->block = take (recorder->exporter);
+	 }
+}
+
+/* Hook on the engine */
+static void recorded (const event_t *event,void *arg)
+{
+   recorder_t *recorder = arg;
+   switch (event->type)
+	 {
+	  case EVENT_LOCK:
+		recorder->shape.orient = event->orient;
+		recorder->shape.x = event->x;
+		recorder->shape.y = event->y;
+		break;
+	  case EVENT_LINES:
+		recorder->shape.lines = event->u.lines.count;
+		break;
+	  case EVENT_SPAWN:
+		if (recorder->falling) record (recorder,FALSE);
+		observe (recorder);
+		break;
+	  case EVENT_GAMEOVER:
+		if (recorder->falling) record (recorder,TRUE);
+		break;
+	  default:
+		break;
+	 }
+}
+
+/*
+ * Record every shape of the specified game from now on, as game number id.
+ * Returns FALSE if there is no room for a hook (see engine_hook ()).
+ */
+bool export_start (exporter_t *exporter,recorder_t *recorder,game_t *game,uint32_t id)
+{
+   recorder->exporter = exporter;
+   recorder->game = game;
+   recorder->id = id;
+   recorder->turn = game->turn;
+   recorder->falling = FALSE;
+   if (!engine_hook (&game->engine,EVENT_BIT (EVENT_LOCK) | EVENT_BIT (EVENT_LINES) | EVENT_BIT (EVENT_SPAWN) | EVENT_BIT (EVENT_GAMEOVER),
+					 recorded,recorder))
+	 return (FALSE);
+   recorder->block = take (exporter);
+   /* the shape that is falling came out before there was a hook */
+   observe (recorder);
+   return (TRUE);
+}
+
+/*
+ * Stop recording a game and hand what it recorded to the writer. A shape
+ * that hasn't come to rest yet isn't recorded.
+ */
+void export_stop (recorder_t *recorder)
+{
+   engine_unhook (&recorder->game->engine,recorded,recorder);
+   if (recorder->block != NULL) hand (recorder->exporter,recorder->block);
+   recorder->block = NULL;
+}
@@ -0,0 +1,223 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* event_t */
+#include "board.h"			/* PACKWORDS */
+#include "game.h"			/* game_t */
+
+/*
+ * Macros
+ */
+
+/* First bytes of a shard, and the version of its layout */
+#define SHARDMAGIC		"TINTSHRD"
+#define SHARDVERSION	1
+
+/* Bytes before the first record (a page, so the records can be mapped page by page) */
+#define SHARDHEADER		4096
+
+/* Records per shard unless told otherwise (64 MB for the default board) */
+#define SHARDRECORDS	(1UL << 20)
+
+/* Records a game hands to the writer at a time */
+#define EXPORTBLOCK		1024
+
+/* Most blocks that are filled or written at the same time; games wait for the writer beyond that */
+#define EXPORTBLOCKS	64
+
+/* Flags of a record */
+#define RECORD_DONE		1			/* the game was over after the shape */
+#define RECORD_SHOWNEXT	2			/* the next shape was shown (see game_t) */
+#define RECORD_DOTTED	4			/* dotted lines were shown */
+
+/* Number of fields of a record described in the header */
+#define RECORDFIELDS	14
+
+/*
+ * Type definitions
+ */
+
+/*
+ * One sample: a board with its shapes, where the shape was put, and what
+ * that earned. All fields are in the byte order of the machine that wrote
+ * them (see shardheader_t) and records are naturally aligned.
+ */
+typedef struct
+{
+   uint64_t board[PACKWORDS];		/* occupied cells when the shape came out (see board_pack ()) */
+   uint32_t game;					/* number of the game (chosen by whoever records it) */
+   uint32_t turn;					/* shapes placed in the game before this one */
+   int32_t score;					/* score when the shape came out */
+   int16_t reward;					/* score earned by placing it */
+   uint8_t lines;					/* lines it removed */
+   uint8_t flags;					/* RECORD_... */
+   uint8_t shape;					/* the shape */
+   uint8_t next;					/* the next shape */
+   uint8_t bag;						/* shapes left in the bag after the next one (bit s for shape s) */
+   uint8_t orient;					/* where it came to rest (see engine_t) */
+   int8_t x,y;
+   uint8_t level;					/* level the shape fell and scored at */
+   uint8_t unused;
+} record_t;
+
+/* A field of a record: name, offset, size of an element, number of elements, and type ('u' or 'i' for integers) */
+typedef struct
+{
+   char name[16];
+   uint32_t offset,size,count;
+   char type;
+   char unused[3];
+} recordfield_t;
+
+/* Records first to first + count - 1 of a shard come from one game, from the given turn on */
+typedef struct
+{
+   uint32_t game,turn;
+   uint64_t first,count;
+} shardrun_t;
+
+/*
+ * Start of a shard file, followed by the records from SHARDHEADER on and by
+ * the runs (the index) after them. Until a shard is closed, complete is 0
+ * and count and runs don't say anything.
+ */
+typedef struct
+{
+   char magic[8];					/* SHARDMAGIC (without the '\0') */
+   uint32_t version;				/* SHARDVERSION */
+   uint32_t byteorder;				/* 0x01020304 */
+   uint32_t headersize;				/* offset of the first record */
+   uint32_t recordsize;
+   uint32_t cols,rows;				/* cells of a packed board (see board_pack ()) */
+   uint32_t boardwords;
+   uint32_t complete;
+   uint64_t count;					/* number of records */
+   uint64_t index;					/* offset of the runs */
+   uint64_t runs;					/* number of runs */
+   uint32_t fields;					/* RECORDFIELDS */
+   uint32_t unused;
+   recordfield_t field[RECORDFIELDS];
+} shardheader_t;
+
+/* Records a game filled in, waiting for the writer */
+typedef struct exportblock_struct
+{
+   struct exportblock_struct *next;
+   int count;
+   record_t record[EXPORTBLOCK];
+} exportblock_t;
+
+/*
+ * Samples of games written to shard files by a thread of their own. A
+ * shard is called prefix-NNNNNN.shard and holds up to capacity records,
+ * after which the next one is started. Any number of games (in any number
+ * of threads) can record at once; each fills blocks of its own, which it
+ * hands to the writer, so the records of a game come in runs.
+ */
+typedef struct
+{
+   const char *prefix;
+   unsigned long capacity;			/* records per shard */
+   /* the writer */
+   pthread_t thread;
+   FILE *fp;						/* shard being written (NULL = none) */
+   unsigned int shards;				/* shards started */
+   uint64_t count;					/* records in the shard being written */
+   shardrun_t *runs;				/* ... and its index */
+   size_t numruns,maxruns;
+   unsigned long long written;		/* records written to all the shards */
+   /* blocks (guarded by lock) */
+   exportblock_t *queue,*last;		/* blocks for the writer, in the order they came */
+   exportblock_t *free;				/* blocks that can be filled */
+   int blocks;						/* blocks there are */
+   bool quit;						/* the writer should stop once the queue is empty */
+   bool failed;						/* a shard could not be written */
+   pthread_mutex_t lock;
+   pthread_cond_t wakeup;			/* there is something in the queue */
+   pthread_cond_t room;				/* a block was freed */
+} exporter_t;
+
+/* A game being recorded, hooked up to its engine */
+typedef struct
+{
+   exporter_t *exporter;
+   game_t *game;
+   uint32_t id;						/* number of the game */
+   uint32_t turn;					/* shapes placed before the falling one */
+   exportblock_t *block;			/* block being filled */
+   bool falling;					/* shape has the state the falling shape came out in */
+   record_t shape;
+} recorder_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Record of shard that is mapped (or read whole) at base, found by its offset
+ */
+static inline const record_t *shard_record (const void *base,uint64_t i)
+{
+   const shardheader_t *header = base;
+   return ((const record_t *) ((const char *) base + header->headersize + i * header->recordsize));
+}
+
+/*
+ * Start writing shards with the given prefix (see exporter_t), with up to
+ * capacity records each. Returns FALSE if there is no thread for it.
+ */
+bool export_open (exporter_t *exporter,const char *prefix,unsigned long capacity);
+
+/*
+ * Write what was recorded and stop. Every game has to be stopped first.
+ * Returns FALSE (and tells why on stderr) if a shard could not be written.
+ */
+bool export_close (exporter_t *exporter);
+
+/*
+ * Record every shape of the specified game from now on, as game number id.
+ * Returns FALSE if there is no room for a hook (see engine_hook ()).
+ */
+bool export_start (exporter_t *exporter,recorder_t *recorder,game_t *game,uint32_t id);
+
+/*
+ * Stop recording a game and hand what it recorded to the writer. A shape
+ * that hasn't come to rest yet isn't recorded.
+ */
+void export_stop (recorder_t *recorder);
+
+#endif	/* #ifndef EXPORT_H */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "game.h"
+
+/*
+ * Functions
+ */
+
+/* This function is responsible for increasing the score appropriately whenever
+ * a block collides at the bottom of the screen (or the top of the heap */
+static void score_function (engine_t *engine)
+{
+   game_t *game = (game_t *) engine;
+   int score = SCOREVAL (game->level * (engine->status.dropcount + 1));
+   score += SCOREVAL ((game->level + 10) * engine->status.currentdroppedlines * engine->status.currentdroppedlines);
+
+   if (game->shownext) score /= 2;
+   if (game->dottedlines) score /= 2;
+
+   engine->score += score;
+}
+
+/* Rows per tick (in 1 / GRAVITYUNIT) the shape falls at each level. Up to */
+/* level 9 that is the speed the game always had, then it gets faster */
+/* until the shape drops to the bottom at once */
+static const int GRAVITY[MAXLEVEL + 1] =
+{
+   0,
+   GRAVITYUNIT * 3 / TICKRATE,
+   GRAVITYUNIT * 4 / TICKRATE,
+   GRAVITYUNIT * 5 / TICKRATE,
+   GRAVITYUNIT * 6 / TICKRATE,
+   GRAVITYUNIT * 7 / TICKRATE,
+   GRAVITYUNIT * 8 / TICKRATE,
+   GRAVITYUNIT * 9 / TICKRATE,
+   GRAVITYUNIT * 10 / TICKRATE,
+   GRAVITYUNIT * 11 / TICKRATE,
+   GRAVITYUNIT / 4,
+   GRAVITYUNIT / 3,
+   GRAVITYUNIT / 2,
+   GRAVITYUNIT,
+   GRAVITYUNIT * 3 / 2,
+   GRAVITYUNIT * 2,
+   GRAVITYUNIT * 3,
+   GRAVITYUNIT * 5,
+   GRAVITYUNIT * 8,
+   GRAVITYUNIT * 12,
+   GRAVITYUNIT * NUMROWS
+};
+
+/* Move to the next level every ten lines */
+static void levelup (game_t *game)
+{
+   if ((game->level < MAXLEVEL) && ((game->engine.status.droppedlines / 10) > game->level))
+	 game_setlevel (game,game->level + 1);
+}
+
+/*
+ * Start a new game at the specified level. Games started with the same
+ * randomizer and seed get the same shapes.
+ */
+void game_init (game_t *game,int level,randomizer_t randomizer,unsigned int seed)
+{
+   engine_init (&game->engine,score_function,randomizer,seed);
+   game_setlevel (game,level);
+   game->shownext = game->dottedlines = FALSE;
+   game->newturn = TRUE;
+   game->turn = 0;
+   memset (game->shapecount,0,sizeof (game->shapecount));
+   game->shapecount[game->engine.curshape]++;
+}
+
+/*
+ * Change the level of the specified game. Returns FALSE if the level
+ * is out of range.
+ */
+bool game_setlevel (game_t *game,int level)
+{
+   if (level < MINLEVEL || level > MAXLEVEL) return FALSE;
+   game->level = level;
+   game->engine.gravity = GRAVITY[level];
+   return TRUE;
+}
+
+/*
+ * Perform the given action on the falling shape of the specified game
+ */
+void game_move (game_t *game,action_t action)
+{
+   engine_move (&game->engine,action);
+}
+
+/* Keep track of the shapes and the level after the engine moved on */
+static int settle (game_t *game,int result)
+{
+   switch (result)
+	 {
+		/* game over (board full) */
+	  case -1:
+		levelup (game);
+		break;
+		/* shape at bottom, next one released */
+	  case 0:
+		levelup (game);
+		game->shapecount[game->engine.curshape]++;
+		game->newturn = TRUE;
+		game->turn++;
+		break;
+	 }
+   return result;
+}
+
+/*
+ * Let the falling shape of the specified game move down a row
+ *
+ * OUTPUT:
+ *   1 = shape moved down one line
+ *   0 = shape at bottom, next one released
+ *  -1 = game over (board full)
+ */
+int game_step (game_t *game)
+{
+   return settle (game,engine_evaluate (&game->engine));
+}
+
+/*
+ * Advance the clock of the specified game by one tick (this should be
+ * called TICKRATE times per second). How far the shape falls depends on
+ * the level: from a row every 20 ticks at level 1 to the whole board in
+ * one tick at level 20.
+ *
+ * OUTPUT:
+ *   1 = shape still falling (or resting)
+ *   0 = shape locked, next one released
+ *  -1 = game over (board full)
+ */
+int game_tick (game_t *game)
+{
+   return settle (game,engine_tick (&game->engine));
+}
+
+/*
+ * Get the current state of the specified game
+ */
+void game_query (const game_t *game,gameinfo_t *info)
+{
+   int i;
+   info->level = game->level;
+   info->score = GETSCORE (game->engine.score);
+   info->lines = game->engine.status.droppedlines;
+   for (info->shapes = i = 0; i < NUMSHAPES; i++) info->shapes += game->shapecount[i];
+   info->efficiency = game->engine.status.efficiency;
+   info->curshape = game->engine.curshape;
+   info->nextshape = game->engine.nextshape;
+   info->curx = game->engine.curx;
+   info->cury = game->engine.cury;
+   info->curorient = game->engine.curorient;
+}
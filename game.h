@@ -0,0 +1,132 @@
+#ifndef GAME_H
+#define GAME_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t, action_t */
+
+/*
+ * Macros
+ */
+
+/* Number of levels in the game */
+#define MINLEVEL	1
+#define MAXLEVEL	20
+
+/* The score is multiplied by this to avoid losing precision */
+#define SCOREFACTOR 2
+
+/* This calculates the stored score value */
+#define SCOREVAL(x) (SCOREFACTOR * (x))
+
+/* This calculates the real (displayed) value of the score */
+#define GETSCORE(score) ((score) / SCOREFACTOR)
+
+/*
+ * Type definitions
+ */
+
+/*
+ * Everything that makes up one game. Games don't share any state, so
+ * any number of them can be played at the same time.
+ */
+typedef struct
+{
+   engine_t engine;					/* tetris engine (must be the first member) */
+   int level;						/* current level */
+   bool shownext;					/* next shape is shown (halves the score) */
+   bool dottedlines;				/* dotted lines are shown (halves the score) */
+   bool newturn;					/* a new shape was released */
+   int turn;						/* number of shapes that came to rest */
+   int shapecount[NUMSHAPES];		/* number of shapes released of each kind */
+} game_t;
+
+/* What a game looks like from the outside */
+typedef struct
+{
+   int level;
+   int score;						/* displayed score */
+   int lines;						/* number of lines removed */
+   int shapes;						/* number of shapes released */
+   int efficiency;
+   int curshape,nextshape;			/* current & next shapes */
+   int curx,cury,curorient;		/* position of current shape */
+} gameinfo_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Start a new game at the specified level. Games started with the same
+ * randomizer and seed get the same shapes.
+ */
+void game_init (game_t *game,int level,randomizer_t randomizer,unsigned int seed);
+
+/*
+ * Change the level of the specified game. Returns FALSE if the level
+ * is out of range.
+ */
+bool game_setlevel (game_t *game,int level);
+
+/*
+ * Perform the given action on the falling shape of the specified game
+ */
+void game_move (game_t *game,action_t action);
+
+/*
+ * Let the falling shape of the specified game move down a row
+ *
+ * OUTPUT:
+ *   1 = shape moved down one line
+ *   0 = shape at bottom, next one released
+ *  -1 = game over (board full)
+ */
+int game_step (game_t *game);
+
+/*
+ * Advance the clock of the specified game by one tick (this should be
+ * called TICKRATE times per second). How far the shape falls depends on
+ * the level: from a row every 20 ticks at level 1 to the whole board in
+ * one tick at level 20.
+ *
+ * OUTPUT:
+ *   1 = shape still falling (or resting)
+ *   0 = shape locked, next one released
+ *  -1 = game over (board full)
+ */
+int game_tick (game_t *game);
+
+/*
+ * Get the current state of the specified game
+ */
+void game_query (const game_t *game,gameinfo_t *info);
+
+#endif	/* #ifndef GAME_H */
@@ -0,0 +1,171 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "place.h"
+#include "bot.h"
+#include "beam.h"
+#include "hint.h"
+
+/*
+ * Macros
+ */
+
+/* A placement as published by the thread: shape, depth of the search and where to put it */
+#define PACK(generation,depth,orient,x,y) \
+	((uint64_t) (generation) << 32 | (uint64_t) (depth) << 24 | (orient) << 16 | (uint8_t) (x) << 8 | (uint8_t) (y))
+#define GENERATION(best) ((unsigned int) ((best) >> 32))
+#define DEPTH(best) ((int) ((best) >> 24 & 0xff))
+#define ORIENT(best) ((int) ((best) >> 16 & 0xff))
+#define X(best) ((int) (int8_t) ((best) >> 8))
+#define Y(best) ((int) (int8_t) (best))
+
+/*
+ * Functions
+ */
+
+/* Hand the current shape of the engine to the thread, and stop it looking at the last one */
+static void post (hint_t *hint)
+{
+   pthread_mutex_lock (&hint->lock);
+   hint->request = *hint->engine;
+   hint->posted++;
+   atomic_store (&hint->generation,hint->posted);
+   atomic_store (&hint->stop,TRUE);
+   pthread_cond_signal (&hint->wakeup);
+   pthread_mutex_unlock (&hint->lock);
+}
+
+/* Hook on the engine: a new shape was released */
+static void spawned (const event_t *event,void *arg)
+{
+   post (arg);
+}
+
+/* The thread: search deeper and deeper until the shape is gone */
+static void *think (void *arg)
+{
+   hint_t *hint = arg;
+   engine_t engine;
+   const placement_t *placement;
+   unsigned int generation;
+   int depth,best;
+   for (;;)
+	 {
+		pthread_mutex_lock (&hint->lock);
+		while (hint->taken == hint->posted && !atomic_load (&hint->quit))
+		  pthread_cond_wait (&hint->wakeup,&hint->lock);
+		engine = hint->request;
+		generation = hint->taken = hint->posted;
+		atomic_store (&hint->stop,atomic_load (&hint->quit));
+		pthread_mutex_unlock (&hint->lock);
+		if (atomic_load (&hint->quit)) break;
+		for (depth = 1; depth <= hint->depth; depth++)
+		  {
+			 hint->beam.depth = depth;
+			 best = beam_search (&hint->beam,&engine,&hint->places);
+			 /* an interrupted search only got as far as the last one */
+			 if (best < 0 || atomic_load (&hint->stop)) break;
+			 placement = &hint->places.placement[best];
+			 atomic_store (&hint->best,PACK (generation,depth,placement->orient,placement->x,placement->y));
+		  }
+	 }
+   return (NULL);
+}
+
+/*
+ * Start giving hints for the specified tetris engine, with beam searches
+ * of the given width up to the given depth. Returns FALSE if there is not
+ * enough memory, no thread, or no room for a hook (see engine_hook ()).
+ */
+bool hint_start (hint_t *hint,engine_t *engine,int width,int depth,const weights_t *weights)
+{
+   hint->engine = engine;
+   hint->depth = depth;
+   hint->posted = hint->taken = 0;
+   atomic_init (&hint->generation,0);
+   atomic_init (&hint->stop,FALSE);
+   atomic_init (&hint->quit,FALSE);
+   atomic_init (&hint->best,0);
+   /* one thread is enough to keep up with a player, and leaves the others alone */
+   if (!beam_init (&hint->beam,width,depth,1,0,weights,NULL)) return (FALSE);
+   hint->beam.stop = &hint->stop;
+   pthread_mutex_init (&hint->lock,NULL);
+   pthread_cond_init (&hint->wakeup,NULL);
+   if (engine_hook (engine,EVENT_BIT (EVENT_SPAWN),spawned,hint))
+	 {
+		if (!pthread_create (&hint->thread,NULL,think,hint))
+		  {
+			 /* the first shape was released before there was a hook */
+			 post (hint);
+			 return (TRUE);
+		  }
+		engine_unhook (engine,spawned,hint);
+	 }
+   pthread_cond_destroy (&hint->wakeup);
+   pthread_mutex_destroy (&hint->lock);
+   beam_free (&hint->beam);
+   return (FALSE);
+}
+
+/*
+ * Stop giving hints and release everything hint_start () set up
+ */
+void hint_stop (hint_t *hint)
+{
+   engine_unhook (hint->engine,spawned,hint);
+   pthread_mutex_lock (&hint->lock);
+   atomic_store (&hint->quit,TRUE);
+   atomic_store (&hint->stop,TRUE);
+   pthread_cond_signal (&hint->wakeup);
+   pthread_mutex_unlock (&hint->lock);
+   pthread_join (hint->thread,NULL);
+   pthread_cond_destroy (&hint->wakeup);
+   pthread_mutex_destroy (&hint->lock);
+   beam_free (&hint->beam);
+}
+
+/*
+ * Get the best placement found so far for the current shape, i.e. where
+ * it should come to rest. Never waits for the thread. Returns the depth
+ * of the search that found it, or 0 if there is nothing yet.
+ */
+int hint_get (const hint_t *hint,int *x,int *y,int *orient)
+{
+   uint64_t best = atomic_load (&hint->best);
+   if (!DEPTH (best) || GENERATION (best) != atomic_load (&hint->generation)) return (0);
+   *x = X (best);
+   *y = Y (best);
+   *orient = ORIENT (best);
+   return (DEPTH (best));
+}
@@ -0,0 +1,94 @@
+#ifndef HINT_H
+#define HINT_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+#include "place.h"			/* places_t */
+#include "bot.h"			/* weights_t */
+#include "beam.h"			/* beam_t */
+
+/*
+ * Type definitions
+ */
+
+/*
+ * Hints for a game that is being played: a thread of its own looks for
+ * the best placement of every shape the engine releases, with beam
+ * searches of depth 1, 2 and so on, and publishes each answer as soon as
+ * it has it. The thread is told about a new shape by a hook on the engine
+ * and drops whatever it was looking at; the player only takes a lock to
+ * hand it the board, which the thread holds as long as it takes to copy it.
+ */
+typedef struct
+{
+   engine_t *engine;				/* engine of the game */
+   int depth;						/* deepest search */
+   beam_t beam;
+   places_t places;
+   engine_t request;				/* shape to look at next (guarded by lock) */
+   unsigned int posted,taken;		/* shapes handed to the thread, and taken by it (guarded by lock) */
+   pthread_mutex_t lock;
+   pthread_cond_t wakeup;
+   pthread_t thread;
+   atomic_uint generation;			/* shapes released so far */
+   atomic_bool stop;				/* the shape the thread looks at is gone */
+   atomic_bool quit;				/* the thread should stop altogether */
+   atomic_ullong best;				/* best placement found for a shape (see hint_get ()) */
+} hint_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Start giving hints for the specified tetris engine, with beam searches
+ * of the given width up to the given depth. Returns FALSE if there is not
+ * enough memory, no thread, or no room for a hook (see engine_hook ()).
+ */
+bool hint_start (hint_t *hint,engine_t *engine,int width,int depth,const weights_t *weights);
+
+/*
+ * Stop giving hints and release everything hint_start () set up
+ */
+void hint_stop (hint_t *hint);
+
+/*
+ * Get the best placement found so far for the current shape, i.e. where
+ * it should come to rest. Never waits for the thread. Returns the depth
+ * of the search that found it, or 0 if there is nothing yet.
+ */
+int hint_get (const hint_t *hint,int *x,int *y,int *orient);
+
+#endif	/* #ifndef HINT_H */
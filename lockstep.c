@@ -0,0 +1,283 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "game.h"
+#include "lockstep.h"
+
+/*
+ * Macros
+ */
+
+/* Every array starts on a cache line of its own */
+#define ALIGNMENT 64
+
+/* Board and falling shape of game k */
+#define ROWS(games,k) ((games)->rows + (k) * NUMROWS)
+#define HEIGHT(games,k) ((games)->height + (k) * NUMCOLS)
+#define FILL(games,k) ((games)->fill + (k) * NUMROWS)
+#define ROTATION(games,k) (&SHAPES[(games)->curshape[k]].rotation[(games)->curorient[k]])
+
+/*
+ * Functions
+ */
+
+/* Take the next size bytes from the memory block (or just count them if it is NULL) */
+static void *carve (char **memory,size_t *used,size_t size)
+{
+   void *p = *memory != NULL ? *memory + *used : NULL;
+   *used += (size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+   return (p);
+}
+
+/* Lay out all of the arrays in the memory block. Returns the size of the block */
+static size_t layout (lockstep_t *games,char *memory)
+{
+   size_t used = 0,n = games->count;
+   games->rows = carve (&memory,&used,n * NUMROWS * sizeof (row_t));
+   games->height = carve (&memory,&used,n * NUMCOLS);
+   games->fill = carve (&memory,&used,n * NUMROWS);
+   games->holes = carve (&memory,&used,n * sizeof (int));
+   games->curx = carve (&memory,&used,n * sizeof (int));
+   games->cury = carve (&memory,&used,n * sizeof (int));
+   games->curshape = carve (&memory,&used,n * sizeof (int));
+   games->nextshape = carve (&memory,&used,n * sizeof (int));
+   games->curorient = carve (&memory,&used,n * sizeof (int));
+   games->bag = carve (&memory,&used,n * NUMSHAPES * sizeof (int));
+   games->bag_iterator = carve (&memory,&used,n * sizeof (int));
+   games->randomizer = carve (&memory,&used,n);
+   games->rng = carve (&memory,&used,n * sizeof (unsigned int));
+   games->level = carve (&memory,&used,n * sizeof (int));
+   games->score = carve (&memory,&used,n * sizeof (int));
+   games->shapes = carve (&memory,&used,n * sizeof (int));
+   games->over = carve (&memory,&used,n * sizeof (bool));
+   games->moves = carve (&memory,&used,n * sizeof (int));
+   games->rotations = carve (&memory,&used,n * sizeof (int));
+   games->dropcount = carve (&memory,&used,n * sizeof (int));
+   games->efficiency = carve (&memory,&used,n * sizeof (int));
+   games->droppedlines = carve (&memory,&used,n * sizeof (int));
+   games->currentdroppedlines = carve (&memory,&used,n * sizeof (int));
+   return (used);
+}
+
+/*
+ * Allocate the specified number of games. They have to be started with
+ * lockstep_reset () before they can be played. Returns FALSE if there is
+ * not enough memory.
+ */
+bool lockstep_init (lockstep_t *games,int count)
+{
+   size_t size;
+   int k;
+   games->count = count;
+   size = layout (games,NULL);
+   if ((games->memory = aligned_alloc (ALIGNMENT,size)) == NULL) return (FALSE);
+   layout (games,games->memory);
+   /* until they are started, the games count as over */
+   for (k = 0; k < count; k++) games->over[k] = TRUE;
+   return (TRUE);
+}
+
+/*
+ * Release the memory of the games
+ */
+void lockstep_free (lockstep_t *games)
+{
+   free (games->memory);
+   games->memory = NULL;
+   games->count = 0;
+}
+
+/*
+ * Start game k over at the specified level. It gets the same shapes as a
+ * game started with game_init () and the same randomizer and seed.
+ */
+void lockstep_reset (lockstep_t *games,int k,int level,randomizer_t randomizer,unsigned int seed)
+{
+   int *bag = games->bag + k * NUMSHAPES;
+   int i;
+   board_clear (ROWS (games,k));
+   board_surface (ROWS (games,k),HEIGHT (games,k),FILL (games,k),&games->holes[k]);
+   games->randomizer[k] = randomizer;
+   games->rng[k] = bag_seed (seed);
+   for (i = 0; i < NUMSHAPES; i++) bag[i] = i;
+   bag_fill (randomizer,&games->rng[k],0,bag);
+   games->bag_iterator[k] = 0;
+   bag_next (randomizer,bag,&games->bag_iterator[k],&games->rng[k],&games->curshape[k],&games->nextshape[k]);
+   games->curx[k] = SPAWNX;
+   games->cury[k] = SPAWNY;
+   games->curorient[k] = 0;
+   games->level[k] = level;
+   games->score[k] = 0;
+   games->shapes[k] = 1;
+   games->over[k] = FALSE;
+   games->moves[k] = games->rotations[k] = games->dropcount[k] = 0;
+   games->efficiency[k] = games->droppedlines[k] = games->currentdroppedlines[k] = 0;
+}
+
+/* Where each action (except drop) tries to move the shape */
+static const struct
+{
+   int dx,dy,rotate;
+} MOVES[] =
+{
+   { -1, 0, 0 },				/* left */
+   { 0, 0, 1 },					/* rotate */
+   { 1, 0, 0 },					/* right */
+   { 0, 0, 0 },					/* drop */
+   { 0, 1, 0 }					/* down */
+};
+
+/*
+ * Perform the action on the falling shape of game k (see engine_move ()).
+ * Apart from drop, every action is a single test of the shape somewhere
+ * else, which saves a jump that can't be predicted when the games all do
+ * different things.
+ */
+static void move (lockstep_t *games,int k,action_t action)
+{
+   const row_t *rows = ROWS (games,k);
+   const rotation_t *rot = ROTATION (games,k);
+   int x = games->curx[k],y = games->cury[k],orient = games->curorient[k];
+   if (action == ACTION_DROP)
+	 {
+		games->cury[k] = board_floor (rows,HEIGHT (games,k),rot,x,y);
+		games->dropcount[k] += games->cury[k] - y;
+		return;
+	 }
+   x += MOVES[action].dx;
+   y += MOVES[action].dy;
+   if (MOVES[action].rotate) orient = rot->next;
+   if (board_allowed (rows,&SHAPES[games->curshape[k]].rotation[orient],x,y))
+	 {
+		games->curx[k] = x;
+		games->cury[k] = y;
+		games->curorient[k] = orient;
+		games->rotations[k] += MOVES[action].rotate;
+		games->moves[k] += !MOVES[action].rotate;
+	 }
+}
+
+/* Lock the shape of game k where it came to rest and release the next one (see engine_evaluate ()) */
+static int land (lockstep_t *games,int k)
+{
+   const rotation_t *rot = ROTATION (games,k);
+   int y = games->cury[k],lines,rotations,result;
+   lines = board_place (ROWS (games,k),HEIGHT (games,k),FILL (games,k),&games->holes[k],rot,games->curx[k],y);
+   games->droppedlines[k] += lines;
+   games->currentdroppedlines[k] = lines;
+   /* same as the score function of the game */
+   games->score[k] += SCOREVAL (games->level[k] * (games->dropcount[k] + 1)) + SCOREVAL ((games->level[k] + 10) * lines * lines);
+   rotations = 4 - games->rotations[k];
+   if (rotations > 0) rotations = 0;
+   games->efficiency[k] = (games->efficiency[k] + games->dropcount[k] + rotations + (abs (games->curx[k] - SPAWNX) - games->moves[k])) >> 1;
+   games->dropcount[k] = games->rotations[k] = games->moves[k] = 0;
+   /* release the next shape */
+   games->curx[k] = SPAWNX;
+   games->cury[k] = SPAWNY;
+   games->curorient[k] = 0;
+   bag_next (games->randomizer[k],games->bag + k * NUMSHAPES,&games->bag_iterator[k],&games->rng[k],&games->curshape[k],&games->nextshape[k]);
+   result = board_allowed (ROWS (games,k),ROTATION (games,k),SPAWNX,SPAWNY) ? 0 : -1;
+   /* move to the next level every ten lines */
+   if (games->level[k] < MAXLEVEL && games->droppedlines[k] / 10 > games->level[k]) games->level[k]++;
+   if (result < 0)
+	 games->over[k] = TRUE;
+   else
+	 games->shapes[k]++;
+   return (result);
+}
+
+/*
+ * Perform actions[k] on the falling shape of every game k and let all of
+ * the shapes fall a row, i.e. game_move () followed by game_step (). The
+ * outcome of game_step () is stored in results[k]. Games that are over are
+ * left alone and report -1.
+ */
+void lockstep_step (lockstep_t *games,const action_t *actions,int *results)
+{
+   lockstep_steprange (games,0,games->count,actions,results);
+}
+
+/*
+ * Same as lockstep_step () for games first to last - 1 only, so that
+ * different threads can step different games at the same time
+ */
+void lockstep_steprange (lockstep_t *games,int first,int last,const action_t *actions,int *results)
+{
+   int k;
+   /* the actions differ from game to game, so they are done one at a time */
+   for (k = first; k < last; k++)
+	 if (!games->over[k]) move (games,k,actions[k]);
+   /* find the shapes that can still fall... */
+   for (k = first; k < last; k++)
+	 results[k] = games->over[k] ? -1 : board_allowed (ROWS (games,k),ROTATION (games,k),games->curx[k],games->cury[k] + 1);
+   /* ...let them fall without branching, so the compiler can vectorize it... */
+   for (k = first; k < last; k++)
+	 games->cury[k] += results[k] > 0;
+   /* ...and lock the others, which only happens every few steps */
+   for (k = first; k < last; k++)
+	 if (!results[k]) results[k] = land (games,k);
+}
+
+/*
+ * Get the current state of game k
+ */
+void lockstep_query (const lockstep_t *games,int k,gameinfo_t *info)
+{
+   info->level = games->level[k];
+   info->score = GETSCORE (games->score[k]);
+   info->lines = games->droppedlines[k];
+   info->shapes = games->shapes[k];
+   info->efficiency = games->efficiency[k];
+   info->curshape = games->curshape[k];
+   info->nextshape = games->nextshape[k];
+   info->curx = games->curx[k];
+   info->cury = games->cury[k];
+   info->curorient = games->curorient[k];
+}
+
+/*
+ * Get the shapes that are left in the bag of game k after the next shape
+ * (see engine_bag ())
+ */
+unsigned int lockstep_bag (const lockstep_t *games,int k)
+{
+   const int *bag = games->bag + k * NUMSHAPES;
+   unsigned int left = 0;
+   int i;
+   if (games->randomizer[k] != RANDOMIZER_UNIFORM)
+	 for (i = games->bag_iterator[k] % NUMSHAPES + 1; i < NUMSHAPES; i++)
+	   left |= 1U << bag[i];
+   return (left);
+}
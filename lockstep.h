@@ -0,0 +1,122 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* row_t, action_t */
+#include "game.h"			/* gameinfo_t */
+
+/*
+ * Type definitions
+ */
+
+/*
+ * Many games that take one step at a time together. Every field of the
+ * games is kept in its own array (indexed by game), so a step runs through
+ * each array in turn instead of hopping from one game to the next. The
+ * games play exactly like games started with game_init () without shadow,
+ * next shape and dotted lines, but there are no colors.
+ */
+typedef struct
+{
+   int count;						/* number of games */
+   /* boards, NUMROWS rows, NUMCOLS heights and NUMROWS fill counts per game */
+   row_t *rows;
+   unsigned char *height;
+   unsigned char *fill;
+   int *holes;
+   /* falling shape */
+   int *curx,*cury;
+   int *curshape,*nextshape;
+   int *curorient;
+   /* shape sequence, NUMSHAPES bag entries per game */
+   int *bag;
+   int *bag_iterator;
+   unsigned char *randomizer;
+   unsigned int *rng;
+   /* progress */
+   int *level;
+   int *score;
+   int *shapes;					/* number of shapes released */
+   bool *over;						/* the board is full */
+   /* engine status (see status_t) */
+   int *moves,*rotations,*dropcount,*efficiency,*droppedlines,*currentdroppedlines;
+   void *memory;
+} lockstep_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Allocate the specified number of games. They have to be started with
+ * lockstep_reset () before they can be played. Returns FALSE if there is
+ * not enough memory.
+ */
+bool lockstep_init (lockstep_t *games,int count);
+
+/*
+ * Release the memory of the games
+ */
+void lockstep_free (lockstep_t *games);
+
+/*
+ * Start game k over at the specified level. It gets the same shapes as a
+ * game started with game_init () and the same randomizer and seed.
+ */
+void lockstep_reset (lockstep_t *games,int k,int level,randomizer_t randomizer,unsigned int seed);
+
+/*
+ * Perform actions[k] on the falling shape of every game k and let all of
+ * the shapes fall a row, i.e. game_move () followed by game_step (). The
+ * outcome of game_step () is stored in results[k]. Games that are over are
+ * left alone and report -1.
+ */
+void lockstep_step (lockstep_t *games,const action_t *actions,int *results);
+
+/*
+ * Same as lockstep_step () for games first to last - 1 only, so that
+ * different threads can step different games at the same time
+ */
+void lockstep_steprange (lockstep_t *games,int first,int last,const action_t *actions,int *results);
+
+/*
+ * Get the current state of game k
+ */
+void lockstep_query (const lockstep_t *games,int k,gameinfo_t *info);
+
+/*
+ * Get the shapes that are left in the bag of game k after the next shape
+ * (see engine_bag ())
+ */
+unsigned int lockstep_bag (const lockstep_t *games,int k);
+
+#endif	/* #ifndef LOCKSTEP_H */
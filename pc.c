@@ -0,0 +1,404 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "board.h"
+#include "place.h"
+#include "pool.h"
+#include "pc.h"
+
+/*
+ * Macros
+ */
+
+/* Columns inside the walls */
+#define INSIDE	((row_t) (FULLROW & ~WALLROW))
+
+/* Tag of a memo entry: the call of pc_solve () it was found hopeless in, */
+/* the shape the board is waiting for, and the rows left to clear */
+#define TAG(generation,index,rows)	((((unsigned int) (generation) << 15) | (unsigned int) (index) << 8 | (rows)) + 1)
+#define GENERATION(tag)				(((tag) - 1) >> 15)
+#define GENERATIONS					(1U << 17)
+#define BUSY						UINT_MAX
+
+/* Entries a board may be in, from the one its hash points at */
+#define PROBES	32
+
+/* Shapes that are placed before the board is split up among the threads */
+#define SPLIT	2
+
+/*
+ * Type definitions
+ */
+
+/* A board the threads start from, after the first shapes are placed */
+typedef struct
+{
+   boardnode_t node;
+   int rows;						/* rows left to clear */
+   placement_t path[SPLIT];			/* how it got there */
+} start_t;
+
+/* One number of lines to clear */
+typedef struct
+{
+   pcsolver_t *solver;
+   const int *shapes;
+   int count;						/* shapes it takes */
+   int split;						/* shapes placed before the threads start */
+   start_t *start;
+   int jobs,room;					/* boards the threads start from, and room for them */
+   placement_t *solution;			/* count placements per job */
+   atomic_int found;				/* lowest job that found a perfect clear (jobs = none yet) */
+} search_t;
+
+/* Where the search of a thread stands */
+typedef struct
+{
+   search_t *search;
+   int job;							/* board it started from */
+   places_t *places;				/* placements of each shape */
+   placement_t *solution;
+   unsigned long long nodes,pruned,hits,stored,lost;
+} task_t;
+
+/* How a search ended */
+enum { FAILED, SOLVED, STOPPED };
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a solver with a memo of about the given size (in bytes) and the
+ * given number of threads. Returns FALSE if there is not enough memory.
+ */
+bool pc_init (pcsolver_t *solver,size_t bytes,int threads)
+{
+   unsigned long i,n = 1;
+   while (n * 2 * sizeof (pcentry_t) <= bytes) n *= 2;
+   solver->threads = threads;
+   solver->mask = n - 1;
+   if ((solver->memo = malloc (n * sizeof (pcentry_t))) == NULL) return (FALSE);
+   for (i = 0; i < n; i++) atomic_init (&solver->memo[i].tag,0);
+   solver->generation = 0;
+   atomic_init (&solver->nodes,0);
+   atomic_init (&solver->pruned,0);
+   atomic_init (&solver->hits,0);
+   atomic_init (&solver->stored,0);
+   atomic_init (&solver->lost,0);
+   return (TRUE);
+}
+
+/*
+ * Release the memory of a solver
+ */
+void pc_free (pcsolver_t *solver)
+{
+   free (solver->memo);
+   solver->memo = NULL;
+}
+
+/* Put a shape on a board. Returns the number of lines removed */
+static int place (const boardnode_t *node,boardnode_t *child,int shape,const placement_t *placement)
+{
+   return (board_child (node,child,&SHAPES[shape].rotation[placement->orient],placement->x,placement->y));
+}
+
+/* Check if a placement stays in the bottom rows */
+static bool inside (int shape,const placement_t *placement,int rows)
+{
+   return (placement->y + SHAPES[shape].rotation[placement->orient].miny >= NUMROWS - 2 - rows);
+}
+
+/*
+ * Check if the empty cells in the bottom rows could be filled with whole
+ * shapes. A shape can't get past a column that is full up to the top of
+ * those rows, and a line that is cleared takes a full cell out of every
+ * column, so the empty cells between two full columns have to come in
+ * fours on their own.
+ */
+static bool possible (const boardnode_t *node,int rows)
+{
+   int x,y,column,empty = 0;
+   for (x = 1; x <= PLAYCOLS; x++)
+	 {
+		for (column = 0, y = NUMROWS - 2 - rows; y < NUMROWS - 2; y++)
+		  column += !(node->rows[y] & BIT (x));
+		if (!column && empty % 4) return (FALSE);
+		empty = column ? empty + column : 0;
+	 }
+   return (empty % 4 == 0);
+}
+
+/* Pack the bottom rows of a board, without the walls */
+static void pack (const boardnode_t *node,int rows,uint64_t *key)
+{
+   int r;
+   for (r = 0; r < PCWORDS; r++) key[r] = 0;
+   for (r = 0; r < rows; r++)
+	 key[r / PCROWSPERWORD] |= (uint64_t) ((node->rows[NUMROWS - 3 - r] & INSIDE) >> 1) << (r % PCROWSPERWORD * PLAYCOLS);
+}
+
+/* Entry of the memo a key starts looking at (the splitmix64 finalizer of the words) */
+static unsigned long slot (const pcsolver_t *solver,const uint64_t *key,unsigned int tag)
+{
+   uint64_t h = tag;
+   int i;
+   for (i = 0; i < PCWORDS; i++)
+	 {
+		h = (h ^ key[i]) + 0x9e3779b97f4a7c15ULL;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+	 }
+   return (h & solver->mask);
+}
+
+/* Check if an entry holds a key. Its words never change once the tag is set */
+static bool holds (pcentry_t *entry,const uint64_t *key)
+{
+   int i;
+   for (i = 0; i < PCWORDS; i++)
+	 if (atomic_load_explicit (&entry->word[i],memory_order_relaxed) != key[i]) return (FALSE);
+   return (TRUE);
+}
+
+/* Check if the memo has a board */
+static bool recall (const pcsolver_t *solver,const uint64_t *key,unsigned int tag)
+{
+   unsigned long i,s = slot (solver,key,tag);
+   unsigned int t;
+   for (i = 0; i < PROBES; i++)
+	 {
+		pcentry_t *entry = &solver->memo[(s + i) & solver->mask];
+		t = atomic_load_explicit (&entry->tag,memory_order_acquire);
+		if (!t) return (FALSE);
+		if (t == tag && holds (entry,key)) return (TRUE);
+	 }
+   return (FALSE);
+}
+
+/* Put a board in the memo, over one of an earlier call if need be. Returns FALSE if there was no room for it */
+static bool memorize (pcsolver_t *solver,const uint64_t *key,unsigned int tag)
+{
+   unsigned long i,s = slot (solver,key,tag);
+   unsigned int t;
+   int w;
+   for (i = 0; i < PROBES; i++)
+	 {
+		pcentry_t *entry = &solver->memo[(s + i) & solver->mask];
+		t = atomic_load_explicit (&entry->tag,memory_order_acquire);
+		/* claim an empty (or stale) entry, then fill it in and tell the readers */
+		if ((!t || (t != BUSY && GENERATION (t) != solver->generation)) && atomic_compare_exchange_strong (&entry->tag,&t,BUSY))
+		  {
+			 for (w = 0; w < PCWORDS; w++) atomic_store_explicit (&entry->word[w],key[w],memory_order_relaxed);
+			 atomic_store_explicit (&entry->tag,tag,memory_order_release);
+			 return (TRUE);
+		  }
+		if (t == tag && holds (entry,key)) return (TRUE);
+	 }
+   return (FALSE);
+}
+
+/*
+ * Place the index'th shape and the ones after it so that the bottom rows
+ * are cleared. Returns SOLVED (with the placements in task->solution),
+ * FAILED, or STOPPED if a job before this one found a perfect clear.
+ */
+static int clear (task_t *task,const boardnode_t *node,int index,int rows)
+{
+   search_t *search = task->search;
+   places_t *places = &task->places[index];
+   int shape,i,result;
+   unsigned int tag = TAG (search->solver->generation,index,rows);
+   uint64_t key[PCWORDS];
+   boardnode_t child;
+   /* the cells add up, so the last shape clears the last line */
+   if (!rows) return (SOLVED);
+   if (atomic_load_explicit (&search->found,memory_order_relaxed) < task->job) return (STOPPED);
+   task->nodes++;
+   if (!possible (node,rows))
+	 {
+		task->pruned++;
+		return (FAILED);
+	 }
+   pack (node,rows,key);
+   if (recall (search->solver,key,tag))
+	 {
+		task->hits++;
+		return (FAILED);
+	 }
+   shape = search->shapes[index];
+   place_find (places,node->rows,shape,0,SPAWNX,SPAWNY);
+   for (i = 0; i < places->count; i++)
+	 if (inside (shape,&places->placement[i],rows))
+	   {
+		  result = clear (task,&child,index + 1,rows - place (node,&child,shape,&places->placement[i]));
+		  if (result == SOLVED) task->solution[index] = places->placement[i];
+		  if (result != FAILED) return (result);
+	   }
+   /* only a board that was searched all the way is hopeless */
+   if (memorize (search->solver,key,tag))
+	 task->stored++;
+   else
+	 task->lost++;
+   return (FAILED);
+}
+
+/* Place the first shapes and keep the boards the threads start from. Returns FALSE if there is not enough memory */
+static bool split (search_t *search,places_t *places,const boardnode_t *node,int index,int rows,placement_t *path)
+{
+   boardnode_t child;
+   int shape,i;
+   if (index == search->split)
+	 {
+		if (search->jobs == search->room)
+		  {
+			 start_t *start = realloc (search->start,(search->room * 2 + 16) * sizeof (start_t));
+			 if (start == NULL) return (FALSE);
+			 search->start = start;
+			 search->room = search->room * 2 + 16;
+		  }
+		search->start[search->jobs].node = *node;
+		search->start[search->jobs].rows = rows;
+		memcpy (search->start[search->jobs].path,path,index * sizeof (placement_t));
+		search->jobs++;
+		return (TRUE);
+	 }
+   if (!rows || !possible (node,rows)) return (TRUE);
+   shape = search->shapes[index];
+   place_find (&places[index],node->rows,shape,0,SPAWNX,SPAWNY);
+   for (i = 0; i < places[index].count; i++)
+	 if (inside (shape,&places[index].placement[i],rows))
+	   {
+		  int lines = place (node,&child,shape,&places[index].placement[i]);
+		  path[index] = places[index].placement[i];
+		  if (!split (search,places,&child,index + 1,rows - lines,path)) return (FALSE);
+	   }
+   return (TRUE);
+}
+
+/* Job of the pool: search on from the index'th board the threads start from */
+static void solve (void *arg,unsigned long index)
+{
+   search_t *search = arg;
+   pcsolver_t *solver = search->solver;
+   task_t task;
+   task.search = search;
+   task.job = index;
+   task.solution = search->solution + index * search->count;
+   task.nodes = task.pruned = task.hits = task.stored = task.lost = 0;
+   if (atomic_load (&search->found) < (int) index) return;
+   if ((task.places = malloc (search->count * sizeof (places_t))) == NULL) abort ();
+   if (clear (&task,&search->start[index].node,search->split,search->start[index].rows) == SOLVED)
+	 {
+		int found = atomic_load (&search->found);
+		memcpy (task.solution,search->start[index].path,search->split * sizeof (placement_t));
+		while ((int) index < found && !atomic_compare_exchange_weak (&search->found,&found,index)) ;
+	 }
+   free (task.places);
+   atomic_fetch_add (&solver->nodes,task.nodes);
+   atomic_fetch_add (&solver->pruned,task.pruned);
+   atomic_fetch_add (&solver->hits,task.hits);
+   atomic_fetch_add (&solver->stored,task.stored);
+   atomic_fetch_add (&solver->lost,task.lost);
+}
+
+/*
+ * Find placements for the first shapes of the given sequence, in that
+ * order and each reachable from where it is released, that leave the
+ * board (rows as the engine keeps them) empty. The fewest lines are tried
+ * first, and the first perfect clear in the order place_find () lists the
+ * placements is returned, whatever the number of threads. Returns the
+ * number of shapes in solution, -1 if there is no perfect clear that
+ * clears at most PCMAXROWS lines, or -2 if there is not enough memory.
+ */
+int pc_solve (pcsolver_t *solver,const row_t *rows,const int *shapes,int count,placement_t *solution)
+{
+   search_t search;
+   boardnode_t root;
+   places_t *places;
+   placement_t path[SPLIT];
+   int y,lines,top = 0,filled = 0,result = -1;
+   bool ok = TRUE;
+   if (count > PCMAXSHAPES) count = PCMAXSHAPES;
+   memcpy (root.rows,rows,sizeof (root.rows));
+   board_surface (root.rows,root.height,root.fill,&root.holes);
+   for (y = 0; y < NUMROWS - 2; y++)
+	 if (root.fill[y])
+	   {
+		  filled += root.fill[y];
+		  if (!top) top = NUMROWS - 2 - y;
+	   }
+   if ((places = malloc (SPLIT * sizeof (places_t))) == NULL) return (-2);
+   /* a board is only hopeless for the shapes that come after it, so the */
+   /* boards of earlier calls are left behind, and emptied once the tags run out */
+   if (++solver->generation == GENERATIONS)
+	 {
+		unsigned long i;
+		for (i = 0; i <= solver->mask; i++) atomic_store (&solver->memo[i].tag,0);
+		solver->generation = 1;
+	 }
+   search.solver = solver;
+   search.shapes = shapes;
+   search.start = NULL;
+   search.room = 0;
+   /* every shape fills four cells, and the lines take all the cells of their rows */
+   for (lines = top ? top : 1; lines <= PCMAXROWS && lines * PLAYCOLS <= filled + 4 * count && result < 0; lines++)
+	 {
+		if ((lines * PLAYCOLS - filled) % 4 || lines * PLAYCOLS == filled) continue;
+		search.count = (lines * PLAYCOLS - filled) / 4;
+		search.split = search.count < SPLIT ? search.count : SPLIT;
+		search.jobs = 0;
+		if (!split (&search,places,&root,0,lines,path) ||
+			(search.solution = malloc ((size_t) search.jobs * search.count * sizeof (placement_t) + 1)) == NULL)
+		  {
+			 ok = FALSE;
+			 break;
+		  }
+		atomic_init (&search.found,search.jobs);
+		pool_run (solver->threads,search.jobs,solve,&search);
+		if (atomic_load (&search.found) < search.jobs)
+		  {
+			 result = search.count;
+			 memcpy (solution,search.solution + atomic_load (&search.found) * search.count,result * sizeof (placement_t));
+		  }
+		free (search.solution);
+	 }
+   free (search.start);
+   free (places);
+   return (ok ? result : -2);
+}
@@ -0,0 +1,110 @@
+#ifndef PC_H
+#define PC_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* row_t, PLAYCOLS */
+#include "place.h"			/* placement_t */
+
+/*
+ * Macros
+ */
+
+/* Words a board is packed into for the memo, and the rows that fit in them */
+#define PCWORDS			2
+#define PCROWSPERWORD	(64 / PLAYCOLS)
+#define PCMAXROWS		(PCWORDS * PCROWSPERWORD)
+
+/* Most shapes a perfect clear may take */
+#define PCMAXSHAPES		64
+
+/*
+ * Type definitions
+ */
+
+/* A board the search has been through without finding a perfect clear */
+typedef struct
+{
+   atomic_uint tag;					/* 0 = empty, else which call, shape and how many rows (see pc.c) */
+   atomic_ullong word[PCWORDS];		/* the rows that are left to clear, packed */
+} pcentry_t;
+
+/*
+ * A perfect clear solver. The boards it proved hopeless are kept in a
+ * fixed-size hash set shared by its threads without locks. A board is
+ * only hopeless for the shapes of the sequence that come after it, so it
+ * is only ever found by its exact packed rows within the same call of
+ * pc_solve (); the entries of earlier calls are taken over as they are
+ * needed. The set can't be wrong, but it forgets boards once it is full.
+ */
+typedef struct
+{
+   int threads;
+   pcentry_t *memo;
+   unsigned long mask;				/* number of entries - 1 */
+   unsigned int generation;			/* calls of pc_solve () since the memo was last emptied */
+   atomic_ullong nodes;				/* boards searched */
+   atomic_ullong pruned;			/* ... that couldn't be cleared by counting cells */
+   atomic_ullong hits;				/* ... that were in the memo */
+   atomic_ullong stored,lost;		/* boards put in the memo, or not because it was full */
+} pcsolver_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a solver with a memo of about the given size (in bytes) and the
+ * given number of threads. Returns FALSE if there is not enough memory.
+ */
+bool pc_init (pcsolver_t *solver,size_t bytes,int threads);
+
+/*
+ * Release the memory of a solver
+ */
+void pc_free (pcsolver_t *solver);
+
+/*
+ * Find placements for the first shapes of the given sequence, in that
+ * order and each reachable from where it is released, that leave the
+ * board (rows as the engine keeps them) empty. The fewest lines are tried
+ * first, and the first perfect clear in the order place_find () lists the
+ * placements is returned, whatever the number of threads. Returns the
+ * number of shapes in solution, -1 if there is no perfect clear that
+ * clears at most PCMAXROWS lines, or -2 if there is not enough memory.
+ */
+int pc_solve (pcsolver_t *solver,const row_t *rows,const int *shapes,int count,placement_t *solution);
+
+#endif	/* #ifndef PC_H */
@@ -0,0 +1,226 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "place.h"
+
+/*
+ * The search works on whole rows at a time: fits[o][y] has bit x set if
+ * the shape fits in orientation o at (x,y), and reach[o][y] if it can get
+ * there. Rows are done from the top down, since nothing moves up. A row
+ * gets what falls into it from the row above, and then what can be got to
+ * from that by moving left, right and rotating, until nothing changes.
+ * Resting positions are those that can't fall any further. Only the path
+ * to the one placement a caller asks for is searched for position by
+ * position (breadth first, so it is the shortest).
+ */
+
+/* Columns a shape can be in (the walls catch the rest) */
+#define INSIDE	((row_t) (FULLROW & ~BIT (0) & ~BIT (NUMCOLS - 1)))
+
+/* Number of a position in the path search */
+#define STATE(orient,x,y)	(((orient) * NUMROWS + (y)) * NUMCOLS + (x))
+
+/*
+ * Functions
+ */
+
+/* Columns where an orientation fits in row y */
+static inline row_t fits (const row_t *rows,const rotation_t *rot,int y)
+{
+   row_t hit = 0,row;
+   int i,bx;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		row = rows[y + rot->block[i].y];
+		bx = rot->block[i].x;
+		hit |= bx >= 0 ? row >> bx : (row_t) (row << -bx);
+	 }
+   return ((row_t) ~hit & INSIDE);
+}
+
+/* Find the columns each orientation of a shape fits in, in row y */
+static inline void fitrow (places_t *places,const row_t *rows,const shape_t *s,int y)
+{
+   int o;
+   for (o = 0; o < s->orients; o++)
+	 /* further down the shape would be in the floor */
+	 places->fits[o][y] = y <= NUMROWS - 3 - s->rotation[o].maxy ? fits (rows,&s->rotation[o],y) : 0;
+}
+
+/* Add all the columns of f that can be got to from r by moving left and right */
+static inline row_t spread (row_t r,row_t f)
+{
+   row_t down = r,p = f;
+   int s;
+   /* to the right, adding r carries through the runs of f it is in */
+   row_t up = (row_t) ((f ^ (row_t) (f + r)) & f) | r;
+   /* to the left, in ever bigger steps */
+   for (s = 1; s < NUMCOLS; s <<= 1)
+	 {
+		down |= p & (down >> s);
+		p &= p >> s;
+	 }
+   return (up | down);
+}
+
+/*
+ * Find every position in which the given shape can come to rest on the
+ * board, starting from the given orientation and position. A shape gets
+ * there by any sequence of left, right, rotate and down actions (so it can
+ * be tucked under overhangs), optionally followed by a drop. Every position
+ * is only listed once. Returns the number of placements.
+ */
+int place_find (places_t *places,const row_t *rows,int shape,int orient,int x,int y)
+{
+   const shape_t *s = &SHAPES[shape];
+   int o,n,yy,bottom = y;
+   bool changed,full;
+   row_t r,rest;
+   places->shape = shape;
+   places->orient = orient;
+   places->x = x;
+   places->y = y;
+   places->count = 0;
+   fitrow (places,rows,s,y);
+   if (!(places->fits[orient][y] & BIT (x))) return (0);
+   for (yy = y; yy < NUMROWS; yy++)
+	 {
+		fitrow (places,rows,s,yy + 1);
+		/* whatever falls in from the row above */
+		for (r = 0, full = TRUE, o = 0; o < s->orients; o++)
+		  {
+			 places->reach[o][yy] = yy == y ? (o == orient ? BIT (x) : 0) : places->reach[o][yy - 1] & places->fits[o][yy];
+			 r |= places->reach[o][yy];
+			 full &= places->reach[o][yy] == places->fits[o][yy];
+		  }
+		if (!r) break;
+		bottom = yy;
+		/* above the stack the shape already gets everywhere */
+		if (full) continue;
+		/* moved and rotated within the row */
+		do
+		  {
+			 changed = FALSE;
+			 for (o = 0; o < s->orients; o++)
+			   {
+				  n = s->rotation[o].next;
+				  r = spread (places->reach[n][yy] | (places->reach[o][yy] & places->fits[n][yy]),places->fits[n][yy]);
+				  if (r != places->reach[n][yy])
+					{
+					   places->reach[n][yy] = r;
+					   changed = TRUE;
+					}
+			   }
+		  }
+		while (changed);
+	 }
+   for (o = 0; o < s->orients; o++)
+	 for (yy = y; yy <= bottom; yy++)
+	   for (rest = places->reach[o][yy] & ~places->fits[o][yy + 1]; rest; rest &= rest - 1)
+		 {
+			placement_t *p = &places->placement[places->count++];
+			p->x = __builtin_ctzll (rest);
+			p->y = yy;
+			p->orient = o;
+		 }
+   return (places->count);
+}
+
+/* Row the shape comes to rest in when it is dropped from (orient,x,y) */
+static int drop (const places_t *places,int orient,int x,int y)
+{
+   while (places->fits[orient][y + 1] & BIT (x)) y++;
+   return (y);
+}
+
+/*
+ * Get the shortest sequence of actions that takes the shape to the i'th
+ * placement of the last place_find (). A sequence that doesn't end with a
+ * drop leaves the shape resting where it should be locked. Returns the
+ * length of the sequence (less than PLACESTATES).
+ */
+int place_path (places_t *places,int i,action_t *path)
+{
+   static const action_t ACTIONS[] = { ACTION_ROTATE, ACTION_LEFT, ACTION_RIGHT, ACTION_DOWN };
+   const shape_t *s = &SHAPES[places->shape];
+   const placement_t *p = &places->placement[i];
+   int head = 0,tail = 0,state,target = STATE (p->orient,p->x,p->y),found = -1;
+   int o,x,y,a,no,nx,ny,n,length;
+   action_t t,last = ACTION_DOWN;
+   memset (places->seen,0,sizeof (places->seen));
+   places->seen[places->orient][places->y] |= BIT (places->x);
+   places->queue[tail++] = STATE (places->orient,places->x,places->y);
+   if (places->queue[0] == target) found = target;
+   while (found < 0 && head < tail)
+	 {
+		state = places->queue[head++];
+		o = state / (NUMROWS * NUMCOLS);
+		y = state / NUMCOLS % NUMROWS;
+		x = state % NUMCOLS;
+		if (o == p->orient && x == p->x && y < p->y && drop (places,o,x,y) == p->y)
+		  {
+			 found = state;
+			 last = ACTION_DROP;
+			 break;
+		  }
+		for (a = 0; a < 4; a++)
+		  {
+			 no = ACTIONS[a] == ACTION_ROTATE ? s->rotation[o].next : o;
+			 nx = x + (ACTIONS[a] == ACTION_RIGHT) - (ACTIONS[a] == ACTION_LEFT);
+			 ny = y + (ACTIONS[a] == ACTION_DOWN);
+			 if (!(places->fits[no][ny] & BIT (nx)) || (places->seen[no][ny] & BIT (nx))) continue;
+			 places->seen[no][ny] |= BIT (nx);
+			 n = STATE (no,nx,ny);
+			 places->parent[n] = state;
+			 places->action[n] = ACTIONS[a];
+			 places->queue[tail++] = n;
+			 if (n == target)
+			   {
+				  found = n;
+				  break;
+			   }
+		  }
+	 }
+   /* follow the path back to the start, and turn it around */
+   length = 0;
+   if (last == ACTION_DROP) path[length++] = ACTION_DROP;
+   for (state = found; state != places->queue[0]; state = places->parent[state])
+	 path[length++] = (action_t) places->action[state];
+   for (a = 0; a < length / 2; a++)
+	 {
+		t = path[a];
+		path[a] = path[length - 1 - a];
+		path[length - 1 - a] = t;
+	 }
+   return (length);
+}
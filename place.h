@@ -0,0 +1,92 @@
+#ifndef PLACE_H
+#define PLACE_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* row_t, action_t */
+
+/*
+ * Macros
+ */
+
+/* Number of positions (orientation, row and column) a shape can be in. */
+/* There can't be more placements than this, nor longer paths to them */
+#define PLACESTATES	(NUMORIENTS * NUMROWS * NUMCOLS)
+
+/*
+ * Type definitions
+ */
+
+/* Where a shape can come to rest */
+typedef struct
+{
+   signed char x,y,orient;
+} placement_t;
+
+/*
+ * Every placement of a shape on a board, see place_find (). It is big, but
+ * it holds all the room a search needs, so nothing is allocated per search.
+ */
+typedef struct
+{
+   int count;									/* number of placements */
+   placement_t placement[PLACESTATES];
+   /* the search (see place.c) */
+   int shape,orient,x,y;						/* where the shape started */
+   row_t fits[NUMORIENTS][NUMROWS + 1];			/* columns the shape fits in, by orientation and row */
+   row_t reach[NUMORIENTS][NUMROWS];			/* columns it can get to */
+   row_t seen[NUMORIENTS][NUMROWS];				/* visited positions, for place_path () */
+   unsigned short queue[PLACESTATES],parent[PLACESTATES];
+   unsigned char action[PLACESTATES];
+} places_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Find every position in which the given shape can come to rest on the
+ * board, starting from the given orientation and position. A shape gets
+ * there by any sequence of left, right, rotate and down actions (so it can
+ * be tucked under overhangs), optionally followed by a drop. Every position
+ * is only listed once. Returns the number of placements.
+ */
+int place_find (places_t *places,const row_t *rows,int shape,int orient,int x,int y);
+
+/*
+ * Get the shortest sequence of actions that takes the shape to the i'th
+ * placement of the last place_find (). A sequence that doesn't end with a
+ * drop leaves the shape resting where it should be locked. Returns the
+ * length of the sequence (less than PLACESTATES).
+ */
+int place_path (places_t *places,int i,action_t *path);
+
+#endif	/* #ifndef PLACE_H */
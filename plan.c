@@ -0,0 +1,412 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "board.h"
+#include "place.h"
+#include "bot.h"
+#include "pool.h"
+#include "trans.h"
+#include "eval.h"
+#include "plan.h"
+
+/*
+ * Type definitions
+ */
+
+/* What the jobs of a search share */
+typedef struct
+{
+   planner_t *planner;
+   const engine_t *engine;
+   const places_t *places;			/* placements of the current shape */
+   boardnode_t root;						/* board of the engine */
+   unsigned int remaining;			/* shapes left in the bag after the next one */
+   bool bag;						/* shapes come in bags (else any shape can come any time) */
+   unsigned int seed;				/* seed of the rollouts of this shape */
+   bool timed;						/* there is a deadline */
+   struct timeval deadline;
+   atomic_bool expired;				/* ran out of time, some jobs weren't finished */
+} search_t;
+
+/*
+ * Global variables
+ */
+
+const char *PLANS_STRING[] = { "expectimax", "rollouts" };
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a planner with the given settings (see planner_t). The table may
+ * be shared with other planners (and threads) that use the same weights.
+ * Returns FALSE if there is not enough memory.
+ */
+bool plan_init (planner_t *planner,plankind_t kind,int depth,int rollouts,int candidates,int threads,long budget,
+				unsigned int seed,const weights_t *weights,trans_t *table)
+{
+   size_t values = (size_t) rollouts * candidates;
+   if (values < PLACESTATES) values = PLACESTATES;
+   planner->kind = kind;
+   planner->depth = depth;
+   planner->rollouts = rollouts;
+   planner->candidates = candidates;
+   planner->threads = threads;
+   planner->pool = NULL;
+   planner->budget = budget;
+   planner->seed = seed;
+   planner->weights = *weights;
+   planner->table = table;
+   atomic_init (&planner->work,0);
+   planner->seconds = 0;
+   planner->value = malloc (values * sizeof (double));
+   planner->done = malloc (values * sizeof (bool));
+   planner->candidate = malloc (candidates * sizeof (int));
+   /* every search hands out a round, so the threads stay around */
+   if (threads > 1) planner->pool = pool_start (threads);
+   if (planner->value == NULL || planner->done == NULL || planner->candidate == NULL || (threads > 1 && planner->pool == NULL))
+	 {
+		plan_free (planner);
+		return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/*
+ * Release the memory of a planner
+ */
+void plan_free (planner_t *planner)
+{
+   if (planner->pool != NULL) pool_stop (planner->pool);
+   planner->pool = NULL;
+   free (planner->value);
+   free (planner->done);
+   free (planner->candidate);
+   planner->value = NULL;
+   planner->done = NULL;
+   planner->candidate = NULL;
+}
+
+/*
+ * Look up a planner by name. Returns TRUE if successful, FALSE otherwise.
+ */
+bool str2plan (plankind_t *kind,const char *str)
+{
+   int i;
+   for (i = 0; i < NUMPLANS; i++)
+	 if (strcmp (str,PLANS_STRING[i]) == 0)
+	   {
+		  *kind = (plankind_t) i;
+		  return (TRUE);
+	   }
+   return (FALSE);
+}
+
+/* Put a shape on a board. Returns the number of lines removed */
+static int place (const boardnode_t *node,boardnode_t *child,int shape,const placement_t *placement)
+{
+   return (board_child (node,child,&SHAPES[shape].rotation[placement->orient],placement->x,placement->y));
+}
+
+/* Check if the search is out of time */
+static bool expired (search_t *search)
+{
+   struct timeval now;
+   if (atomic_load (&search->expired)) return (TRUE);
+   if (!search->timed) return (FALSE);
+   gettimeofday (&now,NULL);
+   if (!timercmp (&now,&search->deadline,>)) return (FALSE);
+   atomic_store (&search->expired,TRUE);
+   return (TRUE);
+}
+
+static double average (search_t *search,const boardnode_t *node,unsigned int remaining,int depth,unsigned long long *boards);
+
+/*
+ * Value of the best placement of a shape on a board, followed by depth - 1
+ * more shapes: the next one if it is known, else every one that can come
+ */
+static double maximize (search_t *search,const boardnode_t *node,int shape,int next,unsigned int remaining,int depth,unsigned long long *boards)
+{
+   const weights_t *weights = &search->planner->weights;
+   places_t places;
+   evalbatch_t batch;
+   boardnode_t child;
+   double scores[EVALBATCH],value,best = LOST;
+   int i,j,lines;
+   if (!place_find (&places,node->rows,shape,0,SPAWNX,SPAWNY)) return (LOST);
+   if (depth == 1)
+	 {
+		/* the last shape: measure all its boards together */
+		for (i = 0; i < places.count; i += batch.count)
+		  {
+			 for (batch.count = 0; batch.count < EVALBATCH && i + batch.count < places.count; )
+			   {
+				  lines = place (node,&child,shape,&places.placement[i + batch.count]);
+				  eval_add (&batch,child.rows,lines);
+			   }
+			 eval_scores (&batch,weights,scores);
+			 for (j = 0; j < batch.count; j++)
+			   if (scores[j] > best) best = scores[j];
+		  }
+		*boards += places.count;
+		return (best);
+	 }
+   for (i = 0; i < places.count; i++)
+	 {
+		lines = place (node,&child,shape,&places.placement[i]);
+		value = weights->weight[FEATURE_LINES] * lines;
+		if (next >= 0)
+		  value += maximize (search,&child,next,-1,remaining,depth - 1,boards);
+		else
+		  value += average (search,&child,remaining,depth - 1,boards);
+		if (value > best) best = value;
+	 }
+   return (best);
+}
+
+/*
+ * Value of a board, averaged over every shape that can come next (the
+ * ones left in the bag), followed by depth - 1 more shapes
+ */
+static double average (search_t *search,const boardnode_t *node,unsigned int remaining,int depth,unsigned long long *boards)
+{
+   trans_t *table = search->planner->table;
+   uint64_t key = 0;
+   unsigned int shapes;
+   double value,sum = 0;
+   int s,n = 0,found;
+   /* the value doesn't matter any more, the job won't count */
+   if (expired (search)) return (0);
+   /* only a value averaged to the same depth will do, so the result doesn't depend on what the other threads stored */
+   if (table != NULL)
+	 {
+		key = board_hash (node->rows) ^ board_key (ZOBRIST_BAG (remaining));
+		if (trans_probe (table,key,&value,&found) && found == depth) return (value);
+	 }
+   if (search->bag && !remaining) remaining = ALLSHAPES;
+   shapes = search->bag ? remaining : ALLSHAPES;
+   for (s = 0; s < NUMSHAPES; s++)
+	 if (shapes & (1U << s))
+	   {
+		  sum += maximize (search,node,s,-1,search->bag ? remaining & ~(1U << s) : 0,depth,boards);
+		  n++;
+	   }
+   value = sum / n;
+   if (table != NULL && !atomic_load (&search->expired)) trans_store (table,key,value,depth);
+   return (value);
+}
+
+/* Job of the pool: the expectimax value of the index'th placement of the current shape */
+static void expectimax (void *arg,unsigned long index)
+{
+   search_t *search = arg;
+   planner_t *planner = search->planner;
+   const engine_t *engine = search->engine;
+   boardnode_t child;
+   unsigned long long boards = 1;
+   double value;
+   int lines;
+   planner->done[index] = FALSE;
+   if (expired (search)) return;
+   lines = place (&search->root,&child,engine->curshape,&search->places->placement[index]);
+   value = planner->weights.weight[FEATURE_LINES] * lines;
+   if (planner->depth > 1)
+	 value += maximize (search,&child,engine->nextshape,-1,search->remaining,planner->depth - 1,&boards);
+   else if (board_allowed (child.rows,&SHAPES[engine->nextshape].rotation[0],SPAWNX,SPAWNY))
+	 value += bot_board (&planner->weights,child.rows,child.height,child.holes);
+   else
+	 value = LOST;
+   planner->value[index] = value;
+   planner->done[index] = !atomic_load (&search->expired);
+   atomic_fetch_add (&planner->work,boards);
+}
+
+/* Rollouts don't keep score */
+static void noscore (engine_t *engine)
+{
+}
+
+/*
+ * Job of the pool: play the index'th rollout, i.e. the (index % rollouts)'th
+ * one of candidate (index / rollouts), on a copy of the engine
+ */
+static void rollout (void *arg,unsigned long index)
+{
+   search_t *search = arg;
+   planner_t *planner = search->planner;
+   const placement_t *placement = &search->places->placement[planner->candidate[index / planner->rollouts]];
+   engine_t engine = *search->engine;
+   places_t places;
+   double values[PLACESTATES],value = 0,lines = planner->weights.weight[FEATURE_LINES];
+   unsigned int rng = rand_seed (search->seed,index % planner->rollouts);
+   int i,step,best,first = engine.bag_iterator % NUMSHAPES + 1;
+   planner->done[index] = FALSE;
+   if (expired (search)) return;
+   engine_unhook (&engine,NULL,NULL);
+   engine.score_function = noscore;
+   /* the rest of the bag can come in any order, and the bags after it are anyone's guess */
+   if (engine.randomizer == RANDOMIZER_UNIFORM)
+	 for (i = first; i < NUMSHAPES; i++) engine.bag[i] = rand_value_r (&rng,NUMSHAPES);
+   else if (first < NUMSHAPES)
+	 shuffle (&rng,engine.bag + first,NUMSHAPES - first);
+   engine.rng = rng;
+   for (step = 0; step < planner->depth; step++)
+	 {
+		/* after the candidate, the bot plays as it always does */
+		if (step)
+		  {
+			 place_find (&places,engine.board.rows,engine.curshape,engine.curorient,engine.curx,engine.cury);
+			 bot_values (&planner->weights,&engine,&places,values);
+			 for (best = 0, i = 1; i < places.count; i++)
+			   if (values[i] > values[best]) best = i;
+			 placement = &places.placement[best];
+		  }
+		if (engine_place (&engine,placement->x,placement->y,placement->orient) < 0)
+		  {
+			 value = LOST;
+			 break;
+		  }
+		value += lines * engine.status.currentdroppedlines;
+	 }
+   if (value > LOST) value += bot_board (&planner->weights,engine.board.rows,engine.height,engine.holes);
+   planner->value[index] = value;
+   planner->done[index] = TRUE;
+   atomic_fetch_add (&planner->work,1);
+}
+
+/* Check if the r'th rollout of each of the n candidates was played */
+static bool played (const planner_t *planner,int n,int r)
+{
+   int c;
+   for (c = 0; c < n; c++)
+	 if (!planner->done[c * planner->rollouts + r]) return (FALSE);
+   return (TRUE);
+}
+
+/* Do the jobs of a search with the threads of the planner */
+static void spread (planner_t *planner,unsigned long count,job_t job,search_t *search)
+{
+   unsigned long i;
+   if (planner->pool != NULL)
+	 pool_do (planner->pool,count,job,search);
+   else
+	 for (i = 0; i < count; i++) job (search,i);
+}
+
+/*
+ * Find the placements of the current shape of the specified tetris engine
+ * (see place_find ()) and pick the one that can be expected to do best.
+ * Returns the index of the placement, or -1 if there is none.
+ */
+int plan_search (planner_t *planner,const engine_t *engine,places_t *places)
+{
+   search_t search;
+   struct timeval start,end;
+   double value,best;
+   int i,c,r,n,choice = 0;
+   if (!place_find (places,engine->board.rows,engine->curshape,engine->curorient,engine->curx,engine->cury)) return (-1);
+   gettimeofday (&start,NULL);
+   search.planner = planner;
+   search.engine = engine;
+   search.places = places;
+   search.remaining = engine_bag (engine);
+   search.bag = engine->randomizer != RANDOMIZER_UNIFORM;
+   search.timed = planner->budget > 0;
+   atomic_init (&search.expired,FALSE);
+   if (search.timed)
+	 {
+		struct timeval budget = { planner->budget / 1000000, planner->budget % 1000000 };
+		timeradd (&start,&budget,&search.deadline);
+	 }
+   if (planner->kind == PLAN_EXPECTIMAX)
+	 {
+		memcpy (search.root.rows,engine->board.rows,sizeof (search.root.rows));
+		memcpy (search.root.height,engine->height,sizeof (search.root.height));
+		memcpy (search.root.fill,engine->fill,sizeof (search.root.fill));
+		search.root.holes = engine->holes;
+		if (planner->table != NULL) trans_age (planner->table);
+		spread (planner,places->count,expectimax,&search);
+		/* the values of the placements that weren't finished are missing, so it's up to the bot */
+		if (atomic_load (&search.expired)) bot_values (&planner->weights,engine,places,planner->value);
+		for (i = 1; i < places->count; i++)
+		  if (planner->value[i] > planner->value[choice]) choice = i;
+	 }
+   else
+	 {
+		/* the candidates are the placements the bot likes best by itself */
+		bot_values (&planner->weights,engine,places,planner->value);
+		n = planner->candidates < places->count ? planner->candidates : places->count;
+		for (c = 0; c < n; c++)
+		  for (planner->candidate[c] = -1, best = 0, i = 0; i < places->count; i++)
+			{
+			   for (r = 0; r < c && planner->candidate[r] != i; r++) ;
+			   if (r == c && (planner->candidate[c] < 0 || planner->value[i] > best))
+				 {
+					best = planner->value[i];
+					planner->candidate[c] = i;
+				 }
+			}
+		/* every shape gets its own rollouts */
+		search.seed = rand_seed (planner->seed,engine->bag_iterator);
+		spread (planner,(unsigned long) n * planner->rollouts,rollout,&search);
+		/* added up in order, so the threads don't change the outcome. Out of time, only */
+		/* the rollouts every candidate got count (none at all leaves the bot's choice) */
+		for (best = 0, c = 0; c < n; c++)
+		  {
+			 for (value = 0, r = 0; r < planner->rollouts; r++)
+			   if (played (planner,n,r)) value += planner->value[c * planner->rollouts + r];
+			 if (!c || value > best)
+			   {
+				  best = value;
+				  choice = planner->candidate[c];
+			   }
+		  }
+	 }
+   gettimeofday (&end,NULL);
+   planner->seconds += (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+   return (choice);
+}
+
+/*
+ * Get the rollouts (or expectimax boards) per second the planner has done
+ */
+double plan_speed (const planner_t *planner)
+{
+   return (planner->seconds > 0 ? atomic_load (&planner->work) / planner->seconds : 0);
+}
@@ -0,0 +1,131 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+#include "place.h"			/* places_t */
+#include "bot.h"			/* weights_t */
+#include "trans.h"			/* trans_t */
+#include "pool.h"			/* pool_t */
+
+/*
+ * Type definitions
+ */
+
+/* How the planner looks at the shapes it doesn't know yet */
+typedef enum
+{
+   PLAN_EXPECTIMAX,					/* every shape that can come, averaged */
+   PLAN_ROLLOUTS					/* games played out by the bot with shapes drawn at random */
+} plankind_t;
+
+#define NUMPLANS	2
+
+/*
+ * A planner that averages over the shapes that can come rather than
+ * keeping the best boards. Expectimax tries every shape left in the bag
+ * (or any shape, once it is empty) and every placement of it, for depth
+ * shapes. Rollouts let the bot play depth shapes from each of the best
+ * candidates placements of the current shape, rollouts times, with the
+ * rest of the bag shuffled and the next bags drawn from a stream of their
+ * own. The r'th rollout of every candidate gets the same shapes.
+ *
+ * The root placements (or rollouts) are spread over the threads, and
+ * every job works on its own copy of the board or engine, so the result
+ * only depends on the seed, not on the threads. A search that runs out
+ * of time only counts the jobs it finished: the rollouts every candidate
+ * got, or none of the expectimax values, in which case the bot's own
+ * choice is taken.
+ */
+typedef struct
+{
+   plankind_t kind;
+   int depth;						/* shapes looked at, the current one included */
+   int rollouts;					/* rollouts per candidate */
+   int candidates;					/* placements of the current shape that get rollouts */
+   int threads;						/* threads the work is spread over */
+   pool_t *pool;					/* the ones besides the caller (NULL = none) */
+   long budget;						/* microseconds a search may take (0 = no limit) */
+   unsigned int seed;				/* seed of the rollouts */
+   weights_t weights;				/* what the bot looks for in a board */
+   trans_t *table;					/* expectimax: values of the boards averaged so far (NULL = none) */
+   double *value;					/* value of every root placement or rollout */
+   bool *done;						/* ... if it was finished in time */
+   int *candidate;					/* root placements that get rollouts */
+   atomic_ullong work;				/* rollouts played (or boards measured by expectimax) */
+   double seconds;					/* time spent searching */
+} planner_t;
+
+/*
+ * Global variables
+ */
+
+/* Names of the planners */
+extern const char *PLANS_STRING[];
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up a planner with the given settings (see planner_t). The table may
+ * be shared with other planners (and threads) that use the same weights.
+ * Returns FALSE if there is not enough memory.
+ */
+bool plan_init (planner_t *planner,plankind_t kind,int depth,int rollouts,int candidates,int threads,long budget,
+				unsigned int seed,const weights_t *weights,trans_t *table);
+
+/*
+ * Release the memory of a planner
+ */
+void plan_free (planner_t *planner);
+
+/*
+ * Look up a planner by name. Returns TRUE if successful, FALSE otherwise.
+ */
+bool str2plan (plankind_t *kind,const char *str);
+
+/*
+ * Find the placements of the current shape of the specified tetris engine
+ * (see place_find ()) and pick the one that can be expected to do best.
+ * Returns the index of the placement, or -1 if there is none.
+ */
+int plan_search (planner_t *planner,const engine_t *engine,places_t *places);
+
+/*
+ * Get the rollouts (or expectimax boards) per second the planner has done
+ */
+double plan_speed (const planner_t *planner);
+
+#endif	/* #ifndef PLAN_H */
@@ -0,0 +1,286 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "pool.h"
+
+/*
+ * Type definitions
+ */
+
+/*
+ * The indices a worker still has to do. The first and last (exclusive)
+ * index share one word so that the owner taking from the front and
+ * thieves taking from the back can both update it with a single CAS.
+ */
+typedef _Atomic uint64_t range_t;
+
+#define RANGE(first,last) ((uint64_t) (last) << 32 | (uint32_t) (first))
+#define FIRST(range) ((uint32_t) (range))
+#define LAST(range) ((uint32_t) ((range) >> 32))
+
+typedef struct
+{
+   pool_t *pool;
+   pthread_t thread;
+   int id;
+   range_t range;
+} worker_t;
+
+struct pool_struct
+{
+   job_t job;
+   void *arg;
+   unsigned long base;				/* index of the first job in this round */
+   int threads;
+   worker_t *worker;
+   /* threads that stay around (see pool_start ()) */
+   int started;						/* threads that are running, the caller included */
+   unsigned int round;				/* rounds handed out (guarded by lock) */
+   int busy;						/* threads still at the last round (guarded by lock) */
+   bool quit;						/* the threads should stop (guarded by lock) */
+   pthread_mutex_t lock;
+   pthread_cond_t wakeup,done;
+};
+
+/*
+ * Functions
+ */
+
+/* Take the first index of the worker's own range. Returns FALSE if it is empty */
+static bool take (worker_t *worker,uint32_t *index)
+{
+   uint64_t range = atomic_load (&worker->range);
+   while (FIRST (range) < LAST (range))
+	 if (atomic_compare_exchange_weak (&worker->range,&range,RANGE (FIRST (range) + 1,LAST (range))))
+	   {
+		  *index = FIRST (range);
+		  return (TRUE);
+	   }
+   return (FALSE);
+}
+
+/* Move the back half of another worker's range to this (idle) one. Returns FALSE if there was nothing left */
+static bool steal (worker_t *worker)
+{
+   pool_t *pool = worker->pool;
+   int i;
+   for (i = 1; i < pool->threads; i++)
+	 {
+		worker_t *victim = &pool->worker[(worker->id + i) % pool->threads];
+		uint64_t range = atomic_load (&victim->range);
+		while (FIRST (range) < LAST (range))
+		  {
+			 uint32_t half = (LAST (range) - FIRST (range) + 1) / 2;
+			 uint32_t split = LAST (range) - half;
+			 if (atomic_compare_exchange_weak (&victim->range,&range,RANGE (FIRST (range),split)))
+			   {
+				  /* nobody touches an empty range, so a plain store is enough */
+				  atomic_store (&worker->range,RANGE (split,split + half));
+				  return (TRUE);
+			   }
+		  }
+	 }
+   return (FALSE);
+}
+
+static void *work (void *arg)
+{
+   worker_t *worker = arg;
+   pool_t *pool = worker->pool;
+   uint32_t index;
+   do
+	 while (take (worker,&index))
+	   pool->job (pool->arg,pool->base + index);
+   while (steal (worker));
+   return (NULL);
+}
+
+/* Share n jobs out equally between the workers */
+static void deal (pool_t *pool,uint32_t n)
+{
+   int i;
+   for (i = 0; i < pool->threads; i++)
+	 atomic_store (&pool->worker[i].range,RANGE ((uint64_t) n * i / pool->threads,(uint64_t) n * (i + 1) / pool->threads));
+}
+
+/*
+ * Call job (arg,index) for every index from 0 to count - 1 using the
+ * specified number of threads and return when all of them are done.
+ * Each thread starts with an equal share of the indices and steals half
+ * of what is left of another thread once it runs out, so the calls can
+ * take very different times. The order of the calls is undefined.
+ */
+void pool_run (int threads,unsigned long count,job_t job,void *arg)
+{
+   pool_t pool;
+   int i,started;
+   if (threads < 1) threads = 1;
+   pool.job = job;
+   pool.arg = arg;
+   pool.threads = threads;
+   pool.worker = malloc (threads * sizeof (worker_t));
+   if (pool.worker == NULL) abort ();
+   /* a range only holds 32-bit indices, so huge counts are done in rounds */
+   for (pool.base = 0; pool.base < count; pool.base += UINT32_MAX)
+	 {
+		for (i = 0; i < threads; i++)
+		  {
+			 pool.worker[i].pool = &pool;
+			 pool.worker[i].id = i;
+			 atomic_init (&pool.worker[i].range,0);
+		  }
+		deal (&pool,count - pool.base < UINT32_MAX ? count - pool.base : UINT32_MAX);
+		/* if we can't get all the threads, the others steal the work of the missing ones */
+		for (started = 1; started < threads; started++)
+		  if (pthread_create (&pool.worker[started].thread,NULL,work,&pool.worker[started])) break;
+		work (&pool.worker[0]);
+		for (i = 1; i < started; i++)
+		  pthread_join (pool.worker[i].thread,NULL);
+	 }
+   free (pool.worker);
+}
+
+/* A thread of a pool that stays around: do every round it is handed */
+static void *serve (void *arg)
+{
+   worker_t *worker = arg;
+   pool_t *pool = worker->pool;
+   unsigned int round = 0;
+   bool quit;
+   for (;;)
+	 {
+		pthread_mutex_lock (&pool->lock);
+		while (pool->round == round && !pool->quit)
+		  pthread_cond_wait (&pool->wakeup,&pool->lock);
+		round = pool->round;
+		quit = pool->quit;
+		pthread_mutex_unlock (&pool->lock);
+		if (quit) break;
+		work (worker);
+		pthread_mutex_lock (&pool->lock);
+		if (!--pool->busy) pthread_cond_signal (&pool->done);
+		pthread_mutex_unlock (&pool->lock);
+	 }
+   return (NULL);
+}
+
+/*
+ * Start a pool of the specified number of threads (the one that calls
+ * pool_do () included) that wait for work. Returns NULL if there is not
+ * enough memory.
+ */
+pool_t *pool_start (int threads)
+{
+   pool_t *pool;
+   int i;
+   if (threads < 1) threads = 1;
+   if ((pool = malloc (sizeof (pool_t))) == NULL) return (NULL);
+   if ((pool->worker = malloc (threads * sizeof (worker_t))) == NULL)
+	 {
+		free (pool);
+		return (NULL);
+	 }
+   pool->threads = threads;
+   pool->round = 0;
+   pool->busy = 0;
+   pool->quit = FALSE;
+   pthread_mutex_init (&pool->lock,NULL);
+   pthread_cond_init (&pool->wakeup,NULL);
+   pthread_cond_init (&pool->done,NULL);
+   for (i = 0; i < threads; i++)
+	 {
+		pool->worker[i].pool = pool;
+		pool->worker[i].id = i;
+		atomic_init (&pool->worker[i].range,0);
+	 }
+   /* like pool_run (), the threads that couldn't be started leave their work to the others */
+   for (pool->started = 1; pool->started < threads; pool->started++)
+	 if (pthread_create (&pool->worker[pool->started].thread,NULL,serve,&pool->worker[pool->started])) break;
+   return (pool);
+}
+
+/*
+ * Call job (arg,index) for every index from 0 to count - 1 with the
+ * threads of the pool, like pool_run (), and return when all of them are
+ * done. Nothing is allocated and no thread is created.
+ */
+void pool_do (pool_t *pool,unsigned long count,job_t job,void *arg)
+{
+   pool->job = job;
+   pool->arg = arg;
+   for (pool->base = 0; pool->base < count; pool->base += UINT32_MAX)
+	 {
+		deal (pool,count - pool->base < UINT32_MAX ? count - pool->base : UINT32_MAX);
+		pthread_mutex_lock (&pool->lock);
+		pool->busy = pool->started - 1;
+		pool->round++;
+		pthread_cond_broadcast (&pool->wakeup);
+		pthread_mutex_unlock (&pool->lock);
+		work (&pool->worker[0]);
+		pthread_mutex_lock (&pool->lock);
+		while (pool->busy)
+		  pthread_cond_wait (&pool->done,&pool->lock);
+		pthread_mutex_unlock (&pool->lock);
+	 }
+}
+
+/*
+ * Stop the threads of a pool and release it
+ */
+void pool_stop (pool_t *pool)
+{
+   int i;
+   pthread_mutex_lock (&pool->lock);
+   pool->quit = TRUE;
+   pthread_cond_broadcast (&pool->wakeup);
+   pthread_mutex_unlock (&pool->lock);
+   for (i = 1; i < pool->started; i++)
+	 pthread_join (pool->worker[i].thread,NULL);
+   pthread_cond_destroy (&pool->done);
+   pthread_cond_destroy (&pool->wakeup);
+   pthread_mutex_destroy (&pool->lock);
+   free (pool->worker);
+   free (pool);
+}
+
+/*
+ * Number of processors that are online
+ */
+int pool_cpus ()
+{
+   long n = sysconf (_SC_NPROCESSORS_ONLN);
+   return (n > 0 ? n : 1);
+}
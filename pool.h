@@ -0,0 +1,84 @@
+#ifndef POOL_H
+#define POOL_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Type definitions
+ */
+
+/* A job is called once for every index in the range given to pool_run () */
+typedef void (*job_t) (void *arg,unsigned long index);
+
+/*
+ * Threads that stay around between rounds of jobs, for callers that hand
+ * out small rounds all the time: a round then costs two wakeups rather
+ * than creating the threads and their memory
+ */
+typedef struct pool_struct pool_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Call job (arg,index) for every index from 0 to count - 1 using the
+ * specified number of threads and return when all of them are done.
+ * Each thread starts with an equal share of the indices and steals half
+ * of what is left of another thread once it runs out, so the calls can
+ * take very different times. The order of the calls is undefined.
+ */
+void pool_run (int threads,unsigned long count,job_t job,void *arg);
+
+/*
+ * Start a pool of the specified number of threads (the one that calls
+ * pool_do () included) that wait for work. Returns NULL if there is not
+ * enough memory.
+ */
+pool_t *pool_start (int threads);
+
+/*
+ * Call job (arg,index) for every index from 0 to count - 1 with the
+ * threads of the pool, like pool_run (), and return when all of them are
+ * done. Nothing is allocated and no thread is created.
+ */
+void pool_do (pool_t *pool,unsigned long count,job_t job,void *arg);
+
+/*
+ * Stop the threads of a pool and release it
+ */
+void pool_stop (pool_t *pool);
+
+/*
+ * Number of processors that are online
+ */
+int pool_cpus ();
+
+#endif	/* #ifndef POOL_H */
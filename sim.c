@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "game.h"
+#include "place.h"
+#include "bot.h"
+#include "beam.h"
+#include "plan.h"
+#include "sim.h"
+
+/*
+ * Functions
+ */
+
+/* Pick a placement of the current shape and plan the actions for it */
+static void bot_plan (input_t *input,const game_t *game)
+{
+   const engine_t *engine = &game->engine;
+   places_t places;
+   double values[PLACESTATES];
+   int i,choice = -1;
+   input->planned = input->played = 0;
+   if (input->beam != NULL)
+	 choice = beam_search (input->beam,engine,&places);
+   else if (input->planner != NULL)
+	 choice = plan_search (input->planner,engine,&places);
+   else if (place_find (&places,engine->board.rows,engine->curshape,engine->curorient,engine->curx,engine->cury))
+	 {
+		bot_values (&input->weights,engine,&places,values);
+		for (choice = 0, i = 1; i < places.count; i++)
+		  if (values[i] > values[choice]) choice = i;
+	 }
+   if (choice >= 0) input->planned = place_path (&places,choice,input->plan);
+}
+
+static bool bot_next (input_t *input,const game_t *game,action_t *action)
+{
+   if (input->turn != game->turn)
+	 {
+		input->turn = game->turn;
+		bot_plan (input,game);
+	 }
+   if (input->played >= input->planned) return FALSE;
+   *action = input->plan[input->played++];
+   return TRUE;
+}
+
+static bool random_next (input_t *input,const game_t *game,action_t *action)
+{
+   int i = rand_value_r (&input->rng,ACTION_DOWN + 2);
+   if (i > ACTION_DOWN) return FALSE;
+   *action = (action_t) i;
+   return TRUE;
+}
+
+static bool script_next (input_t *input,const game_t *game,action_t *action)
+{
+   char line[64];
+   int i;
+   while (fgets (line,sizeof (line),input->script) != NULL)
+	 {
+		line[strcspn (line," \t\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') continue;
+		if (strcmp (line,"fall") == 0) return FALSE;
+		for (i = 0; i <= ACTION_DOWN; i++)
+		  if (strcmp (line,ACTIONS_STRING[i]) == 0)
+			{
+			   *action = (action_t) i;
+			   return TRUE;
+			}
+		fprintf (stderr,"Invalid action in script -- %s\n",line);
+	 }
+   return FALSE;
+}
+
+/*
+ * Let the built-in bot play: every shape is put where the board scores
+ * best with the given weights (see bot.h), or the default ones if NULL
+ */
+void input_bot (input_t *input,const weights_t *weights)
+{
+   input->next = bot_next;
+   if (weights != NULL)
+	 input->weights = *weights;
+   else
+	 bot_defaults (&input->weights);
+   input->beam = NULL;
+   input->planner = NULL;
+   input->turn = -1;
+   input->planned = input->played = 0;
+}
+
+/*
+ * Let the bot search the next shapes with the given beam search (see
+ * beam.h) before putting the current one, or just look at the current
+ * shape if NULL. Call after input_bot ().
+ */
+void input_beam (input_t *input,beam_t *beam)
+{
+   input->beam = beam;
+   input->turn = -1;
+}
+
+/*
+ * Let the bot average over the shapes that can come with the given
+ * planner (see plan.h) before putting the current one, or just look at
+ * the current shape if NULL. Call after input_bot ().
+ */
+void input_plan (input_t *input,planner_t *planner)
+{
+   input->planner = planner;
+   input->turn = -1;
+}
+
+/*
+ * Play random actions (or let the shape fall) drawn from the given seed
+ */
+void input_random (input_t *input,unsigned int seed)
+{
+   input->next = random_next;
+   input->rng = seed ? seed : 1;
+}
+
+/*
+ * Play the actions in the given file, one per line: left, right, rotate,
+ * down, drop or fall (let the shape fall a row). Empty lines and lines
+ * starting with # are skipped. Once the file is exhausted, shapes just fall.
+ */
+void input_script (input_t *input,FILE *script)
+{
+   input->next = script_next;
+   input->script = script;
+}
+
+/*
+ * Play the specified game with actions from the given input until the
+ * game is over or maxshapes shapes were released (0 = no limit). There
+ * is no clock: the shape only falls when the input lets it.
+ */
+void sim_play (game_t *game,input_t *input,int maxshapes,simresult_t *result)
+{
+   struct timeval starttv,endtv;
+   gameinfo_t info;
+   action_t action;
+   int status = 1;
+   game_query (game,&info);
+   gettimeofday (&starttv,NULL);
+   do
+	 {
+		if (input->next (input,game,&action))
+		  {
+			 game_move (game,action);
+			 /* like the keyboard, every other action leaves the shape where it is */
+			 if (action != ACTION_DROP) continue;
+		  }
+		status = game_step (game);
+		game_query (game,&info);
+	 }
+   while (status >= 0 && (!maxshapes || info.shapes < maxshapes));
+   gettimeofday (&endtv,NULL);
+   result->score = info.score;
+   result->lines = info.lines;
+   result->shapes = info.shapes;
+   result->seconds = (endtv.tv_sec - starttv.tv_sec) + (endtv.tv_usec - starttv.tv_usec) / 1000000.0;
+}
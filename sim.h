@@ -0,0 +1,114 @@
+#ifndef SIM_H
+#define SIM_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>			/* FILE */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* action_t */
+#include "game.h"			/* game_t */
+#include "place.h"			/* PLACESTATES */
+#include "bot.h"			/* weights_t */
+#include "beam.h"			/* beam_t */
+#include "plan.h"			/* planner_t */
+
+/*
+ * Type definitions
+ */
+
+/* Where a simulated game gets its actions from */
+typedef struct input_struct
+{
+   /* Get the next action for the game. Returns FALSE to let the shape fall a row instead */
+   bool (*next) (struct input_struct *input,const game_t *game,action_t *action);
+   /* state of the different inputs */
+   unsigned int rng;								/* random play */
+   FILE *script;									/* scripted play */
+   weights_t weights;								/* bot: what it looks for in a board */
+   beam_t *beam;									/* bot: search ahead with this (NULL = current shape only) */
+   planner_t *planner;								/* bot: or plan ahead with this */
+   int turn;										/* bot: turn the plan was made for */
+   int planned,played;								/* bot: length of plan, actions played so far */
+   action_t plan[PLACESTATES];						/* bot: actions that place the current shape */
+} input_t;
+
+/* Outcome of a simulated game */
+typedef struct
+{
+   int score;						/* displayed score */
+   int lines;						/* number of lines removed */
+   int shapes;						/* number of shapes released */
+   double seconds;					/* time it took to play the game */
+} simresult_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Let the built-in bot play: every shape is put where the board scores
+ * best with the given weights (see bot.h), or the default ones if NULL
+ */
+void input_bot (input_t *input,const weights_t *weights);
+
+/*
+ * Let the bot search the next shapes with the given beam search (see
+ * beam.h) before putting the current one, or just look at the current
+ * shape if NULL. Call after input_bot ().
+ */
+void input_beam (input_t *input,beam_t *beam);
+
+/*
+ * Let the bot average over the shapes that can come with the given
+ * planner (see plan.h) before putting the current one, or just look at
+ * the current shape if NULL. Call after input_bot ().
+ */
+void input_plan (input_t *input,planner_t *planner);
+
+/*
+ * Play random actions (or let the shape fall) drawn from the given seed
+ */
+void input_random (input_t *input,unsigned int seed);
+
+/*
+ * Play the actions in the given file, one per line: left, right, rotate,
+ * down, drop or fall (let the shape fall a row). Empty lines and lines
+ * starting with # are skipped. Once the file is exhausted, shapes just fall.
+ */
+void input_script (input_t *input,FILE *script);
+
+/*
+ * Play the specified game with actions from the given input until the
+ * game is over or maxshapes shapes were released (0 = no limit). There
+ * is no clock: the shape only falls when the input lets it.
+ */
+void sim_play (game_t *game,input_t *input,int maxshapes,simresult_t *result);
+
+#endif	/* #ifndef SIM_H */
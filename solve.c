@@ -0,0 +1,268 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-pc looks for a perfect clear: placements for a known sequence of
+ * shapes that leave a (low) board completely empty, or a proof that there
+ * are none. The board is read from a file with a line per row, the bottom
+ * row last, where '.' and ' ' are empty cells and anything else is full.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "board.h"
+#include "place.h"
+#include "pool.h"
+#include "pc.h"
+
+/*
+ * Macros
+ */
+
+/* Default size of the memo (in megabytes) */
+#define MEMOMB		64
+
+/* Letters of the shapes, in the order of SHAPES */
+#define LETTERS		"ZSTOLJI"
+
+/*
+ * Type definitions
+ */
+
+/* Command line options */
+typedef struct
+{
+   const char *board;			/* file the board is read from (NULL = empty board) */
+   int shapes[PCMAXSHAPES];
+   int count;					/* number of shapes */
+   int threads;
+   int memo;					/* megabytes of boards the solver remembers */
+} options_t;
+
+/*
+ * Functions
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-pc [-h] [--board file] --shapes list [--threads n] [--memo mb]\n");
+   fprintf (stderr,"  -h             Show this help message\n");
+   fprintf (stderr,"  --board <file> Board to clear: a line per row, the bottom row last, '.' for an\n");
+   fprintf (stderr,"                 empty cell and anything else for a full one (default empty)\n");
+   fprintf (stderr,"  --shapes <list>\n");
+   fprintf (stderr,"                 Shapes in the order they come: the current one, the next one,\n");
+   fprintf (stderr,"                 the rest of the bag and so on, as letters (%s) or as the\n",LETTERS);
+   fprintf (stderr,"                 numbers in the log (0-%d)\n",NUMSHAPES - 1);
+   fprintf (stderr,"  --threads <n>  Number of threads (default: one per processor)\n");
+   fprintf (stderr,"  --memo <mb>    Size of the memo of hopeless boards (default %d)\n",MEMOMB);
+   exit (EXIT_FAILURE);
+}
+
+/* Read a list of shapes. Returns FALSE if it isn't one */
+static bool str2shapes (options_t *options,const char *str)
+{
+   const char *letter;
+   for (options->count = 0; *str; str++)
+	 {
+		if (options->count == PCMAXSHAPES) return (FALSE);
+		if (*str >= '0' && *str < '0' + NUMSHAPES)
+		  options->shapes[options->count++] = *str - '0';
+		else if ((letter = strchr (LETTERS,toupper ((unsigned char) *str))) != NULL)
+		  options->shapes[options->count++] = letter - LETTERS;
+		else if (*str != ',' && *str != ' ')
+		  return (FALSE);
+	 }
+   return (options->count > 0);
+}
+
+static void parse_options (options_t *options,int argc,char *argv[])
+{
+   int i = 1,n;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-h") == 0)
+		  showhelp ();
+		else if (strcmp (argv[i],"--board") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->board = argv[i];
+		  }
+		else if (strcmp (argv[i],"--shapes") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2shapes (options,argv[i])) showhelp ();
+		  }
+		else if (i + 1 < argc && str2int (&n,argv[i + 1]) && n > 0)
+		  {
+			 if (strcmp (argv[i],"--threads") == 0)
+			   options->threads = n;
+			 else if (strcmp (argv[i],"--memo") == 0)
+			   options->memo = n;
+			 else
+			   {
+				  fprintf (stderr,"Invalid option -- %s %s\n",argv[i],argv[i + 1]);
+				  showhelp ();
+			   }
+			 i++;
+		  }
+		else
+		  {
+			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
+			 showhelp ();
+		  }
+		i++;
+	 }
+   if (!options->count) showhelp ();
+}
+
+/* Read a board. Returns FALSE (and tells why on stderr) if it can't be used */
+static bool readboard (row_t *rows,const char *filename)
+{
+   char line[256];
+   row_t read[NUMROWS];
+   int x,y,n = 0;
+   FILE *fp;
+   if ((fp = fopen (filename,"r")) == NULL)
+	 {
+		fprintf (stderr,"Could not open board %s\n",filename);
+		return (FALSE);
+	 }
+   while (fgets (line,sizeof (line),fp) != NULL)
+	 {
+		if (n == NUMROWS - 2)
+		  {
+			 fprintf (stderr,"Board %s has more than %d rows\n",filename,NUMROWS - 2);
+			 fclose (fp);
+			 return (FALSE);
+		  }
+		for (read[n] = WALLROW, x = 0; x < PLAYCOLS && line[x] && line[x] != '\n'; x++)
+		  if (line[x] != '.' && line[x] != ' ') read[n] |= BIT (x + 1);
+		if (read[n] == FULLROW)
+		  {
+			 fprintf (stderr,"Row %d of board %s is full\n",n + 1,filename);
+			 fclose (fp);
+			 return (FALSE);
+		  }
+		n++;
+	 }
+   fclose (fp);
+   /* the last row read is the bottom one */
+   board_clear (rows);
+   for (y = 0; y < n; y++) rows[NUMROWS - 2 - n + y] = read[y];
+   return (TRUE);
+}
+
+/* Print the playfield rows from the highest occupied one down */
+static void showboard (const row_t *rows)
+{
+   int x,y;
+   for (y = 0; y < NUMROWS - 3 && rows[y] == WALLROW; y++) ;
+   for (; y < NUMROWS - 2; y++)
+	 {
+		printf ("  |");
+		for (x = 1; x <= PLAYCOLS; x++) putchar (rows[y] & BIT (x) ? '#' : '.');
+		printf ("|\n");
+	 }
+}
+
+int main (int argc,char *argv[])
+{
+   options_t options = { NULL, { 0 }, 0, 0, MEMOMB };
+   pcsolver_t solver;
+   placement_t solution[PCMAXSHAPES];
+   action_t path[PLACESTATES];
+   places_t *places;
+   row_t rows[NUMROWS];
+   unsigned char height[NUMCOLS],fill[NUMROWS];
+   struct timeval starttv,endtv;
+   double seconds;
+   int i,j,k,n,shape,holes;
+
+   parse_options (&options,argc,argv);
+   if (!options.threads) options.threads = pool_cpus ();
+   board_clear (rows);
+   if (options.board != NULL && !readboard (rows,options.board)) exit (EXIT_FAILURE);
+   if (!pc_init (&solver,(size_t) options.memo << 20,options.threads) || (places = malloc (sizeof (places_t))) == NULL)
+	 {
+		fprintf (stderr,"Not enough memory for a memo of %d MB\n",options.memo);
+		exit (EXIT_FAILURE);
+	 }
+
+   printf ("board: %dx%d\n",PLAYCOLS,PLAYROWS);
+   showboard (rows);
+   printf ("shapes: ");
+   for (i = 0; i < options.count; i++) putchar (LETTERS[options.shapes[i]]);
+   printf ("\n");
+
+   gettimeofday (&starttv,NULL);
+   n = pc_solve (&solver,rows,options.shapes,options.count,solution);
+   gettimeofday (&endtv,NULL);
+   seconds = (endtv.tv_sec - starttv.tv_sec) + (endtv.tv_usec - starttv.tv_usec) / 1000000.0;
+
+   if (n == -2)
+	 {
+		fprintf (stderr,"Not enough memory to search\n");
+		exit (EXIT_FAILURE);
+	 }
+   if (n < 0)
+	 printf ("perfect clear: none, with any of the shapes, of up to %d lines\n",PCMAXROWS);
+   else
+	 printf ("perfect clear: %d shapes\n",n);
+   /* play the placements, which tells how to get the shapes there */
+   board_surface (rows,height,fill,&holes);
+   for (i = 0; i < n; i++)
+	 {
+		shape = options.shapes[i];
+		place_find (places,rows,shape,0,SPAWNX,SPAWNY);
+		for (j = 0; places->placement[j].x != solution[i].x || places->placement[j].y != solution[i].y ||
+			   places->placement[j].orient != solution[i].orient; j++) ;
+		printf ("%d. %c at x %d, y %d, orientation %d:",i + 1,LETTERS[shape],solution[i].x,solution[i].y,solution[i].orient);
+		for (j = place_path (places,j,path), k = 0; k < j; k++) printf (" %s",ACTIONS_STRING[path[k]]);
+		printf ("\n");
+		board_lock (rows,height,fill,&holes,&SHAPES[shape].rotation[solution[i].orient],solution[i].x,solution[i].y);
+		board_droplines (rows,NULL,height,fill,&holes,1,NUMROWS - 3);
+		showboard (rows);
+	 }
+   /* timings differ from run to run, so they don't go with the answer */
+   fprintf (stderr,"%d threads, %.3f seconds, %llu boards, %llu pruned, %llu memo hits, %llu stored, %llu lost\n",
+			options.threads,seconds,(unsigned long long) atomic_load (&solver.nodes),(unsigned long long) atomic_load (&solver.pruned),
+			(unsigned long long) atomic_load (&solver.hits),(unsigned long long) atomic_load (&solver.stored),
+			(unsigned long long) atomic_load (&solver.lost));
+   pc_free (&solver);
+   free (places);
+   exit (EXIT_SUCCESS);
+}
@@ -34,13 +34,23 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include "typedefs.h"
 #include "utils.h"
 #include "io.h"
 #include "config.h"
 #include "engine.h"
+#include "game.h"
 #include "log.h"
+#include "sim.h"
+#include "bot.h"
+#include "beam.h"
+#include "plan.h"
+#include "hint.h"
+#include "trans.h"
+#include "pool.h"
+#include "export.h"
 
 /*
  * Macros
@@ -52,37 +62,54 @@
 #endif
 
 /* Upper left corner of board */
-#define XTOP ((out_width () - NUMROWS - 3) >> 1)
-#define YTOP ((out_height () - NUMCOLS - 9) >> 1)
+#define XTOP ((out_width () - 2 * (NUMCOLS - 1)) >> 1)
+#define YTOP ((out_height () - (NUMROWS - 1)) >> 1)
 
 /* Maximum digits in a number (i.e. number of digits in score, */
 /* number of blocks, etc. should not exceed this value */
 #define MAXDIGITS 12
 
-/* Number of levels in the game */
-#define MINLEVEL	1
-#define MAXLEVEL	9
+/* Length of a player's name */
+#define NAMELEN 20
 
-/* This calculates the time allowed to move a shape, before it is moved a row down */
-#define DELAY (1000000 / (level + 2))
+/* Default number of shapes the beam search or the planner of the bot looks at */
+#define DEPTH 3
 
-/* The score is multiplied by this to avoid losing precision */
-#define SCOREFACTOR 2
+/* Number of boards the hints are searched with, unless --beam says otherwise */
+#define HINTWIDTH 32
 
-/* This calculates the stored score value */
-#define SCOREVAL(x) (SCOREFACTOR * (x))
+/* Default number of rollouts per candidate placement, and of candidates */
+#define ROLLOUTS 32
+#define CANDIDATES 4
 
-/* This calculates the real (displayed) value of the score */
-#define GETSCORE(score) ((score) / SCOREFACTOR)
+/* Default size of the table of boards the search has measured (in megabytes). */
+/* Measuring a board takes less time than a cache miss, so it is off unless asked for */
+#define TABLEMB 0
 
-/* Length of a player's name */
-#define NAMELEN 20
+/* Command line options */
+typedef struct
+{
+   int level;
+   bool shownext;
+   bool dottedlines;
+   bool shadow;
+   const char *simulate;		/* NULL, or bot, random or a script file */
+   bool seeded;
+   unsigned int seed;
+   randomizer_t randomizer;
+   int shapes;					/* stop simulation after this many shapes (0 = never) */
+   bool autoplay;				/* the bot plays instead of the player */
+   bool hint;					/* show where the bot would put the shape */
+   weights_t weights;			/* what the bot plays for */
+   int width,depth;				/* beam search of the bot (width 0 = current shape only) */
+   int budget;					/* milliseconds per search (0 = no limit) */
+   bool plan;					/* the bot plans with a planner instead */
+   plankind_t kind;				/* which one */
+   int rollouts,candidates;		/* rollouts per candidate placement, and number of candidates */
+   int table;					/* megabytes of boards the search remembers (0 = none) */
+   const char *record;			/* prefix of the shards the game is recorded in (NULL = none) */
+} options_t;
 
-static bool shownext;
-static bool dottedlines;
-static bool shadow;
-static bool newturn;
-static int level = MINLEVEL - 1,shapecount[NUMSHAPES], turn = 0;
 static char blockchar = ' ';
 static char playername[NAMELEN] = ""; // Variable globale pour le nom du joueur
 static int scoressize = 0;
@@ -109,30 +136,52 @@ static void get_timestamp_string(char *buffer, size_t buffer_size)
             tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec, tv.tv_usec / 1000);
 }
 
-/* This function is responsible for increasing the score appropriately whenever
- * a block collides at the bottom of the screen (or the top of the heap */
-static void score_function (engine_t *engine)
+/* Draw a shape on top of the board */
+static void drawshape (const shape_t *shape,int orient,int x,int y)
 {
-   int score = SCOREVAL (level * (engine->status.dropcount + 1));
-   score += SCOREVAL ((level + 10) * engine->status.currentdroppedlines * engine->status.currentdroppedlines);
-
-   if (shownext) score /= 2;
-   if (dottedlines) score /= 2;
+   const rotation_t *rot = &shape->rotation[orient];
+   int i;
+   out_setcolor (COLOR_BLACK,shape->color);
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		/* the top row is hidden */
+		if (y + rot->block[i].y < 1) continue;
+		out_gotoxy (XTOP + (x + rot->block[i].x) * 2,YTOP + y + rot->block[i].y);
+		out_putch (blockchar);
+		out_putch (blockchar);
+	 }
+}
 
-   engine->score += score;
+/* Draw the outline of a shape where the hint says it should go */
+static void drawhint (const shape_t *shape,int orient,int x,int y)
+{
+   const rotation_t *rot = &shape->rotation[orient];
+   int i;
+   out_setattr (ATTR_BOLD);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		if (y + rot->block[i].y < 1) continue;
+		out_gotoxy (XTOP + (x + rot->block[i].x) * 2,YTOP + y + rot->block[i].y);
+		out_putch ('[');
+		out_putch (']');
+	 }
+   out_setattr (ATTR_OFF);
 }
 
-/* Draw the board on the screen */
-static void drawboard (board_t board)
+/* Draw the board, the hint (if any), the shadow and the falling shape on the screen */
+static void drawboard (const game_t *game,const hint_t *hint)
 {
-   int x,y;
+   const engine_t *engine = &game->engine;
+   const board_t *board = &engine->board;
+   int x,y,orient;
    out_setattr (ATTR_OFF);
    for (y = 1; y < NUMROWS - 1; y++) {
       for (x = 0; x < NUMCOLS - 1; x++) {
          // Vérifier les limites avant d'accéder au tableau
          if (x >= 0 && x < NUMCOLS && y >= 0 && y < NUMROWS) {
             out_gotoxy (XTOP + x * 2,YTOP + y);
-            switch (board[x][y])
+            switch (board->color[y][x])
 		  {
 			 /* Wall */
 		   case WALL:
@@ -144,7 +193,7 @@ static void drawboard (board_t board)
 			 break;
 			 /* Background */
 		   case 0:
-			 if (dottedlines)
+			 if (game->dottedlines)
 			   {
 				  out_setcolor (COLOR_BLUE,COLOR_BLACK);
 				  out_putch ('.');
@@ -159,13 +208,16 @@ static void drawboard (board_t board)
 			 break;
 			 /* Block */
 		   default:
-			 out_setcolor (COLOR_BLACK,board[x][y]);
+			 out_setcolor (COLOR_BLACK,board->color[y][x]);
 			 out_putch (blockchar);
 			 out_putch (blockchar);
 		  }
          }
       }
    }
+   if (hint != NULL && hint_get (hint,&x,&y,&orient)) drawhint (&SHAPES[engine->curshape],orient,x,y);
+   if (engine->shadow) drawshape (&SHAPES[engine->curshape],engine->curorient,engine->curx_shadow,engine->cury_shadow);
+   drawshape (&SHAPES[engine->curshape],engine->curorient,engine->curx,engine->cury);
    out_setattr (ATTR_OFF);
 }
 
@@ -184,8 +236,8 @@ static void drawnext (int shapenum,int x,int y)
    out_setcolor (COLOR_BLACK,SHAPES[shapenum].color);
    for (i = 0; i < NUMBLOCKS; i++)
 	 {
-		out_gotoxy (x + SHAPES[shapenum].block[i].x * 2 + ofs[shapenum].x,
-					y + SHAPES[shapenum].block[i].y + ofs[shapenum].y);
+		out_gotoxy (x + SHAPES[shapenum].rotation[0].block[i].x * 2 + ofs[shapenum].x,
+					y + SHAPES[shapenum].rotation[0].block[i].y + ofs[shapenum].y);
 		out_putch (' ');
 		out_putch (' ');
 	 }
@@ -209,31 +261,32 @@ static void drawbackground ()
    out_gotoxy (3,YTOP + 19);  out_printf ("Next:");
 }
 
-static int getsum ()
+static int getsum (const game_t *game)
 {
    int i,sum = 0;
-   for (i = 0; i < NUMSHAPES; i++) sum += shapecount[i];
+   for (i = 0; i < NUMSHAPES; i++) sum += game->shapecount[i];
    return (sum);
 }
 
 /* This show the current status of the game */
-static void showstatus (engine_t *engine)
+static void showstatus (game_t *game)
 {
+   const engine_t *engine = &game->engine;
    static const int shapenum[NUMSHAPES] = { 4, 6, 5, 1, 0, 3, 2 };
    char tmp[MAXDIGITS + 1];
    char timestamp_str[TIMESTAMP_BUFFER_SIZE];
-   int i,sum = getsum ();
+   int i,sum = getsum (game);
    
    out_setattr (ATTR_OFF);
    out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (1,YTOP + 1);   out_printf ("Your level: %d",level);
+   out_gotoxy (1,YTOP + 1);   out_printf ("Your level: %d",game->level);
    out_gotoxy (1,YTOP + 2);   out_printf ("Full lines: %d",engine->status.droppedlines);
    out_gotoxy (1,YTOP + 3);   out_printf ("curx : %d, cury :%d", engine->curx,engine->cury);
    out_gotoxy (2,YTOP + 4);   out_printf ("Score");
    out_setattr (ATTR_BOLD);
    out_setcolor (COLOR_YELLOW,COLOR_BLACK);
    out_printf ("  %d",GETSCORE (engine->score));
-   if (shownext) drawnext (engine->nextshape,3,YTOP + 22);
+   if (game->shownext) drawnext (engine->nextshape,3,YTOP + 22);
    out_setattr (ATTR_OFF);
    out_setcolor (COLOR_WHITE,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 12,YTOP + 1);
@@ -246,7 +299,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_MAGENTA,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 3);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[0]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[0]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 3);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_BLACK,COLOR_RED);
@@ -255,7 +308,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_RED,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 5);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[1]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[1]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 5);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_BLACK,COLOR_WHITE);
@@ -266,7 +319,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_WHITE,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 7);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[2]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[2]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 7);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_BLACK,COLOR_GREEN);
@@ -277,7 +330,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_GREEN,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 9);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[3]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[3]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 9);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_BLACK,COLOR_CYAN);
@@ -288,7 +341,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_CYAN,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 11);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[4]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[4]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 11);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_BLACK,COLOR_BLUE);
@@ -299,7 +352,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_BLUE,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 13);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[5]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[5]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 13);
    out_printf ("%s",tmp);
    out_setattr (ATTR_OFF);
@@ -311,7 +364,7 @@ static void showstatus (engine_t *engine)
    out_setcolor (COLOR_YELLOW,COLOR_BLACK);
    out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 15);
    out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[6]]);
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[6]]);
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 15);
    out_printf ("%s",tmp);
    out_setcolor (COLOR_WHITE,COLOR_BLACK);
@@ -341,25 +394,25 @@ static void showstatus (engine_t *engine)
    out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 21);
    out_printf ("%s",tmp);
 
-   if (newturn)
+   if (game->newturn)
    {
        get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-       fprintf(logfile, "%s Level = %d\n", timestamp_str, level);
+       fprintf(logfile, "%s Level = %d\n", timestamp_str, game->level);
        fprintf(logfile, "%s Score = %d\n", timestamp_str, GETSCORE (engine->score));
        fprintf(logfile, "%s Full lines = %d\n", timestamp_str, engine->status.droppedlines);
        fprintf(logfile, "%s Current shape position: x=%d, y=%d\n", timestamp_str, engine->curx, engine->cury);
        fprintf(logfile, "%s STATISTICS\n", timestamp_str);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[4], shapecount[shapenum[4]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[3], shapecount[shapenum[3]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[6], shapecount[shapenum[6]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[5], shapecount[shapenum[5]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[0], shapecount[shapenum[0]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[2], shapecount[shapenum[2]]);
-       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[1], shapecount[shapenum[1]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[4], game->shapecount[shapenum[4]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[3], game->shapecount[shapenum[3]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[6], game->shapecount[shapenum[6]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[5], game->shapecount[shapenum[5]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[0], game->shapecount[shapenum[0]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[2], game->shapecount[shapenum[2]]);
+       fprintf(logfile, "%s Shape(%d) = %d\n", timestamp_str, shapenum[1], game->shapecount[shapenum[1]]);
        fprintf(logfile, "%s Sum = %d\n", timestamp_str, sum);
        fprintf(logfile, "%s Score ratio = %d\n", timestamp_str, GETSCORE (engine->score) / sum);
        fprintf(logfile, "%s Efficiency = %d\n", timestamp_str, engine->status.efficiency);
-       newturn = FALSE;
+       game->newturn = FALSE;
    }
 
 }
@@ -425,14 +478,15 @@ static void err2 ()
    exit (EXIT_FAILURE);
 }
 
-void showplayerstats (engine_t *engine)
+void showplayerstats (const game_t *game)
 {
+   const engine_t *engine = &game->engine;
    fprintf (stderr,
 			"\n\t   PLAYER STATISTICS\n\n\t"
 			"Score       %11d\n\t"
 			"Efficiency  %11d\n\t"
 			"Score ratio %11d\n",
-			GETSCORE (engine->score),engine->status.efficiency,GETSCORE (engine->score) / getsum ());
+			GETSCORE (engine->score),engine->status.efficiency,GETSCORE (engine->score) / getsum (game));
 }
 
 static int cmpscores (const void *a,const void *b)
@@ -557,17 +611,44 @@ static void savescores(int score)
 
 static void showhelp ()
 {
-   fprintf (stderr,"USAGE: tint [-h] [-l level] [-n] [-d] [-b char]\n");
+   fprintf (stderr,"USAGE: tint [-h] [-l level] [-n] [-d] [-b char] [-r randomizer] [-A] [-H] [--weights file]\n"
+			"            [--beam n [--depth n] [--budget ms] [--table mb]]\n"
+			"            [--plan name [--depth n] [--rollouts n] [--candidates n] [--table mb]]\n"
+			"            [--simulate input [--seed n] [--shapes n]] [--record prefix]\n");
    fprintf (stderr,"  -h           Show this help message\n");
    fprintf (stderr,"  -l <level>   Specify the starting level (%d-%d)\n",MINLEVEL,MAXLEVEL);
    fprintf (stderr,"  -n           Draw next shape\n");
    fprintf (stderr,"  -d           Draw vertical dotted lines\n");
    fprintf (stderr,"  -b <char>    Use this character to draw blocks instead of spaces\n");
    fprintf (stderr,"  -s           Draw shadow of shape\n");
+   fprintf (stderr,"  -r <name>    Where the shapes come from: bag (default), shuffle or uniform\n");
+   fprintf (stderr,"  -A           Let the built-in bot play\n");
+   fprintf (stderr,"  -H           Show where the bot would put the shape, searching with --beam\n");
+   fprintf (stderr,"               boards (default %d) up to --depth shapes\n",HINTWIDTH);
+   fprintf (stderr,"  --weights <file>\n");
+   fprintf (stderr,"               Weights of the board features the bot plays with\n");
+   fprintf (stderr,"  --beam <n>   Let the bot search ahead keeping the n best boards\n");
+   fprintf (stderr,"  --plan <expectimax|rollouts>\n");
+   fprintf (stderr,"               Let the bot average over the shapes that can come instead\n");
+   fprintf (stderr,"  --depth <n>  Number of shapes the search or planner looks at (default %d)\n",DEPTH);
+   fprintf (stderr,"  --budget <ms>\n");
+   fprintf (stderr,"               Time limit of a search (default none)\n");
+   fprintf (stderr,"  --rollouts <n>\n");
+   fprintf (stderr,"               Rollouts per candidate placement (default %d)\n",ROLLOUTS);
+   fprintf (stderr,"  --candidates <n>\n");
+   fprintf (stderr,"               Placements of the current shape that get rollouts (default %d)\n",CANDIDATES);
+   fprintf (stderr,"  --table <mb> Size of the table of boards the search remembers, 0 = none (default %d)\n",TABLEMB);
+   fprintf (stderr,"  --simulate <bot|random|file>\n");
+   fprintf (stderr,"               Play a game without a terminal, as fast as possible, using the\n");
+   fprintf (stderr,"               built-in bot, random actions or the actions in a script file\n");
+   fprintf (stderr,"  --seed <n>   Seed for the shape sequence (and random actions)\n");
+   fprintf (stderr,"  --shapes <n> Stop the simulation after n shapes\n");
+   fprintf (stderr,"  --record <prefix>\n");
+   fprintf (stderr,"               Record every shape of the game in shards prefix-NNNNNN.shard\n");
    exit (EXIT_FAILURE);
 }
 
-static void parse_options (int argc,char *argv[])
+static void parse_options (options_t *options,int argc,char *argv[])
 {
    int i = 1;
    while (i < argc)
@@ -579,8 +660,8 @@ static void parse_options (int argc,char *argv[])
 		else if (strcmp (argv[i],"-l") == 0)
 		  {
 			 i++;
-			 if (i >= argc || !str2int (&level,argv[i])) showhelp ();
-			 if ((level < MINLEVEL) || (level > MAXLEVEL))
+			 if (i >= argc || !str2int (&options->level,argv[i])) showhelp ();
+			 if ((options->level < MINLEVEL) || (options->level > MAXLEVEL))
 			   {
 				  fprintf (stderr,"You must specify a level between %d and %d\n",MINLEVEL,MAXLEVEL);
 				  exit (EXIT_FAILURE);
@@ -588,9 +669,9 @@ static void parse_options (int argc,char *argv[])
 		  }
 		/* Show next? */
 		else if (strcmp (argv[i],"-n") == 0)
-		  shownext = TRUE;
+		  options->shownext = TRUE;
 		else if(strcmp(argv[i],"-d")==0)
-		  dottedlines = TRUE;
+		  options->dottedlines = TRUE;
 		else if(strcmp(argv[i], "-b")==0)
 		  {
 		    i++;
@@ -598,7 +679,83 @@ static void parse_options (int argc,char *argv[])
 		    blockchar = argv[i][0];
 		  }
 		else if (strcmp (argv[i],"-s") == 0)
-            shadow = TRUE;
+            options->shadow = TRUE;
+		else if (strcmp (argv[i],"-r") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2randomizer (&options->randomizer,argv[i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-A") == 0)
+		  options->autoplay = TRUE;
+		else if (strcmp (argv[i],"-H") == 0)
+		  options->hint = TRUE;
+		else if (strcmp (argv[i],"--weights") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!bot_load (&options->weights,argv[i])) exit (EXIT_FAILURE);
+		  }
+		else if (strcmp (argv[i],"--beam") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->width,argv[i]) || options->width < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--plan") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2plan (&options->kind,argv[i])) showhelp ();
+			 options->plan = TRUE;
+		  }
+		else if (strcmp (argv[i],"--rollouts") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->rollouts,argv[i]) || options->rollouts < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--candidates") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->candidates,argv[i]) || options->candidates < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--depth") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->depth,argv[i]) || options->depth < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--budget") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->budget,argv[i]) || options->budget < 0) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--table") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->table,argv[i]) || options->table < 0) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--simulate") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->simulate = argv[i];
+		  }
+		else if (strcmp (argv[i],"--record") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->record = argv[i];
+		  }
+		else if (strcmp (argv[i],"--seed") == 0)
+		  {
+			 int seed;
+			 i++;
+			 if (i >= argc || !str2int (&seed,argv[i]) || seed < 0) showhelp ();
+			 options->seed = seed;
+			 options->seeded = TRUE;
+		  }
+		else if (strcmp (argv[i],"--shapes") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&options->shapes,argv[i]) || options->shapes < 0) showhelp ();
+		  }
 		else
 		  {
 			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
@@ -606,9 +763,14 @@ static void parse_options (int argc,char *argv[])
 		  }
 		i++;
 	 }
+   if (options->width && options->plan)
+	 {
+		fprintf (stderr,"Choose either --beam or --plan\n");
+		exit (EXIT_FAILURE);
+	 }
 }
 
-static void choose_level ()
+static void choose_level (options_t *options)
 {
    char buf[NAMELEN];
 
@@ -618,48 +780,216 @@ static void choose_level ()
 		fgets (buf,NAMELEN - 1,stdin);
 		buf[strlen (buf) - 1] = '\0';
 	 }
-   while (!str2int (&level,buf) || level < MINLEVEL || level > MAXLEVEL);
+   while (!str2int (&options->level,buf) || options->level < MINLEVEL || options->level > MAXLEVEL);
+}
+
+/*
+ * Get the table of boards asked for on the command line, or NULL if there
+ * is none. Exits if there is not enough memory.
+ */
+static trans_t *usetable (const options_t *options)
+{
+   static trans_t table;
+   if (!options->table) return (NULL);
+   if (!trans_init (&table,(size_t) options->table << 20))
+	 {
+		fprintf (stderr,"Not enough memory for a table of %d MB\n",options->table);
+		exit (EXIT_FAILURE);
+	 }
+   return (&table);
+}
+
+/*
+ * Let the bot use a beam search or a planner if one was asked for on the
+ * command line, with a thread per processor. The planner draws its guesses
+ * from seed. Exits if there is not enough memory.
+ */
+static void usesearch (const options_t *options,input_t *input,beam_t *beam,planner_t *planner,unsigned int seed)
+{
+   if (options->width)
+	 {
+		if (!beam_init (beam,options->width,options->depth,pool_cpus (),options->budget * 1000L,&options->weights,usetable (options)))
+		  {
+			 fprintf (stderr,"Not enough memory for a beam of %d boards\n",options->width);
+			 exit (EXIT_FAILURE);
+		  }
+		input_beam (input,beam);
+	 }
+   else if (options->plan)
+	 {
+		if (!plan_init (planner,options->kind,options->depth,options->rollouts,options->candidates,pool_cpus (),options->budget * 1000L,
+						seed,&options->weights,usetable (options)))
+		  {
+			 fprintf (stderr,"Not enough memory for %d rollouts\n",options->rollouts * options->candidates);
+			 exit (EXIT_FAILURE);
+		  }
+		input_plan (input,planner);
+	 }
+}
+
+/*
+ * Record every shape of the game in the shards named on the command line,
+ * as game number id. Exits if that can't be done.
+ */
+static void userecord (const options_t *options,exporter_t *exporter,recorder_t *recorder,game_t *game,unsigned int id)
+{
+   if (!export_open (exporter,options->record,SHARDRECORDS))
+	 {
+		fprintf (stderr,"Could not start writing shards\n");
+		exit (EXIT_FAILURE);
+	 }
+   if (!export_start (exporter,recorder,game,id))
+	 {
+		fprintf (stderr,"No room for a hook to record the game\n");
+		exit (EXIT_FAILURE);
+	 }
+}
+
+/*
+ * Play a whole game without curses using the input named on the command
+ * line and print a summary to stdout. Returns the exit status.
+ */
+static int simulate (const options_t *options)
+{
+   game_t game;
+   input_t input;
+   beam_t beam;
+   planner_t planner;
+   trans_t *table = NULL;
+   simresult_t result;
+   FILE *script = NULL;
+   exporter_t exporter;
+   recorder_t recorder;
+   unsigned int seed = options->seed;
+
+   if (!options->seeded)
+	 {
+		rand_init ();
+		seed = rand_value (INT_MAX);
+	 }
+   if (strcmp (options->simulate,"bot") == 0)
+	 {
+		input_bot (&input,&options->weights);
+		usesearch (options,&input,&beam,&planner,~seed);
+	 }
+   else if (strcmp (options->simulate,"random") == 0)
+	 input_random (&input,seed);
+   else
+	 {
+		if ((script = fopen (options->simulate,"r")) == NULL)
+		  {
+			 fprintf (stderr,"Could not open script %s\n",options->simulate);
+			 return EXIT_FAILURE;
+		  }
+		input_script (&input,script);
+	 }
+   game_init (&game,options->level < MINLEVEL ? MINLEVEL : options->level,options->randomizer,seed);
+   game.engine.shadow = options->shadow;
+   if (options->record != NULL) userecord (options,&exporter,&recorder,&game,seed);
+   sim_play (&game,&input,options->shapes,&result);
+   if (script != NULL) fclose (script);
+   if (options->record != NULL)
+	 {
+		export_stop (&recorder);
+		if (!export_close (&exporter)) return EXIT_FAILURE;
+	 }
+
+   printf ("seed: %u\n",seed);
+   printf ("score: %d\n",result.score);
+   printf ("lines: %d\n",result.lines);
+   printf ("shapes: %d\n",result.shapes);
+   printf ("shapes/s: %.0f\n",result.seconds > 0 ? result.shapes / result.seconds : 0.0);
+   if (strcmp (options->simulate,"bot") == 0)
+	 {
+		if (options->width)
+		  {
+			 table = beam.table;
+			 beam_free (&beam);
+		  }
+		else if (options->plan)
+		  {
+			 printf ("%s/s: %.0f\n",options->kind == PLAN_ROLLOUTS ? "rollouts" : "boards",plan_speed (&planner));
+			 table = planner.table;
+			 plan_free (&planner);
+		  }
+		if (table != NULL)
+		  {
+			 printf ("table hits: %llu\n",(unsigned long long) atomic_load (&table->hits));
+			 printf ("table misses: %llu\n",(unsigned long long) atomic_load (&table->misses));
+			 trans_free (table);
+		  }
+	 }
+   return EXIT_SUCCESS;
 }
 
-static bool evaluate (engine_t *engine)
+/* Log what happens in the engine (hooked up to it in main ()) */
+static void logevent (const event_t *event,void *arg)
 {
+    static const char *MOVES[] = { "Move LEFT", NULL, "Move RIGHT", NULL, "Move DOWN" };
+    FILE *log = (FILE *) arg;
+    char timestamp_str[TIMESTAMP_BUFFER_SIZE];
+
+    get_timestamp_string(timestamp_str, sizeof(timestamp_str));
+    switch (event->type)
+    {
+        case EVENT_MOVE:
+            fprintf(log, "%s ACTION: %s from (x=%d, y=%d)\n", 
+                    timestamp_str, MOVES[event->u.move.action], event->u.move.fromx, event->u.move.fromy);
+            fprintf(log, "Action = %s on shape(%d)\n", ACTIONS_STRING[event->u.move.action], event->shape);
+            fprintf(log, "Result: shape now at (x=%d, y=%d)\n", event->x, event->y);
+            break;
+        case EVENT_ROTATE:
+            fprintf(log, "%s ACTION: ROTATE shape %d at (x=%d, y=%d)\n", 
+                    timestamp_str, event->shape, event->u.move.fromx, event->u.move.fromy);
+            fprintf(log, "Action = %s on shape(%d)\n", ACTIONS_STRING[event->u.move.action], event->shape);
+            fprintf(log, "Result: shape now at (x=%d, y=%d)\n", event->x, event->y);
+            break;
+        case EVENT_DROP:
+            fprintf(log, "%s ACTION: DROP shape %d from (x=%d, y=%d)\n", 
+                    timestamp_str, event->shape, event->u.move.fromx, event->u.move.fromy);
+            fprintf(log, "Action = %s on shape(%d)\n", ACTIONS_STRING[event->u.move.action], event->shape);
+            fprintf(log, "Drop completed: final position (x=%d, y=%d)\n", event->x, event->y);
+            break;
+        case EVENT_LOCK:
+            fprintf(log, "%s Shape %d landed at final position (x=%d, y=%d)\n", 
+                    timestamp_str, event->shape, event->x, event->y);
+            break;
+        case EVENT_LINES:
+            fprintf(log, "%s Lines cleared: %d lines\n", timestamp_str, event->u.lines.count);
+            break;
+        case EVENT_GAMEOVER:
+            fprintf(log, "%s GAME FINISHED at position: shape %d at (x=%d, y=%d)\n", 
+                    timestamp_str, event->shape, event->x, event->y);
+            fprintf(log, "%s Cause: Board full (game over)\n", timestamp_str);
+            break;
+        case EVENT_SPAWN:
+            break;
+    }
+}
+
+/* Let the game move on with game_step () or game_tick () and log the */
+/* turns and the falling shape (the engine events are logged by logevent ()) */
+static bool evaluate (game_t *game,int (*step) (game_t *))
+{
+    const engine_t *engine = &game->engine;
     bool finished = FALSE;
+    int y = engine->cury;
     char timestamp_str[TIMESTAMP_BUFFER_SIZE];
     
-    switch (engine_evaluate (engine))
+    switch (step (game))
     {
         /* game over (board full) */
         case -1:
-            if ((level < MAXLEVEL) && ((engine->status.droppedlines / 10) > level)) level++;
             finished = TRUE;
-            get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-            fprintf(logfile, "%s GAME FINISHED at position: shape %d at (x=%d, y=%d)\n", 
-                    timestamp_str, engine->curshape, engine->curx, engine->cury);
-            fprintf(logfile, "%s Cause: Board full (game over)\n", timestamp_str);
         break;
             /* shape at bottom, next one released */
         case 0:
-            if ((level < MAXLEVEL) && ((engine->status.droppedlines / 10) > level))
-            {
-                level++;
-                in_timeout (DELAY);
-            }
-            shapecount[engine->curshape]++;
             get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-            fprintf(logfile, "%s Shape %d landed at final position (x=%d, y=%d)\n", 
-                    timestamp_str, engine->curshape, engine->curx, engine->cury);
-            
-            if (engine->status.currentdroppedlines > 0) {
-                fprintf(logfile, "%s Lines cleared: %d lines\n", timestamp_str, 
-                        engine->status.currentdroppedlines);
-            }
-            
-            fprintf(logfile, "%s Turn[%d] = Finished\n", timestamp_str, turn);
-            newturn = TRUE;
-            turn++;
+            fprintf(logfile, "%s Turn[%d] = Finished\n", timestamp_str, game->turn - 1);
             break;
-            /* shape moved down one line */
+            /* shape moved down (or not, the clock ticks more often than that) */
         case 1:
+            if (engine->cury == y) break;
             get_timestamp_string(timestamp_str, sizeof(timestamp_str));
             fprintf(logfile, "%s Shape %d moved down to (x=%d, y=%d)\n", 
                     timestamp_str, engine->curshape, engine->curx, engine->cury);
@@ -676,25 +1006,55 @@ int main (int argc,char *argv[])
 {
    bool finished;
    int ch;
-   engine_t engine;
+   game_t game;
+   const engine_t *engine = &game.engine;
+   options_t options = { MINLEVEL - 1, FALSE, FALSE, FALSE, NULL, FALSE, 0, RANDOMIZER_BAG, 0, FALSE };
+   input_t input;
+   beam_t beam;
+   planner_t planner;
+   hint_t hint;
+   exporter_t exporter;
+   recorder_t recorder;
+   unsigned int seed;
+   action_t action;
    char timestamp_str[TIMESTAMP_BUFFER_SIZE];
    
+   /* Initialize */
+   finished = FALSE;
+   bot_defaults (&options.weights);
+   options.depth = DEPTH;
+   options.rollouts = ROLLOUTS;
+   options.candidates = CANDIDATES;
+   options.table = TABLEMB;
+   parse_options (&options,argc,argv);
+   if (options.simulate != NULL) return simulate (&options);
+
    /* Demander le nom du joueur en premier */
    get_player_name();
    
-   /* Initialize */
-   newturn = TRUE;
-   rand_init ();							/* must be called before engine_init () */
-   engine_init (&engine,score_function);	/* must be called before using engine.curshape */
-   finished = shownext = shadow = FALSE;
-   memset (shapecount,0,NUMSHAPES * sizeof (int));
-   shapecount[engine.curshape]++;
-   parse_options (argc,argv);				/* must be called after initializing variables */
-   engine.shadow = shadow;
-   if (level < MINLEVEL) choose_level ();
+   if (options.level < MINLEVEL) choose_level (&options);
+   rand_init ();							/* must be called before rand_value () */
+   seed = options.seeded ? options.seed : (unsigned int) rand_value (INT_MAX);
+   game_init (&game,options.level,options.randomizer,seed);
+   game.shownext = options.shownext;
+   game.dottedlines = options.dottedlines;
+   game.engine.shadow = options.shadow;
+   if (options.autoplay)
+	 {
+		input_bot (&input,&options.weights);
+		usesearch (&options,&input,&beam,&planner,~seed);
+	 }
+   /* hints are searched for all the time, so a planner would be too slow */
+   if (options.hint && !hint_start (&hint,&game.engine,options.width ? options.width : HINTWIDTH,options.depth,&options.weights))
+	 {
+		fprintf (stderr,"Could not start looking for hints\n");
+		exit (EXIT_FAILURE);
+	 }
+   if (options.record != NULL) userecord (&options,&exporter,&recorder,&game,seed);
    io_init ();
    /* Open log file */
    openlogfile();
+   engine_hook (&game.engine,EVENT_ALL & ~EVENT_BIT (EVENT_SPAWN),logevent,logfile);
    
    /* Log game start info with proper format */
    get_timestamp_string(timestamp_str, sizeof(timestamp_str));
@@ -714,42 +1074,49 @@ int main (int argc,char *argv[])
   fprintf(logfile, "Game ID: %llu\n", game_id);
    fprintf(logfile, "GAME STARTED at timestamp = %s\n", timestamp_str);
    fprintf(logfile, "Player name: %s\n", playername);
-   fprintf(logfile, "Starting level: %d\n", level);
+   fprintf(logfile, "Starting level: %d\n", game.level);
    fprintf(logfile, "Game options: shownext=%s, dottedlines=%s, shadow=%s\n", 
-           shownext ? "true" : "false", dottedlines ? "true" : "false", shadow ? "true" : "false");
+           game.shownext ? "true" : "false", game.dottedlines ? "true" : "false", game.engine.shadow ? "true" : "false");
    fprintf(logfile, "Block character: '%c'\n", blockchar);
+   if (options.autoplay) fprintf(logfile, "Autoplay: bot\n");
+   if (options.hint) fprintf(logfile, "Hints: beam %d, depth %d\n", options.width ? options.width : HINTWIDTH, options.depth);
+   if (options.autoplay && options.width) fprintf(logfile, "Search: beam %d, depth %d, budget %d ms\n", options.width, options.depth, options.budget);
+   if (options.autoplay && options.plan && options.kind == PLAN_ROLLOUTS)
+	 fprintf(logfile, "Search: rollouts, depth %d, %d rollouts, %d candidates\n", options.depth, options.rollouts, options.candidates);
+   else if (options.autoplay && options.plan)
+	 fprintf(logfile, "Search: expectimax, depth %d\n", options.depth);
    
    drawbackground ();
-   in_timeout (DELAY);
+   in_timeout (1000000 / TICKRATE);
    /* Main loop */
    do
      {
-         if (newturn) {
+         if (game.newturn) {
              get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-             fprintf(logfile, "Turn[%d] = Started\n", turn);
+             fprintf(logfile, "Turn[%d] = Started\n", game.turn);
              fprintf(logfile, "New shape(%d) spawned at (x=%d, y=%d)\n", 
-                     engine.curshape, engine.curx, engine.cury);
-             fprintf(logfile, "Turn[%d] timestamp = %s\n", turn, timestamp_str);
-             fprintf(logfile, "Level = %d\n", level);
-             fprintf(logfile, "Score = %d\n", GETSCORE (engine.score));
-             fprintf(logfile, "Full lines = %d\n", engine.status.droppedlines);
+                     engine->curshape, engine->curx, engine->cury);
+             fprintf(logfile, "Turn[%d] timestamp = %s\n", game.turn, timestamp_str);
+             fprintf(logfile, "Level = %d\n", game.level);
+             fprintf(logfile, "Score = %d\n", GETSCORE (engine->score));
+             fprintf(logfile, "Full lines = %d\n", engine->status.droppedlines);
              fprintf(logfile, "Current shape = %d at position (x=%d, y=%d)\n", 
-                     engine.curshape, engine.curx, engine.cury);
-             fprintf(logfile, "Next shape = %d\n", engine.nextshape);
-             fprintf(logfile, "Drop count this turn = %d\n", engine.status.dropcount);
-             fprintf(logfile, "Lines dropped this turn = %d\n", engine.status.currentdroppedlines);
+                     engine->curshape, engine->curx, engine->cury);
+             fprintf(logfile, "Next shape = %d\n", engine->nextshape);
+             fprintf(logfile, "Drop count this turn = %d\n", engine->status.dropcount);
+             fprintf(logfile, "Lines dropped this turn = %d\n", engine->status.currentdroppedlines);
              fprintf(logfile, "STATISTICS\n");
              for (int i = 0; i < NUMSHAPES; i++) {
-                 fprintf(logfile, "Shape(%d) = %d\n", i, shapecount[i]);
+                 fprintf(logfile, "Shape(%d) = %d\n", i, game.shapecount[i]);
              }
-             fprintf(logfile, "Sum = %d\n", getsum());
-             fprintf(logfile, "Score ratio = %d\n", GETSCORE (engine.score) / getsum());
-             fprintf(logfile, "Efficiency = %d\n", engine.status.efficiency);
-             newturn = FALSE;
+             fprintf(logfile, "Sum = %d\n", getsum (&game));
+             fprintf(logfile, "Score ratio = %d\n", GETSCORE (engine->score) / getsum (&game));
+             fprintf(logfile, "Efficiency = %d\n", engine->status.efficiency);
+             game.newturn = FALSE;
         }
 		/* draw shape */
-		showstatus (&engine);
-		drawboard (engine.board);
+		showstatus (&game);
+		drawboard (&game,options.hint ? &hint : NULL);
 		out_refresh ();
 		/* Check if user pressed a key */
 		if ((ch = in_getch ()) != ERR)
@@ -758,70 +1125,43 @@ int main (int argc,char *argv[])
 			   {
 				case 'j':
 				case KEY_LEFT:
-				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-				  fprintf(logfile, "%s ACTION: Move LEFT from (x=%d, y=%d)\n", 
-				          timestamp_str, engine.curx, engine.cury);
-				  engine_move (&engine,ACTION_LEFT);
-				  fprintf(logfile, "Result: shape now at (x=%d, y=%d)\n", 
-				          engine.curx, engine.cury);
+				  game_move (&game,ACTION_LEFT);
 				  break;
 				case 'k':
 				case KEY_UP:
 				case '\n':
-				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-				  fprintf(logfile, "%s ACTION: ROTATE shape %d at (x=%d, y=%d)\n", 
-				          timestamp_str, engine.curshape, engine.curx, engine.cury);
-				  engine_move (&engine,ACTION_ROTATE);
-				  fprintf(logfile, "Result: shape now at (x=%d, y=%d)\n", 
-				          engine.curx, engine.cury);
+				  game_move (&game,ACTION_ROTATE);
 				  break;
 				case 'l':
 				case KEY_RIGHT:
-				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-				  fprintf(logfile, "%s ACTION: Move RIGHT from (x=%d, y=%d)\n", 
-				          timestamp_str, engine.curx, engine.cury);
-				  engine_move (&engine,ACTION_RIGHT);
-				  fprintf(logfile, "Result: shape now at (x=%d, y=%d)\n", 
-				          engine.curx, engine.cury);
+				  game_move (&game,ACTION_RIGHT);
 				  break;
 				case KEY_DOWN:
-				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-				  fprintf(logfile, "%s ACTION: Move DOWN from (x=%d, y=%d)\n", 
-				          timestamp_str, engine.curx, engine.cury);
-				  engine_move (&engine,ACTION_DOWN);
-				  fprintf(logfile, "Result: shape now at (x=%d, y=%d)\n", 
-				          engine.curx, engine.cury);
+				  game_move (&game,ACTION_DOWN);
 				  break;
 				case ' ':
-				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-				  fprintf(logfile, "%s ACTION: DROP shape %d from (x=%d, y=%d)\n", 
-				          timestamp_str, engine.curshape, engine.curx, engine.cury);
-				  engine_move (&engine,ACTION_DROP);
-				  fprintf(logfile, "Drop completed: final position (x=%d, y=%d)\n", 
-				          engine.curx, engine.cury);
-				  finished = evaluate(&engine);          /* prevent key press after drop */
+				  game_move (&game,ACTION_DROP);
+				  finished = evaluate(&game,game_step);          /* prevent key press after drop */
 				  break;
 				  /* show next piece */
 				case 's':
 				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
 				  fprintf(logfile, "%s Show next piece enabled\n", timestamp_str);
-				  shownext = TRUE;
+				  game.shownext = TRUE;
 				  break;
 				  /* toggle dotted lines */
 				case 'd':
-				  dottedlines = !dottedlines;
+				  game.dottedlines = !game.dottedlines;
 				  get_timestamp_string(timestamp_str, sizeof(timestamp_str));
 				  fprintf(logfile, "%s Dotted lines toggled: %s\n", timestamp_str, 
-				          dottedlines ? "ON" : "OFF");
+				          game.dottedlines ? "ON" : "OFF");
 				  break;
 				  /* next level */
 				case 'a':
-				  if (level < MAXLEVEL)
+				  if (game_setlevel (&game,game.level + 1))
 					{
-					   level++;
-					   in_timeout (DELAY);
 					   get_timestamp_string(timestamp_str, sizeof(timestamp_str));
-					   fprintf(logfile, "%s Level increased to %d\n", timestamp_str, level);
+					   fprintf(logfile, "%s Level increased to %d\n", timestamp_str, game.level);
 					}
 				  else out_beep ();
 				  break;
@@ -851,18 +1191,27 @@ int main (int argc,char *argv[])
 			   }
 			 in_flush ();
 		  }
+		/* the bot plays one action per frame, the shape doesn't fall meanwhile */
+		else if (options.autoplay && input.next (&input,&game,&action))
+		  {
+			 game_move (&game,action);
+			 if (action == ACTION_DROP) finished = evaluate(&game,game_step);
+		  }
 		else
-		  finished = evaluate(&engine);
+		  finished = evaluate(&game,game_tick);
 	 }
    while (!finished);
+   if (options.hint) hint_stop (&hint);
+   if (options.record != NULL) export_stop (&recorder);
    /* Restore console settings and exit */
    io_close ();
+   if (options.record != NULL) export_close (&exporter);
    
    /* Log game end information */
    get_timestamp_string(timestamp_str, sizeof(timestamp_str));
    fprintf(logfile, "GAME FINISHED at timestamp = %s\n", timestamp_str);
    fprintf(logfile, "Final position: shape %d at (x=%d, y=%d)\n", 
-           engine.curshape, engine.curx, engine.cury);
+           engine->curshape, engine->curx, engine->cury);
    if (ch == 'q') {
        fprintf(logfile, "Cause: Player quit\n");
    }
@@ -870,8 +1219,9 @@ int main (int argc,char *argv[])
    /* Don't bother the player if he want's to quit */
    if (ch != 'q')
 	 {
-		showplayerstats (&engine);
-		savescores (GETSCORE (engine.score));
+		showplayerstats (&game);
+		/* the bot doesn't get into the high scores */
+		if (!options.autoplay) savescores (GETSCORE (engine->score));
 	 }
    closelogfile();
    exit (EXIT_SUCCESS);
@@ -0,0 +1,179 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "typedefs.h"
+#include "trans.h"
+
+/*
+ * Macros
+ */
+
+/* Layout of the info word of an entry */
+#define USED		((uint64_t) 1 << 63)
+#define AGE(info)	((unsigned int) ((info) >> 8) & 0xff)
+#define DEPTH(info)	((int) ((info) & 0xff))
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up an empty table of at most the specified size in bytes. Returns
+ * FALSE if there is not enough memory.
+ */
+bool trans_init (trans_t *table,size_t bytes)
+{
+   size_t buckets = 1;
+   while (buckets * 2 * TRANSWAYS * sizeof (transentry_t) <= bytes) buckets *= 2;
+   table->mask = buckets - 1;
+   if ((table->entry = malloc (buckets * TRANSWAYS * sizeof (transentry_t))) == NULL) return (FALSE);
+   trans_clear (table);
+   return (TRUE);
+}
+
+/*
+ * Release the memory of a table
+ */
+void trans_free (trans_t *table)
+{
+   free (table->entry);
+   table->entry = NULL;
+}
+
+/*
+ * Empty a table and reset its counters. Not safe while other threads use it.
+ */
+void trans_clear (trans_t *table)
+{
+   unsigned long i;
+   for (i = 0; i < (table->mask + 1) * TRANSWAYS; i++)
+	 {
+		atomic_init (&table->entry[i].check,0);
+		atomic_init (&table->entry[i].value,0);
+		atomic_init (&table->entry[i].info,0);
+	 }
+   atomic_init (&table->age,0);
+   atomic_init (&table->hits,0);
+   atomic_init (&table->misses,0);
+   atomic_init (&table->stores,0);
+   atomic_init (&table->replaced,0);
+}
+
+/*
+ * Start a new search: entries stored before are the first to be replaced
+ */
+void trans_age (trans_t *table)
+{
+   atomic_fetch_add_explicit (&table->age,1,memory_order_relaxed);
+}
+
+/* Read an entry. Returns FALSE if it is empty (or was half written) */
+static bool readentry (transentry_t *entry,uint64_t *key,uint64_t *value,uint64_t *info)
+{
+   *value = atomic_load_explicit (&entry->value,memory_order_relaxed);
+   *info = atomic_load_explicit (&entry->info,memory_order_relaxed);
+   *key = atomic_load_explicit (&entry->check,memory_order_relaxed) ^ *value ^ *info;
+   return ((*info & USED) != 0);
+}
+
+/*
+ * Look up the value stored for a key, and the depth it was worked out to.
+ * Returns FALSE if it isn't in the table.
+ */
+bool trans_probe (trans_t *table,uint64_t key,double *value,int *depth)
+{
+   transentry_t *entry = table->entry + (key & table->mask) * TRANSWAYS;
+   uint64_t k,v,info;
+   int i;
+   for (i = 0; i < TRANSWAYS; i++)
+	 if (readentry (entry + i,&k,&v,&info) && k == key)
+	   {
+		  memcpy (value,&v,sizeof (*value));
+		  *depth = DEPTH (info);
+		  atomic_fetch_add_explicit (&table->hits,1,memory_order_relaxed);
+		  return (TRUE);
+	   }
+   atomic_fetch_add_explicit (&table->misses,1,memory_order_relaxed);
+   return (FALSE);
+}
+
+/*
+ * Store the value of a key, worked out to the given depth (0-255). If the
+ * key is already there it is only replaced by a value at least as deep.
+ * Otherwise an empty entry is taken, or else the one of an older search
+ * with the lowest depth.
+ */
+void trans_store (trans_t *table,uint64_t key,double value,int depth)
+{
+   transentry_t *entry = table->entry + (key & table->mask) * TRANSWAYS,*victim = NULL;
+   unsigned int age = atomic_load_explicit (&table->age,memory_order_relaxed) & 0xff;
+   uint64_t k,v,info;
+   int i,worth,least = 0;
+   bool other = FALSE;
+   for (i = 0; i < TRANSWAYS; i++)
+	 {
+		if (!readentry (entry + i,&k,&v,&info))
+		  {
+			 /* an empty entry will do unless the key turns up further on */
+			 if (victim == NULL || other)
+			   {
+				  victim = entry + i;
+				  least = -1;
+				  other = FALSE;
+			   }
+			 continue;
+		  }
+		if (k == key)
+		  {
+			 if (depth < DEPTH (info)) return;
+			 victim = entry + i;
+			 other = FALSE;
+			 break;
+		  }
+		/* entries of the current search are worth more than any older one */
+		worth = DEPTH (info) + (AGE (info) == age ? 256 : 0);
+		if (victim == NULL || worth < least)
+		  {
+			 victim = entry + i;
+			 least = worth;
+			 other = TRUE;
+		  }
+	 }
+   memcpy (&v,&value,sizeof (v));
+   info = USED | (uint64_t) age << 8 | (uint64_t) (depth & 0xff);
+   atomic_store_explicit (&victim->value,v,memory_order_relaxed);
+   atomic_store_explicit (&victim->info,info,memory_order_relaxed);
+   atomic_store_explicit (&victim->check,key ^ v ^ info,memory_order_relaxed);
+   atomic_fetch_add_explicit (&table->stores,1,memory_order_relaxed);
+   if (other) atomic_fetch_add_explicit (&table->replaced,1,memory_order_relaxed);
+}
@@ -0,0 +1,114 @@
+#ifndef TRANS_H
+#define TRANS_H
+
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "typedefs.h"		/* bool */
+
+/*
+ * Macros
+ */
+
+/* Number of entries a key can go in */
+#define TRANSWAYS	4
+
+/*
+ * Type definitions
+ */
+
+/*
+ * An entry of the table. The check word is the key xor'ed with the other
+ * two words, so a reader that raced a writer and got half of each doesn't
+ * take it for the key it is looking for.
+ */
+typedef struct
+{
+   atomic_ullong check;
+   atomic_ullong value;				/* bits of the value */
+   atomic_ullong info;				/* used bit, age and depth */
+} transentry_t;
+
+/*
+ * A fixed-size table of values worked out for positions (keyed by their
+ * Zobrist hash), shared by any number of threads without locks
+ */
+typedef struct
+{
+   transentry_t *entry;				/* TRANSWAYS entries per bucket */
+   unsigned long mask;				/* number of buckets - 1 */
+   atomic_uint age;					/* entries from before the last trans_age () go first */
+   atomic_ullong hits,misses;		/* probes that found their key or not */
+   atomic_ullong stores,replaced;	/* entries stored, and how many of them pushed another key out */
+} trans_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Set up an empty table of at most the specified size in bytes. Returns
+ * FALSE if there is not enough memory.
+ */
+bool trans_init (trans_t *table,size_t bytes);
+
+/*
+ * Release the memory of a table
+ */
+void trans_free (trans_t *table);
+
+/*
+ * Empty a table and reset its counters. Not safe while other threads use it.
+ */
+void trans_clear (trans_t *table);
+
+/*
+ * Start a new search: entries stored before are the first to be replaced
+ */
+void trans_age (trans_t *table);
+
+/*
+ * Look up the value stored for a key, and the depth it was worked out to.
+ * Returns FALSE if it isn't in the table.
+ */
+bool trans_probe (trans_t *table,uint64_t key,double *value,int *depth);
+
+/*
+ * Store the value of a key, worked out to the given depth (0-255). If the
+ * key is already there it is only replaced by a value at least as deep.
+ * Otherwise an empty entry is taken, or else the one of an older search
+ * with the lowest depth.
+ */
+void trans_store (trans_t *table,uint64_t key,double value,int depth);
+
+#endif	/* #ifndef TRANS_H */
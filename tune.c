@@ -0,0 +1,754 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-tune evolves the weights of the bot with CMA-ES or a genetic
+ * algorithm. Every candidate plays the same headless games (the same
+ * seeds, shapes and scoring as tint), on all processors, and is worth its
+ * mean score. The state of the search is saved after every generation, so
+ * a run that was interrupted can go on where it stopped, and the results
+ * don't depend on the number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "game.h"
+#include "sim.h"
+#include "bot.h"
+#include "pool.h"
+
+/*
+ * Macros
+ */
+
+/* Number of weights that are tuned */
+#define DIM			NUMFEATURES
+
+/* Genetic algorithm: chance that a weight of a child is mutated, how much, */
+/* and the number of members a parent is the best of */
+#define MUTATION	0.2
+#define MUTATIONSIZE 0.2
+#define TOURNAMENT	3
+
+/* Spread of the first generation around the weights the search starts from */
+#define SPREAD		0.3
+
+/* First line of a checkpoint */
+#define MAGIC		"tint-tune checkpoint 1"
+
+/*
+ * Type definitions
+ */
+
+/* How the weights are evolved */
+typedef enum
+{
+   METHOD_CMAES,					/* covariance matrix adaptation evolution strategy */
+   METHOD_GA						/* genetic algorithm */
+} method_t;
+
+#define NUMMETHODS	2
+
+/* Command line options */
+typedef struct
+{
+   method_t method;
+   int generations;				/* stop after this many generations (0 = never) */
+   int population;				/* candidates per generation */
+   int games;					/* games every candidate plays */
+   int shapes;					/* stop a game after this many shapes (0 = never) */
+   unsigned int seed;
+   int threads;
+   randomizer_t randomizer;
+   int level;
+   weights_t weights;			/* where the search starts */
+   const char *checkpoint;		/* state of the search is kept here (NULL = nowhere) */
+   const char *output;			/* best weights so far are kept here (NULL = nowhere) */
+} options_t;
+
+/*
+ * State of the search, i.e. everything that is saved in a checkpoint. The
+ * candidates are kept at a length of about one: the bot only compares sums
+ * of weights, so it plays the same with any multiple of them.
+ */
+typedef struct
+{
+   method_t method;
+   int generation;					/* generations done */
+   int population;
+   unsigned int rng;				/* random generator of the candidates */
+   double (*member)[DIM];			/* candidates of the last generation */
+   double *fitness;					/* ... and their mean scores */
+   double best[DIM];				/* best candidate so far */
+   double bestfitness;
+   /* CMA-ES */
+   double mean[DIM];				/* center of the distribution */
+   double sigma;					/* step size */
+   double c[DIM][DIM];				/* covariance matrix */
+   double pc[DIM],ps[DIM];			/* evolution paths of c and of sigma */
+} state_t;
+
+/* A generation being played */
+typedef struct
+{
+   const options_t *options;
+   const state_t *state;
+   int first;						/* first member that plays */
+   int *scores;						/* score of every game */
+   int *shapes;						/* shapes of every game */
+} generation_t;
+
+/*
+ * Global variables
+ */
+
+static const char *METHODS_STRING[] = { "cmaes", "ga" };
+
+/*
+ * Functions
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-tune [-h] [--method name] [--generations n] [--population n] [--games n]\n"
+			"                 [--shapes n] [--seed n] [--threads n] [--randomizer name] [--level n]\n"
+			"                 [--weights file] [--checkpoint file] [--output file]\n");
+   fprintf (stderr,"  -h             Show this help message\n");
+   fprintf (stderr,"  --method <cmaes|ga>\n");
+   fprintf (stderr,"                 CMA-ES or a genetic algorithm (default cmaes)\n");
+   fprintf (stderr,"  --generations <n>\n");
+   fprintf (stderr,"                 Stop after n generations, 0 = never (default 50)\n");
+   fprintf (stderr,"  --population <n>\n");
+   fprintf (stderr,"                 Candidates per generation (default 16)\n");
+   fprintf (stderr,"  --games <n>    Games every candidate plays (default 32)\n");
+   fprintf (stderr,"  --shapes <n>   Stop a game after n shapes, 0 = never (default 1000)\n");
+   fprintf (stderr,"  --seed <n>     Seed of the games and of the search (default 1)\n");
+   fprintf (stderr,"  --threads <n>  Number of threads (default: one per processor)\n");
+   fprintf (stderr,"  --randomizer <bag|shuffle|uniform>\n");
+   fprintf (stderr,"                 Where the shapes come from (default bag)\n");
+   fprintf (stderr,"  --level <n>    Level the games start at (%d-%d, default %d)\n",MINLEVEL,MAXLEVEL,MINLEVEL);
+   fprintf (stderr,"  --weights <file>\n");
+   fprintf (stderr,"                 Weights the search starts from (default: the bot's own)\n");
+   fprintf (stderr,"  --checkpoint <file>\n");
+   fprintf (stderr,"                 Save the search here after every generation, and go on\n");
+   fprintf (stderr,"                 from it if it is already there\n");
+   fprintf (stderr,"  --output <file>\n");
+   fprintf (stderr,"                 Save the best weights here after every generation\n");
+   fprintf (stderr,"The progress and then the best weights are printed to stdout, which can be\n"
+			"read back with --weights\n");
+   exit (EXIT_FAILURE);
+}
+
+static void parse_options (options_t *options,int argc,char *argv[])
+{
+   int i = 1,n;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-h") == 0)
+		  showhelp ();
+		else if (strcmp (argv[i],"--method") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 for (n = 0; n < NUMMETHODS && strcmp (argv[i],METHODS_STRING[n]) != 0; n++) ;
+			 if (n == NUMMETHODS) showhelp ();
+			 options->method = n;
+		  }
+		else if (strcmp (argv[i],"--randomizer") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2randomizer (&options->randomizer,argv[i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--weights") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!bot_load (&options->weights,argv[i])) exit (EXIT_FAILURE);
+		  }
+		else if (strcmp (argv[i],"--checkpoint") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->checkpoint = argv[i];
+		  }
+		else if (strcmp (argv[i],"--output") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 options->output = argv[i];
+		  }
+		else if (i + 1 < argc && str2int (&n,argv[i + 1]) && n >= 0)
+		  {
+			 if (strcmp (argv[i],"--generations") == 0)
+			   options->generations = n;
+			 else if (strcmp (argv[i],"--population") == 0 && n >= 4)
+			   options->population = n;
+			 else if (strcmp (argv[i],"--games") == 0 && n > 0)
+			   options->games = n;
+			 else if (strcmp (argv[i],"--shapes") == 0)
+			   options->shapes = n;
+			 else if (strcmp (argv[i],"--seed") == 0)
+			   options->seed = n;
+			 else if (strcmp (argv[i],"--threads") == 0 && n > 0)
+			   options->threads = n;
+			 else if (strcmp (argv[i],"--level") == 0 && n >= MINLEVEL && n <= MAXLEVEL)
+			   options->level = n;
+			 else
+			   {
+				  fprintf (stderr,"Invalid option -- %s %s\n",argv[i],argv[i + 1]);
+				  showhelp ();
+			   }
+			 i++;
+		  }
+		else
+		  {
+			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
+			 showhelp ();
+		  }
+		i++;
+	 }
+}
+
+/* Random number in (0,1) */
+static double uniform (unsigned int *rng)
+{
+   return ((rand_value_r (rng,1 << 30) + 0.5) / (1 << 30));
+}
+
+/* Random number from the standard normal distribution (Box-Muller) */
+static double gaussian (unsigned int *rng)
+{
+   double u = uniform (rng),v = uniform (rng);
+   return (sqrt (-2 * log (u)) * cos (2 * M_PI * v));
+}
+
+/* Scale a vector to a length of one */
+static void normalize (double *x)
+{
+   double length = 0;
+   int i;
+   for (i = 0; i < DIM; i++) length += x[i] * x[i];
+   length = sqrt (length);
+   if (length > 0)
+	 for (i = 0; i < DIM; i++) x[i] /= length;
+}
+
+static void vector2weights (weights_t *weights,const double *x)
+{
+   int i;
+   for (i = 0; i < DIM; i++) weights->weight[i] = x[i];
+}
+
+/*
+ * Eigenvalues and eigenvectors of a symmetric matrix (cyclic Jacobi):
+ * a = b diag (d) b', with the eigenvectors in the columns of b
+ */
+static void eigen (const double a[DIM][DIM],double b[DIM][DIM],double *d)
+{
+   double m[DIM][DIM],off,theta,t,c,s,mp,mq;
+   int i,j,k,sweep;
+   memcpy (m,a,sizeof (m));
+   for (i = 0; i < DIM; i++)
+	 for (j = 0; j < DIM; j++) b[i][j] = i == j;
+   for (sweep = 0; sweep < 50; sweep++)
+	 {
+		for (off = 0, i = 0; i < DIM; i++)
+		  for (j = i + 1; j < DIM; j++) off += m[i][j] * m[i][j];
+		if (off < 1e-30) break;
+		for (i = 0; i < DIM; i++)
+		  for (j = i + 1; j < DIM; j++)
+			{
+			   if (m[i][j] == 0) continue;
+			   /* rotate rows and columns i and j so that m[i][j] becomes 0 */
+			   theta = (m[j][j] - m[i][i]) / (2 * m[i][j]);
+			   t = (theta >= 0 ? 1 : -1) / (fabs (theta) + sqrt (theta * theta + 1));
+			   c = 1 / sqrt (t * t + 1);
+			   s = t * c;
+			   for (k = 0; k < DIM; k++)
+				 {
+					mp = m[k][i];
+					mq = m[k][j];
+					m[k][i] = c * mp - s * mq;
+					m[k][j] = s * mp + c * mq;
+				 }
+			   for (k = 0; k < DIM; k++)
+				 {
+					mp = m[i][k];
+					mq = m[j][k];
+					m[i][k] = c * mp - s * mq;
+					m[j][k] = s * mp + c * mq;
+				 }
+			   for (k = 0; k < DIM; k++)
+				 {
+					mp = b[k][i];
+					mq = b[k][j];
+					b[k][i] = c * mp - s * mq;
+					b[k][j] = s * mp + c * mq;
+				 }
+			}
+	 }
+   for (i = 0; i < DIM; i++) d[i] = m[i][i] > 0 ? m[i][i] : 0;
+}
+
+/* Set up a new search around the weights on the command line */
+static void start (state_t *state,const options_t *options)
+{
+   double x[DIM];
+   int i,j;
+   state->method = options->method;
+   state->generation = 0;
+   state->population = options->population;
+   state->rng = rand_seed (options->seed,0);
+   state->bestfitness = -1;
+   for (i = 0; i < DIM; i++) x[i] = options->weights.weight[i];
+   normalize (x);
+   memcpy (state->best,x,sizeof (x));
+   /* CMA-ES samples the first generation itself */
+   memcpy (state->mean,x,sizeof (x));
+   state->sigma = SPREAD;
+   for (i = 0; i < DIM; i++)
+	 {
+		for (j = 0; j < DIM; j++) state->c[i][j] = i == j;
+		state->pc[i] = state->ps[i] = 0;
+	 }
+   /* the genetic algorithm starts with the weights and mutants of them */
+   for (i = 0; i < state->population; i++)
+	 {
+		for (j = 0; j < DIM; j++) state->member[i][j] = x[j] + (i ? SPREAD * gaussian (&state->rng) : 0);
+		normalize (state->member[i]);
+		state->fitness[i] = 0;
+	 }
+}
+
+/* Write a vector to a checkpoint */
+static void putvector (FILE *fp,const char *name,const double *x)
+{
+   int i;
+   fprintf (fp,"%s",name);
+   for (i = 0; i < DIM; i++) fprintf (fp," %.17g",x[i]);
+   fprintf (fp,"\n");
+}
+
+/* Read a vector from a checkpoint. Returns FALSE if it isn't there */
+static bool getvector (FILE *fp,const char *name,double *x)
+{
+   char word[32];
+   int i;
+   if (fscanf (fp," %31s",word) != 1 || strcmp (word,name) != 0) return (FALSE);
+   for (i = 0; i < DIM; i++)
+	 if (fscanf (fp,"%lf",&x[i]) != 1) return (FALSE);
+   return (TRUE);
+}
+
+/*
+ * Save the state of the search along with the options the games depend on.
+ * The file is written next to the old one and then renamed, so there always
+ * is a whole checkpoint. Returns FALSE (and tells why on stderr) if it fails.
+ */
+static bool save (const state_t *state,const options_t *options)
+{
+   char *temp;
+   FILE *fp;
+   int i;
+   bool ok;
+   if ((temp = malloc (strlen (options->checkpoint) + 5)) == NULL) return (FALSE);
+   sprintf (temp,"%s.new",options->checkpoint);
+   if ((fp = fopen (temp,"w")) == NULL)
+	 {
+		fprintf (stderr,"Could not create checkpoint %s\n",temp);
+		free (temp);
+		return (FALSE);
+	 }
+   fprintf (fp,"%s\n",MAGIC);
+   fprintf (fp,"method %s\n",METHODS_STRING[state->method]);
+   fprintf (fp,"population %d\n",state->population);
+   fprintf (fp,"games %d\n",options->games);
+   fprintf (fp,"shapes %d\n",options->shapes);
+   fprintf (fp,"seed %u\n",options->seed);
+   fprintf (fp,"randomizer %s\n",RANDOMIZERS_STRING[options->randomizer]);
+   fprintf (fp,"level %d\n",options->level);
+   fprintf (fp,"generation %d\n",state->generation);
+   fprintf (fp,"rng %u\n",state->rng);
+   fprintf (fp,"bestfitness %.17g\n",state->bestfitness);
+   putvector (fp,"best",state->best);
+   putvector (fp,"mean",state->mean);
+   fprintf (fp,"sigma %.17g\n",state->sigma);
+   for (i = 0; i < DIM; i++) putvector (fp,"c",state->c[i]);
+   putvector (fp,"pc",state->pc);
+   putvector (fp,"ps",state->ps);
+   for (i = 0; i < state->population; i++)
+	 {
+		fprintf (fp,"fitness %.17g\n",state->fitness[i]);
+		putvector (fp,"member",state->member[i]);
+	 }
+   ok = fclose (fp) == 0;
+   if (ok && rename (temp,options->checkpoint) != 0) ok = FALSE;
+   if (!ok) fprintf (stderr,"Could not write checkpoint %s\n",options->checkpoint);
+   free (temp);
+   return (ok);
+}
+
+/*
+ * Go on with the search saved in the checkpoint. Returns FALSE if there is
+ * no checkpoint yet, and exits if it can't be used with these options.
+ */
+static bool resume (state_t *state,const options_t *options)
+{
+   char line[128],method[32],randomizer[32];
+   int population,games,shapes,level,i;
+   unsigned int seed;
+   bool ok;
+   FILE *fp;
+   if ((fp = fopen (options->checkpoint,"r")) == NULL) return (FALSE);
+   ok = fgets (line,sizeof (line),fp) != NULL && strncmp (line,MAGIC,strlen (MAGIC)) == 0 &&
+	 fscanf (fp," method %31s population %d games %d shapes %d seed %u randomizer %31s level %d",
+			 method,&population,&games,&shapes,&seed,randomizer,&level) == 7;
+   /* the fitness of the candidates only means something for the same games */
+   if (ok && (strcmp (method,METHODS_STRING[options->method]) != 0 || population != options->population ||
+			  games != options->games || shapes != options->shapes || seed != options->seed ||
+			  strcmp (randomizer,RANDOMIZERS_STRING[options->randomizer]) != 0 || level != options->level))
+	 {
+		fprintf (stderr,"Checkpoint %s was made with other options: --method %s --population %d --games %d\n"
+				 "--shapes %d --seed %u --randomizer %s --level %d\n",
+				 options->checkpoint,method,population,games,shapes,seed,randomizer,level);
+		exit (EXIT_FAILURE);
+	 }
+   ok = ok && fscanf (fp," generation %d rng %u bestfitness %lf",&state->generation,&state->rng,&state->bestfitness) == 3 &&
+	 getvector (fp,"best",state->best) && getvector (fp,"mean",state->mean) &&
+	 fscanf (fp," sigma %lf",&state->sigma) == 1;
+   for (i = 0; ok && i < DIM; i++) ok = getvector (fp,"c",state->c[i]);
+   ok = ok && getvector (fp,"pc",state->pc) && getvector (fp,"ps",state->ps);
+   for (i = 0; ok && i < population; i++)
+	 ok = fscanf (fp," fitness %lf",&state->fitness[i]) == 1 && getvector (fp,"member",state->member[i]);
+   fclose (fp);
+   if (!ok)
+	 {
+		fprintf (stderr,"Invalid checkpoint %s\n",options->checkpoint);
+		exit (EXIT_FAILURE);
+	 }
+   state->method = options->method;
+   state->population = population;
+   return (TRUE);
+}
+
+/* Play the index'th game of a generation: game (index % games) of member (first + index / games) */
+static void play (void *arg,unsigned long index)
+{
+   generation_t *generation = arg;
+   const options_t *options = generation->options;
+   const state_t *state = generation->state;
+   weights_t weights;
+   game_t game;
+   input_t input;
+   simresult_t result;
+   vector2weights (&weights,state->member[generation->first + index / options->games]);
+   game_init (&game,options->level,options->randomizer,rand_seed (options->seed,index % options->games));
+   input_bot (&input,&weights);
+   sim_play (&game,&input,options->shapes,&result);
+   generation->scores[index] = result.score;
+   generation->shapes[index] = result.shapes;
+}
+
+/*
+ * Let the members from first on play their games and set their fitness.
+ * Returns the number of shapes played.
+ */
+static unsigned long evaluate (state_t *state,const options_t *options,int first,int *scores,int *shapes)
+{
+   generation_t generation;
+   unsigned long i,n = (unsigned long) (state->population - first) * options->games,total = 0;
+   double sum;
+   int j;
+   generation.options = options;
+   generation.state = state;
+   generation.first = first;
+   generation.scores = scores;
+   generation.shapes = shapes;
+   pool_run (options->threads,n,play,&generation);
+   /* added up in order, so the threads don't change the outcome */
+   for (j = first; j < state->population; j++)
+	 {
+		for (sum = 0, i = (j - first) * options->games; i < (j - first + 1) * options->games; i++)
+		  {
+			 sum += scores[i];
+			 total += shapes[i];
+		  }
+		state->fitness[j] = sum / options->games;
+	 }
+   return (total);
+}
+
+/* Sample a generation of CMA-ES around the mean */
+static void sample (state_t *state,double b[DIM][DIM],double *d)
+{
+   double z[DIM];
+   int i,j,k;
+   eigen (state->c,b,d);
+   for (i = 0; i < DIM; i++) d[i] = sqrt (d[i]);
+   for (k = 0; k < state->population; k++)
+	 {
+		for (i = 0; i < DIM; i++) z[i] = d[i] * gaussian (&state->rng);
+		for (i = 0; i < DIM; i++)
+		  {
+			 state->member[k][i] = state->mean[i];
+			 for (j = 0; j < DIM; j++) state->member[k][i] += state->sigma * b[i][j] * z[j];
+		  }
+	 }
+}
+
+/* Sort members by fitness, best first */
+static void rank (const state_t *state,int *order)
+{
+   int i,j,t;
+   for (i = 0; i < state->population; i++) order[i] = i;
+   for (i = 1; i < state->population; i++)
+	 for (j = i; j > 0 && state->fitness[order[j]] > state->fitness[order[j - 1]]; j--)
+	   {
+		  t = order[j];
+		  order[j] = order[j - 1];
+		  order[j - 1] = t;
+	   }
+}
+
+/*
+ * Move the distribution of CMA-ES towards the best half of the generation
+ * that was sampled with b and d (see Hansen, The CMA Evolution Strategy: A
+ * Tutorial)
+ */
+static void adapt (state_t *state,const double b[DIM][DIM],const double *d,const int *order)
+{
+   int n = DIM,mu = state->population / 2,i,j,k;
+   double w[state->population],y[mu][DIM],old[DIM],yw[DIM],t[DIM];
+   double sum = 0,mueff = 0,cc,cs,c1,cmu,damps,chin,norm,hsig;
+   for (i = 0; i < mu; i++) sum += w[i] = log (mu + 0.5) - log (i + 1);
+   for (i = 0; i < mu; i++)
+	 {
+		w[i] /= sum;
+		mueff += w[i] * w[i];
+	 }
+   mueff = 1 / mueff;
+   cc = (4 + mueff / n) / (n + 4 + 2 * mueff / n);
+   cs = (mueff + 2) / (n + mueff + 5);
+   c1 = 2 / ((n + 1.3) * (n + 1.3) + mueff);
+   cmu = 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff);
+   if (cmu > 1 - c1) cmu = 1 - c1;
+   damps = 1 + 2 * fmax (0,sqrt ((mueff - 1) / (n + 1)) - 1) + cs;
+   chin = sqrt (n) * (1 - 1.0 / (4 * n) + 1.0 / (21 * n * n));
+   /* new mean */
+   memcpy (old,state->mean,sizeof (old));
+   for (i = 0; i < n; i++)
+	 {
+		for (state->mean[i] = 0, k = 0; k < mu; k++) state->mean[i] += w[k] * state->member[order[k]][i];
+		yw[i] = (state->mean[i] - old[i]) / state->sigma;
+		for (k = 0; k < mu; k++) y[k][i] = (state->member[order[k]][i] - old[i]) / state->sigma;
+	 }
+   /* path of sigma, in the coordinates of the distribution: c^-1/2 yw = b d^-1 b' yw */
+   for (j = 0; j < n; j++)
+	 {
+		for (t[j] = 0, i = 0; i < n; i++) t[j] += b[i][j] * yw[i];
+		t[j] = d[j] > 0 ? t[j] / d[j] : 0;
+	 }
+   for (norm = 0, i = 0; i < n; i++)
+	 {
+		double z = 0;
+		for (j = 0; j < n; j++) z += b[i][j] * t[j];
+		state->ps[i] = (1 - cs) * state->ps[i] + sqrt (cs * (2 - cs) * mueff) * z;
+		norm += state->ps[i] * state->ps[i];
+	 }
+   norm = sqrt (norm);
+   hsig = norm / sqrt (1 - pow (1 - cs,2 * (state->generation + 1))) / chin < 1.4 + 2.0 / (n + 1);
+   /* path and matrix of the covariance */
+   for (i = 0; i < n; i++) state->pc[i] = (1 - cc) * state->pc[i] + hsig * sqrt (cc * (2 - cc) * mueff) * yw[i];
+   for (i = 0; i < n; i++)
+	 for (j = 0; j < n; j++)
+	   {
+		  double rankmu = 0;
+		  for (k = 0; k < mu; k++) rankmu += w[k] * y[k][i] * y[k][j];
+		  state->c[i][j] = (1 - c1 - cmu) * state->c[i][j] +
+			c1 * (state->pc[i] * state->pc[j] + (1 - hsig) * cc * (2 - cc) * state->c[i][j]) + cmu * rankmu;
+	   }
+   state->sigma *= exp (cs / damps * (norm / chin - 1));
+   /* the length of the weights doesn't matter, so the mean is kept at one */
+   for (sum = 0, i = 0; i < n; i++) sum += state->mean[i] * state->mean[i];
+   sum = sqrt (sum);
+   for (i = 0; i < n; i++) state->mean[i] /= sum;
+   state->sigma /= sum;
+}
+
+/* Pick a parent: the best of a few members drawn at random */
+static int tournament (state_t *state)
+{
+   int i,k,best = rand_value_r (&state->rng,state->population);
+   for (i = 1; i < TOURNAMENT; i++)
+	 if (state->fitness[k = rand_value_r (&state->rng,state->population)] > state->fitness[best]) best = k;
+   return (best);
+}
+
+/*
+ * Replace all but the best quarter of the population of the genetic
+ * algorithm with children of parents picked by tournament: the average
+ * of the parents weighted by their fitness, with a few weights mutated.
+ * Returns the first child.
+ */
+static int breed (state_t *state,const int *order)
+{
+   int elite = state->population / 4,i,j,a,b;
+   double (*next)[DIM] = malloc (state->population * sizeof (*next)),*fitness = malloc (state->population * sizeof (double));
+   double fa,fb;
+   if (next == NULL || fitness == NULL)
+	 {
+		fprintf (stderr,"Out of memory\n");
+		exit (EXIT_FAILURE);
+	 }
+   if (elite < 1) elite = 1;
+   for (i = 0; i < elite; i++)
+	 {
+		memcpy (next[i],state->member[order[i]],sizeof (next[i]));
+		fitness[i] = state->fitness[order[i]];
+	 }
+   for (i = elite; i < state->population; i++)
+	 {
+		a = tournament (state);
+		b = tournament (state);
+		fa = state->fitness[a] > 0 ? state->fitness[a] : 0;
+		fb = state->fitness[b] > 0 ? state->fitness[b] : 0;
+		if (fa + fb == 0) fa = fb = 1;
+		for (j = 0; j < DIM; j++)
+		  {
+			 next[i][j] = (fa * state->member[a][j] + fb * state->member[b][j]) / (fa + fb);
+			 if (uniform (&state->rng) < MUTATION) next[i][j] += MUTATIONSIZE * gaussian (&state->rng);
+		  }
+		normalize (next[i]);
+		fitness[i] = 0;
+	 }
+   memcpy (state->member,next,state->population * sizeof (*next));
+   memcpy (state->fitness,fitness,state->population * sizeof (double));
+   free (next);
+   free (fitness);
+   return (elite);
+}
+
+int main (int argc,char *argv[])
+{
+   options_t options = { METHOD_CMAES, 50, 16, 32, 1000, 1, 0, RANDOMIZER_BAG, MINLEVEL, { { 0 } }, NULL, NULL };
+   state_t state;
+   weights_t weights;
+   struct timeval starttv,endtv;
+   double seconds,mean,b[DIM][DIM],d[DIM];
+   unsigned long shapes;
+   int i,first,games,*order,*scores,*gameshapes;
+   FILE *fp;
+
+   bot_defaults (&options.weights);
+   parse_options (&options,argc,argv);
+   if (!options.threads) options.threads = pool_cpus ();
+
+   state.member = malloc (options.population * sizeof (*state.member));
+   state.fitness = malloc (options.population * sizeof (double));
+   order = malloc (options.population * sizeof (int));
+   scores = malloc ((size_t) options.population * options.games * sizeof (int));
+   gameshapes = malloc ((size_t) options.population * options.games * sizeof (int));
+   if (state.member == NULL || state.fitness == NULL || order == NULL || scores == NULL || gameshapes == NULL)
+	 {
+		fprintf (stderr,"Not enough memory for %d candidates\n",options.population);
+		exit (EXIT_FAILURE);
+	 }
+   if (options.checkpoint == NULL || !resume (&state,&options))
+	 start (&state,&options);
+   else
+	 printf ("# resuming %s after generation %d\n",options.checkpoint,state.generation);
+
+   while (!options.generations || state.generation < options.generations)
+	 {
+		gettimeofday (&starttv,NULL);
+		if (state.method == METHOD_CMAES)
+		  {
+			 sample (&state,b,d);
+			 first = 0;
+		  }
+		/* the members the genetic algorithm keeps are still worth the same */
+		else if (state.generation)
+		  {
+			 rank (&state,order);
+			 first = breed (&state,order);
+		  }
+		else
+		  first = 0;
+		shapes = evaluate (&state,&options,first,scores,gameshapes);
+		games = (state.population - first) * options.games;
+		rank (&state,order);
+		for (mean = 0, i = 0; i < state.population; i++) mean += state.fitness[i];
+		mean /= state.population;
+		if (state.fitness[order[0]] > state.bestfitness)
+		  {
+			 state.bestfitness = state.fitness[order[0]];
+			 memcpy (state.best,state.member[order[0]],sizeof (state.best));
+		  }
+		if (state.method == METHOD_CMAES) adapt (&state,b,d,order);
+		state.generation++;
+		gettimeofday (&endtv,NULL);
+		seconds = (endtv.tv_sec - starttv.tv_sec) + (endtv.tv_usec - starttv.tv_usec) / 1000000.0;
+
+		printf ("# generation %d: best %.2f, mean %.2f, best so far %.2f\n",
+				state.generation,state.fitness[order[0]],mean,state.bestfitness);
+		fflush (stdout);
+		/* timings differ from run to run, so they don't go with the progress */
+		fprintf (stderr,"generation %d: %d threads, %.2f seconds, %.0f games/s, %.1f games/s per core, %.0f shapes/s\n",
+				 state.generation,options.threads,seconds,games / seconds,games / seconds / options.threads,shapes / seconds);
+		if (options.checkpoint != NULL && !save (&state,&options)) exit (EXIT_FAILURE);
+		if (options.output != NULL)
+		  {
+			 vector2weights (&weights,state.best);
+			 if ((fp = fopen (options.output,"w")) == NULL)
+			   {
+				  fprintf (stderr,"Could not create %s\n",options.output);
+				  exit (EXIT_FAILURE);
+			   }
+			 fprintf (fp,"# mean score %.2f over %d games\n",state.bestfitness,options.games);
+			 bot_save (&weights,fp);
+			 fclose (fp);
+		  }
+	 }
+
+   printf ("# best: mean score %.2f over %d games\n",state.bestfitness,options.games);
+   vector2weights (&weights,state.best);
+   bot_save (&weights,stdout);
+   free (state.member);
+   free (state.fitness);
+   free (order);
+   free (scores);
+   free (gameshapes);
+   exit (EXIT_SUCCESS);
+}
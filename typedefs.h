@@ -33,6 +33,8 @@
  * Boolean definitions
  */
 
+#include <stdbool.h>	/* agree with <curses.h> on the size of bool */
+
 #ifndef bool
 #define bool int
 #endif
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include "typedefs.h"
 
@@ -38,11 +39,7 @@
  */
 void rand_init ()
 {
-#ifdef USE_RAND
-   srand (time (NULL));
-#else
    srandom (time (NULL));
-#endif
 }
 
 /*
@@ -50,11 +47,64 @@ void rand_init ()
  */
 int rand_value (int range)
 {
-#ifdef USE_RAND
-   return ((int) ((float) range * rand () / (RAND_MAX + 1.0)));
-#else
    return (random () % range);
-#endif
+}
+
+/*
+ * Generate a random number within range from a private state, so
+ * that several users don't disturb each other's sequences. The state
+ * must not be zero.
+ */
+int rand_value_r (unsigned int *state,int range)
+{
+   /* xorshift32 */
+   *state ^= *state << 13;
+   *state ^= *state >> 17;
+   *state ^= *state << 5;
+   return (*state % range);
+}
+
+/*
+ * Philox4x32-10 counter-based generator: the result is a random function of
+ * the key and the counter, so any number in a sequence can be computed
+ * directly and nobody has to share any state.
+ */
+void rand_philox (const unsigned int key[2],const unsigned int counter[4],unsigned int result[4])
+{
+   uint32_t k0 = key[0],k1 = key[1];
+   uint32_t c0 = counter[0],c1 = counter[1],c2 = counter[2],c3 = counter[3];
+   uint64_t p0,p1;
+   int i;
+   for (i = 0; i < 10; i++)
+	 {
+		p0 = (uint64_t) 0xd2511f53U * c0;
+		p1 = (uint64_t) 0xcd9e8d57U * c2;
+		c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t) p1;
+		c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t) p0;
+		k0 += 0x9e3779b9U;
+		k1 += 0xbb67ae85U;
+	 }
+   result[0] = c0;
+   result[1] = c1;
+   result[2] = c2;
+   result[3] = c3;
+}
+
+/*
+ * Derive the seed of the index'th of several independent games from a
+ * master seed. The result only depends on the two arguments and is never
+ * zero.
+ */
+unsigned int rand_seed (unsigned int seed,unsigned long index)
+{
+   /* splitmix64 */
+   unsigned long long z = ((unsigned long long) seed << 32 | index) + 0x9e3779b97f4a7c15ULL * (index + 1);
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+   z ^= z >> 31;
+   return ((unsigned int) z ? (unsigned int) z : 1);
 }
 
 /*
@@ -41,6 +41,27 @@ void rand_init ();
  */
 int rand_value (int range);
 
+/*
+ * Generate a random number within range from a private state, so
+ * that several users don't disturb each other's sequences. The state
+ * must not be zero.
+ */
+int rand_value_r (unsigned int *state,int range);
+
+/*
+ * Philox4x32-10 counter-based generator: the result is a random function of
+ * the key and the counter, so any number in a sequence can be computed
+ * directly and nobody has to share any state.
+ */
+void rand_philox (const unsigned int key[2],const unsigned int counter[4],unsigned int result[4]);
+
+/*
+ * Derive the seed of the index'th of several independent games from a
+ * master seed. The result only depends on the two arguments and is never
+ * zero.
+ */
+unsigned int rand_seed (unsigned int seed,unsigned long index);
+
 /*
  * Convert an str to long. Returns TRUE if successful,
  * FALSE otherwise.